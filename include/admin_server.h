@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief AdminServer serves operator commands on a local Unix domain socket.
+ * A client connects, sends one command line (e.g. "stats") and receives a text response, then the connection is closed.
+ * Commands are registered by the owner (QuoridorServer) as callbacks, the first word selects the command and
+ * the rest of the line is passed to the callback as arguments.
+ * Example: echo stats | nc -U /tmp/quoridor_admin_5055.sock
+ */
+class AdminServer {
+public:
+    using CommandHandler = std::function<std::string(const std::string& args)>;
+
+    explicit AdminServer(std::string socket_path);
+    ~AdminServer();
+
+    // Register command (must be done before start)
+    void add_command(const std::string& name, CommandHandler handler);
+
+    // Bind the socket and start a thread serving commands, returns false if the socket cannot be created
+    bool start();
+
+    const std::string& get_socket_path() const;
+
+private:
+    std::string socket_path; // filesystem path of the Unix socket
+    int admin_socket = -1; // listening socket
+    std::atomic<bool> running{false}; // flag for the accept loop
+    std::map<std::string, CommandHandler> commands; // registered commands
+
+    // Accept loop (runs in its own thread)
+    void serve();
+    // Read one command from the client and write the response
+    void handle_connection(int client_socket);
+    // Build the response for a command line
+    std::string execute(const std::string& line);
+};
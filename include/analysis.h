@@ -0,0 +1,98 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "opening_book.h"
+#include "rules.h"
+#include "tablebase.h"
+
+struct GameSnapshot;
+
+/**
+ * @brief Engine view of one position of a two player game: shortest path length and one shortest route of each
+ * player and a suggested move for the player to move. The hint is greedy (one ply): the move that leaves the
+ * largest lead in path length, a pawn step wins ties against a wall so walls are not spent for nothing.
+ * Races (no walls left) whose layout is in the tablebase are solved exactly, the hint is then the best move.
+ * Positions in the opening book get the book move as hint without any search.
+ */
+struct Analysis {
+    int to_move = 0; // player index the hint is for
+    int distances[2] = {-1, -1}; // steps each player needs to reach its goal (-1 if it cannot)
+    std::vector<std::pair<int, int>> routes[2]; // cells of a shortest route of each player (pawn cell excluded)
+    bool hint_is_horizontal = false; // orientation of a suggested wall (false for a pawn step)
+    std::vector<std::pair<int, int>> hint; // one cell for a pawn step, two for a wall, empty if there is no move
+    bool solved = false; // the position was found in the tablebase, race holds its exact value
+    Tablebase::Value race; // result for the player to move and plies until the game ends
+    bool from_book = false; // the hint is the move of the opening book
+    uint32_t book_games = 0; // recorded games that reached the position (book hints only)
+};
+
+// Analyse a position of any hosted variant, races are looked up in tablebase and openings in book if given
+Analysis analyze_position(const VariantPosition& position, int to_move, const Tablebase* tablebase = nullptr,
+                          const OpeningBook* book = nullptr);
+// Engine position of the game a snapshot was taken from
+VariantPosition position_from_snapshot(const GameSnapshot& snapshot);
+
+/**
+ * @brief Answers analysis requests on its own threads, so analysis traffic never runs on (or locks) a game.
+ * Results are kept in a direct mapped cache indexed by the position hash. A cached position is answered on the
+ * calling thread, anything else is queued for the analysis threads, which run the reply callback.
+ * The queue is bounded, requests beyond MAX_PENDING are refused instead of delaying everyone else.
+ */
+class AnalysisService {
+public:
+    static constexpr size_t CACHE_SLOTS = 4096; // power of two
+    static constexpr size_t CACHE_LOCKS = 64; // slots are locked in stripes
+    static constexpr size_t MAX_PENDING = 256; // queued requests
+    static constexpr size_t MAX_THREADS = 4;
+
+    using Reply = std::function<void(const Analysis&)>;
+
+    static AnalysisService& instance();
+
+    // Answer from the cache or queue the position, returns false (reply is not called) if the queue is full
+    bool submit(const VariantPosition& position, int to_move, Reply reply);
+    // Requests waiting for an analysis thread
+    size_t pending() const;
+    // Answer races from the tablebase at path from now on, false if it cannot be opened
+    bool load_tablebase(const std::string& path);
+    // Answer openings from the book at path from now on, false if it cannot be opened
+    bool load_book(const std::string& path);
+
+private:
+    struct Request {
+        VariantPosition position;
+        int to_move;
+        uint64_t hash;
+        Reply reply;
+    };
+    struct Slot {
+        uint64_t hash = 0;
+        VariantPosition position; // full key, different positions may share a hash
+        int to_move = -1; // -1 while the slot is empty
+        std::shared_ptr<const Analysis> result;
+    };
+
+    AnalysisService();
+    void run();
+
+    // Cached result of the position or nullptr
+    std::shared_ptr<const Analysis> lookup(uint64_t hash, const VariantPosition& position, int to_move);
+    void store(uint64_t hash, const VariantPosition& position, int to_move, std::shared_ptr<const Analysis> result);
+    static uint64_t hash(const VariantPosition& position, int to_move);
+
+    mutable std::mutex queue_mutex; // protects queue
+    std::condition_variable queue_condition; // signalled when a request is queued
+    std::deque<Request> queue; // requests waiting for an analysis thread
+    std::vector<Slot> cache; // slot hash % CACHE_SLOTS, a newer result replaces an older one
+    std::mutex cache_locks[CACHE_LOCKS]; // lock of slot i is i % CACHE_LOCKS
+    std::shared_ptr<const Tablebase> tablebase; // set once a tablebase is loaded (atomic load/store)
+    std::shared_ptr<const OpeningBook> book; // set once an opening book is loaded (atomic load/store)
+};
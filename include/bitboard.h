@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * @brief Fixed-width set of BITS cells packed into 64-bit words, cell i is bit i % 64 of word i / 64.
+ * The word count is a compile time constant, so every loop below is unrolled by the compiler and a 5x5 board
+ * (one word) compiles to plain integer operations. Bits above BITS are always zero.
+ */
+template <int BITS>
+struct Bitboard {
+    static constexpr int WORDS = (BITS + 63) / 64;
+    static constexpr uint64_t LAST_WORD_MASK = (BITS % 64 == 0) ? ~0ull : ((1ull << (BITS % 64)) - 1);
+
+    uint64_t words[WORDS] = {};
+
+    static constexpr Bitboard cell(int index) {
+        Bitboard result;
+        result.set(index);
+        return result;
+    }
+
+    constexpr bool test(int index) const { return (words[index / 64] >> (index % 64)) & 1; }
+    constexpr void set(int index) { words[index / 64] |= 1ull << (index % 64); }
+    constexpr void reset(int index) { words[index / 64] &= ~(1ull << (index % 64)); }
+
+    constexpr bool any() const {
+        uint64_t merged = 0;
+        for (int i = 0; i < WORDS; ++i) merged |= words[i];
+        return merged != 0;
+    }
+
+    constexpr int count() const {
+        int total = 0;
+        for (int i = 0; i < WORDS; ++i) total += __builtin_popcountll(words[i]);
+        return total;
+    }
+
+    // Index of the lowest cell in the set, -1 if it is empty
+    constexpr int lowest() const {
+        for (int i = 0; i < WORDS; ++i) {
+            if (words[i] != 0) return i * 64 + __builtin_ctzll(words[i]);
+        }
+        return -1;
+    }
+
+    constexpr bool operator==(const Bitboard& other) const {
+        for (int i = 0; i < WORDS; ++i) {
+            if (words[i] != other.words[i]) return false;
+        }
+        return true;
+    }
+    constexpr bool operator!=(const Bitboard& other) const { return !(*this == other); }
+
+    constexpr Bitboard operator|(const Bitboard& other) const {
+        Bitboard result;
+        for (int i = 0; i < WORDS; ++i) result.words[i] = words[i] | other.words[i];
+        return result;
+    }
+
+    constexpr Bitboard operator&(const Bitboard& other) const {
+        Bitboard result;
+        for (int i = 0; i < WORDS; ++i) result.words[i] = words[i] & other.words[i];
+        return result;
+    }
+
+    // Cells of this set that are not in other
+    constexpr Bitboard without(const Bitboard& other) const {
+        Bitboard result;
+        for (int i = 0; i < WORDS; ++i) result.words[i] = words[i] & ~other.words[i];
+        return result;
+    }
+
+    // Every cell moves to index + shift (0 < shift < 64), cells past the end are dropped
+    constexpr Bitboard shifted_up(int shift) const {
+        Bitboard result;
+        for (int i = WORDS - 1; i >= 0; --i) {
+            result.words[i] = (words[i] << shift) | (i > 0 ? words[i - 1] >> (64 - shift) : 0);
+        }
+        result.words[WORDS - 1] &= LAST_WORD_MASK;
+        return result;
+    }
+
+    // Every cell moves to index - shift (0 < shift < 64), cells before the start are dropped
+    constexpr Bitboard shifted_down(int shift) const {
+        Bitboard result;
+        for (int i = 0; i < WORDS; ++i) {
+            result.words[i] = (words[i] >> shift) | (i + 1 < WORDS ? words[i + 1] << (64 - shift) : 0);
+        }
+        return result;
+    }
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+/**
+ * @brief Clock is the time source of the server. By default it is the steady clock, the simulation harness
+ * switches it to virtual time which only moves when advance() is called, so heartbeat timeouts and
+ * reconnection windows can be replayed without waiting and without depending on machine speed.
+ * Everything that sleeps or waits with a timeout goes through Clock, otherwise virtual time would not apply to it.
+ */
+class Clock {
+public:
+    using time_point = std::chrono::steady_clock::time_point;
+    using duration = std::chrono::steady_clock::duration;
+
+    // Current time (steady clock or virtual time)
+    static time_point now();
+
+    // Sleep for the given time (virtual sleeps end when the virtual clock passes the deadline)
+    static void sleep_for(duration time);
+
+    // Switch to virtual time starting at the current steady clock time (must be called before any waits)
+    static void enable_virtual_time();
+    static bool is_virtual();
+
+    // Move virtual time forward and wake everything whose deadline has passed
+    static void advance(duration time);
+
+    // Condition variables waiting with a deadline are registered, so advance() can wake them
+    static void add_waiter(std::mutex* mutex, std::condition_variable* condition);
+    static void remove_waiter(std::mutex* mutex, std::condition_variable* condition);
+
+    // Wait on condition until predicate is true or deadline passes, returns predicate result
+    template <typename Predicate>
+    static bool wait_until(std::unique_lock<std::mutex>& lock, std::condition_variable& condition,
+                           time_point deadline, Predicate predicate) {
+        if (!is_virtual()) {
+            return condition.wait_until(lock, deadline, predicate);
+        }
+        // the waiter must be registered with add_waiter, advance() notifies it under its mutex
+        begin_wait(deadline);
+        bool result = true;
+        while (!predicate()) {
+            if (now() >= deadline) {
+                result = false;
+                break;
+            }
+            condition.wait(lock);
+        }
+        end_wait(deadline);
+        return result;
+    }
+
+    // In virtual time: true when every thread that waits through Clock is blocked and no deadline has passed.
+    // Data that arrived for a waiting thread is not visible here, callers check their own queues as well.
+    static bool is_idle();
+
+private:
+    // Bookkeeping for is_idle (virtual time only)
+    static void begin_wait(time_point deadline);
+    static void end_wait(time_point deadline);
+};
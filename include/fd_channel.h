@@ -0,0 +1,20 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Sends a payload together with open file descriptors over a connected Unix stream socket (SCM_RIGHTS).
+ * The receiving process gets its own descriptors for the same open files and sockets, so a connection keeps
+ * working when it moves to another process. Wire format: [u32 payload size][u32 descriptor count][payload],
+ * followed by one byte messages that carry up to MAX_FDS_PER_MESSAGE descriptors each.
+ */
+class FdChannel {
+public:
+    static constexpr size_t MAX_FDS_PER_MESSAGE = 250; // kernel limit is SCM_MAX_FD (253)
+
+    // Send payload and fds, the caller keeps its own descriptors open
+    static bool send(int socket, const std::string& payload, const std::vector<int>& fds);
+    // Receive what send() sent, received descriptors are owned by the caller (closed again on failure)
+    static bool receive(int socket, std::string& payload, std::vector<int>& fds);
+};
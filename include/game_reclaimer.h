@@ -0,0 +1,43 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class QuoridorGame;
+
+/**
+ * @brief Frees games as they end instead of sweeping the server for finished ones. A game reports its end here,
+ * one thread removes it from the server right away (the slot is free for a new game) and deletes it once no thread
+ * holds a reference to it anymore (connection threads and the heartbeat checker, see QuoridorGame::acquire).
+ * After the removal nobody can acquire the game again, so a count that dropped to zero stays zero.
+ */
+class GameReclaimer {
+public:
+    // remove takes an ended game out of the server, it runs on the reclaimer thread without any reclaimer lock held
+    explicit GameReclaimer(std::function<void(QuoridorGame*)> remove);
+    // Stops the thread, retired games that are still referenced are left alone
+    ~GameReclaimer();
+    GameReclaimer(const GameReclaimer&) = delete;
+    GameReclaimer& operator=(const GameReclaimer&) = delete;
+
+    // Start the reclaimer thread (games that ended before are handled then)
+    void start();
+    // Called once by a game when it ends (may hold the game mutex, only queues the game)
+    void game_ended(QuoridorGame* game);
+    // Called when the last reference of a game was released, the game may already be deleted when this runs
+    void game_released();
+
+private:
+    void run();
+
+    std::function<void(QuoridorGame*)> remove; // takes the game out of the server tables
+    std::mutex reclaim_mutex; // protects ended, released and stopping
+    std::condition_variable reclaim_condition; // signalled for every event below
+    std::vector<QuoridorGame*> ended; // ended games not yet removed
+    bool released = false; // a reference was released since the retired games were last checked
+    bool stopping = false;
+    std::vector<QuoridorGame*> retired; // removed games, deleted when unused (reclaimer thread only)
+    std::thread reclaim_thread;
+};
@@ -0,0 +1,75 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Player part of a game snapshot. The name is the session identity, a client that connects
+ * with the same name is reconnected into the game.
+ */
+struct PlayerSnapshot {
+    std::string name; // player name
+    uint8_t row = 0; // position on the board
+    uint8_t col = 0;
+    uint8_t walls_left = 0; // walls the player can still place
+    uint32_t clock_ms = 0; // time left on the clock at the start of the current turn
+};
+
+/**
+ * @brief Immutable copy of the state of one game in progress. A game publishes a new snapshot after every change
+ * and never modifies a published one, so readers (snapshot writer, hot restart) need no game lock.
+ * Board, ids, colors and goal rows are not stored, they follow from the player order and positions.
+ */
+struct GameSnapshot {
+    static constexpr size_t MAX_WALL_CELLS = 48; // both players together place at most 24 walls of two cells (11x11)
+
+    uint32_t lobby_id = 0; // id of the game
+    uint32_t journal_sequence = 0; // sequence number of the next journaled event
+    uint32_t turn = 0; // moves played so far
+    uint8_t variant = 0; // Variant of the game (board size, walls and time control)
+    bool in_progress = true; // false in the last snapshot of a finished game (not serialized, only such games are)
+    uint8_t current_player = 0; // index of the player to move
+    uint8_t horizontal_count = 0; // used cells of horizontal_walls
+    uint8_t vertical_count = 0; // used cells of vertical_walls
+    std::array<std::pair<uint8_t, uint8_t>, MAX_WALL_CELLS> horizontal_walls; // cells of horizontal walls
+    std::array<std::pair<uint8_t, uint8_t>, MAX_WALL_CELLS> vertical_walls; // cells of vertical walls
+    PlayerSnapshot players[2];
+
+    // Append the binary encoding of the snapshot to out
+    void serialize(std::string& out) const;
+    // Decode a snapshot from data, returns the number of bytes used or 0 if the data is malformed (including cells
+    // outside the board of the variant and more walls than the variant has)
+    size_t deserialize(const char* data, size_t size);
+};
+
+/**
+ * @brief Holds the latest snapshot of one game. Readers that may outlive the game (admin views) keep the slot
+ * instead of the game, so they never touch a deleted game.
+ */
+class SnapshotSlot {
+public:
+    std::shared_ptr<const GameSnapshot> load() const { return std::atomic_load(&current); }
+    void store(std::shared_ptr<const GameSnapshot> snapshot) { std::atomic_store(&current, std::move(snapshot)); }
+
+private:
+    std::shared_ptr<const GameSnapshot> current; // replaced, never modified (atomic load/store)
+};
+
+/**
+ * @brief File with the snapshots of all games in progress: [magic][version][game count][games...][crc32].
+ * The file is replaced atomically (temporary file, fsync, rename), so a crash leaves either the old or the new file.
+ */
+class SnapshotFile {
+public:
+    static constexpr char MAGIC[8] = {'Q', 'S', 'N', 'A', 'P', 'S', 'H', 'T'};
+    static constexpr uint32_t FORMAT_VERSION = 4;
+
+    // Write all snapshots to path
+    static bool write(const std::string& path, const std::vector<std::shared_ptr<const GameSnapshot>>& games);
+    // Read the snapshots from path, returns false if the file is missing, truncated or corrupted
+    static bool read(const std::string& path, std::vector<GameSnapshot>& games);
+};
@@ -0,0 +1,124 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Kind of journaled game event
+enum class JournalEventType : uint8_t {
+    GAME_START = 1,
+    MOVE = 2,
+    DISCONNECT = 3,
+    RECONNECT = 4,
+    GAME_END = 5
+};
+
+// JournalEvent::flags for MOVE events
+constexpr uint8_t JOURNAL_MOVE_WALL = 1; // wall placement (otherwise a pawn move)
+constexpr uint8_t JOURNAL_MOVE_HORIZONTAL = 2; // horizontal wall
+
+// JournalEvent::flags for DISCONNECT events
+constexpr uint8_t JOURNAL_DISCONNECT_PERMANENT = 1; // player was removed from the game (otherwise heartbeat timeout)
+
+// JournalEvent::flags for GAME_END events (reason)
+constexpr uint8_t JOURNAL_END_GOAL = 0; // winner reached the goal row
+constexpr uint8_t JOURNAL_END_DISCONNECT = 1; // opponent disconnected for good
+constexpr uint8_t JOURNAL_END_OPERATOR = 2; // ended from the admin socket, there is no winner
+constexpr uint8_t JOURNAL_END_TIMEOUT = 3; // clock of the loser ran out
+
+/**
+ * @brief One game event. Events of a game are ordered by sequence, timestamps are only informational.
+ */
+struct JournalEvent {
+    static constexpr size_t NAME_SIZE = 32; // maximum stored player name length (including terminating zero)
+
+    JournalEventType type = JournalEventType::MOVE;
+    uint32_t game_id = 0; // lobby id of the game
+    uint32_t sequence = 0; // position of the event within its game
+    int64_t timestamp_us = 0; // microseconds since epoch
+    uint8_t player = 0; // index of the player in the game (winner for GAME_END)
+    uint8_t flags = 0; // JOURNAL_* flags of the event type (GAME_START: Variant of the game)
+    uint8_t cells[4] = {0, 0, 0, 0}; // MOVE: row and column of the first and second cell
+    char names[2][NAME_SIZE] = {{0}, {0}}; // GAME_START: names of both players
+};
+
+/**
+ * @brief Append-only binary journal of game events.
+ * Game threads write events into their own lock-free ring buffer (no locks and no syscalls on the move path),
+ * a background writer drains all rings every WRITE_INTERVAL_MS and appends the batch to the current segment
+ * file with a single write. Segments are named journal_<index>.qj and rotated once they reach the segment size.
+ * Every record is [u16 payload length][u32 crc32 of payload][payload] in little endian byte order, so a reader
+ * stops at the first torn or corrupted record. Recording does nothing until open() is called.
+ */
+class Journal {
+public:
+    static constexpr size_t RING_CAPACITY = 256; // events per thread (must be power of two)
+    static constexpr int WRITE_INTERVAL_MS = 10; // how often the writer drains the rings
+    static constexpr int SYNC_INTERVAL_MS = 1000; // how often written data is forced to disk
+    static constexpr size_t DEFAULT_SEGMENT_SIZE = 64 * 1024 * 1024; // segment rotation size in bytes
+    static constexpr char SEGMENT_MAGIC[8] = {'Q', 'J', 'O', 'U', 'R', 'N', 'A', 'L'}; // start of every segment
+    static constexpr uint32_t FORMAT_VERSION = 1;
+    static constexpr size_t SEGMENT_HEADER_SIZE = 16; // magic, version, segment index
+    static constexpr size_t RECORD_HEADER_SIZE = 6; // payload length, crc32
+    static constexpr size_t MAX_RECORD_SIZE = RECORD_HEADER_SIZE + 64 + 2 * JournalEvent::NAME_SIZE;
+
+    // Get the process wide journal
+    static Journal& instance();
+
+    // Start journaling into directory (created if missing), a new segment is always started
+    bool open(const std::string& directory, size_t segment_size = DEFAULT_SEGMENT_SIZE);
+
+    bool is_open() const;
+
+    // Queue an event, never blocks (the event is dropped and counted if the ring of this thread is full)
+    void record(const JournalEvent& event);
+
+    // Write everything recorded so far and sync it to disk
+    void flush();
+
+    // Encode event as one record into out (at least MAX_RECORD_SIZE bytes), returns the record size
+    static size_t encode(const JournalEvent& event, char* out);
+
+    // Decode the record at data, returns the record size or 0 if the record is incomplete or corrupted
+    static size_t decode(const char* data, size_t size, JournalEvent& event);
+
+    // File name of segment index inside the journal directory
+    static std::string segment_name(uint32_t index);
+
+    static uint32_t crc32(const char* data, size_t size);
+
+private:
+    // Single producer (owning thread) single consumer (writer thread) ring buffer
+    struct Ring {
+        JournalEvent events[RING_CAPACITY];
+        std::atomic<size_t> head{0}; // next slot to write (producer)
+        std::atomic<size_t> tail{0}; // next slot to read (consumer)
+        std::atomic<bool> retired{false}; // owning thread exited, ring is freed once drained
+    };
+
+    // Releases the ring of a thread when the thread exits
+    struct RingOwner {
+        Ring* ring = nullptr;
+        ~RingOwner();
+    };
+
+    std::atomic<bool> opened{false}; // open() succeeded, events are recorded
+    std::mutex rings_mutex; // protects rings (only taken on thread registration and while draining)
+    std::mutex write_mutex; // serializes write_pending() calls and protects the segment state below
+    std::vector<Ring*> rings; // rings of all threads that recorded events
+    std::string directory; // journal directory
+    size_t segment_size = DEFAULT_SEGMENT_SIZE; // rotation size
+    uint32_t segment_index = 0; // index of the current segment
+    int segment_fd = -1; // current segment file
+    size_t segment_bytes = 0; // bytes written into the current segment
+    bool unsynced = false; // data written since the last sync
+    std::thread writer_thread; // background writer
+
+    Journal() = default;
+    Ring* thread_ring();
+    bool open_segment(uint32_t index);
+    void write_pending(bool sync);
+};
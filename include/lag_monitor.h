@@ -0,0 +1,31 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Measures how late a thread wakes up from a short sleep. With a thread per connection the wakeup delay is
+ * the run queue wait every client thread sees, so it is the server's equivalent of event loop lag.
+ * The smoothed lag drives load shedding with hysteresis: shedding starts above SHED_LAG and stops below
+ * RECOVER_LAG. Always measured in real time (virtual time of the simulation has no scheduler).
+ */
+class LagMonitor {
+public:
+    static constexpr std::chrono::milliseconds TICK{100}; // sleep between measurements
+    static constexpr std::chrono::milliseconds SHED_LAG{100}; // start shedding above this smoothed lag
+    static constexpr std::chrono::milliseconds RECOVER_LAG{25}; // stop shedding below this smoothed lag
+
+    // Start the measuring thread (once)
+    void start();
+    // Smoothed wakeup lag in microseconds
+    int64_t lag_us() const;
+    // True while new work should be rejected
+    bool is_overloaded() const;
+
+private:
+    std::atomic<int64_t> smoothed_lag_us{0};
+    std::atomic<bool> overloaded{false};
+    std::atomic<bool> started{false};
+
+    void run();
+};
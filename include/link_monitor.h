@@ -0,0 +1,70 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include "clock.h"
+
+/**
+ * @brief Measures the link to one client and decides when the client is suspected to be gone.
+ * Heartbeats carry a sequence number and the server timestamp, the client echoes both in its ACK, so the round trip
+ * time is measured against the server clock only (smoothed RTT and jitter as in TCP, RFC 6298).
+ * Disconnect suspicion is a phi-accrual detector: the mean and deviation of the gaps between messages from the client
+ * are tracked, phi says how unlikely the current silence is under that distribution. A steady client is suspected
+ * soon after it stops, a client on a jittery link gets more time. Suspicion is bounded to
+ * [MIN_SUSPECT_SECONDS, MAX_SUSPECT_SECONDS] and falls back to a fixed timeout until enough gaps were seen.
+ * Below MAX_SUSPECT_SECONDS a client is only suspected while a heartbeat sent after its last message has been
+ * unanswered for the probe grace (PROBE_GRACE_SECONDS plus the retransmission timeout of the link), so a silent
+ * client always gets the chance to answer a probe first.
+ */
+class LinkMonitor {
+public:
+    static constexpr double PHI_THRESHOLD = 8.0; // suspect when the silence has a probability below 10^-8
+    static constexpr int MIN_SUSPECT_SECONDS = 5; // never suspect earlier (a heartbeat interval)
+    static constexpr double PROBE_GRACE_SECONDS = 3.0; // time a probe has to be answered before suspicion
+    static constexpr int MAX_SUSPECT_SECONDS = 30; // always suspect after this much silence
+    static constexpr int FALLBACK_SUSPECT_SECONDS = 15; // fixed timeout while the gap statistics are not ready
+    static constexpr int MIN_SAMPLES = 3; // gaps needed before phi is used
+    static constexpr double MIN_DEVIATION_SECONDS = 0.5; // floor for the gap deviation (perfectly regular clients)
+    static constexpr double BURST_SECONDS = 0.01; // messages closer than this belong to one burst, not a new gap
+
+    explicit LinkMonitor(Clock::time_point now = Clock::now());
+
+    // Forget the statistics (new connection for the same player)
+    void reset(Clock::time_point now);
+    // A message arrived from the client
+    void record_arrival(Clock::time_point now);
+    // Sequence number for the next heartbeat, timestamp_us is set to the send time that the client echoes
+    uint32_t next_heartbeat(Clock::time_point now, int64_t& timestamp_us);
+    // The client echoed a heartbeat, returns false (and changes nothing) for unknown or stale echoes
+    bool record_ack(uint32_t sequence, int64_t timestamp_us, Clock::time_point now);
+
+    // Suspicion level of the current silence
+    double phi(Clock::time_point now) const;
+    // True if the client should be treated as disconnected
+    bool is_suspected(Clock::time_point now) const;
+
+    // Smoothed round trip time and its mean deviation in milliseconds (0 before the first echo)
+    double rtt_ms() const;
+    double jitter_ms() const;
+    // Time of the last message from the client
+    Clock::time_point last_arrival() const;
+    // Time of the last heartbeat sent (construction or reset time before the first one)
+    Clock::time_point last_heartbeat() const;
+
+    // Microseconds of Clock time, the unit of heartbeat timestamps
+    static int64_t to_timestamp_us(Clock::time_point time);
+
+private:
+    mutable std::mutex monitor_mutex; // protects everything below (client thread writes, game checker reads)
+    Clock::time_point last_message; // last arrival
+    Clock::time_point last_probe; // last heartbeat sent
+    double gap_mean = 0; // EWMA of the gaps between messages (seconds)
+    double gap_variance = 0; // EWMA of the squared deviation of the gaps
+    int samples = 0; // number of gaps seen
+    double smoothed_rtt = 0; // seconds
+    double rtt_deviation = 0; // seconds
+    bool has_rtt = false;
+    uint32_t next_sequence = 1; // sequence number of the next heartbeat
+    uint32_t last_acked = 0; // newest echoed sequence (older echoes are ignored)
+
+    double phi_locked(Clock::time_point now) const;
+};
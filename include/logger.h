@@ -0,0 +1,117 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "message.h"
+
+// Compile time log level, everything below it is removed by the compiler (0 = debug, 1 = info, 2 = warning, 3 = error)
+#ifndef QUORIDOR_LOG_LEVEL
+#define QUORIDOR_LOG_LEVEL 1
+#endif
+
+// Enum class for the log level
+enum class LogLevel {
+    DEBUG = 0,
+    INFO = 1,
+    WARNING = 2,
+    ERROR = 3
+};
+
+/**
+ * @brief Structured fields attached to a log line. Missing fields are simply not printed.
+ */
+struct LogFields {
+    int game_id = -1; // game id (-1 if the log is not related to a game)
+    const char* player = nullptr; // player name (copied when the record is created)
+    MessageType message_type = MessageType::WRONG_MESSAGE; // type of the message the log is about
+    bool has_message_type = false; // message_type is valid
+
+    LogFields() = default;
+    LogFields(int game_id, const std::string& player) : game_id(game_id), player(player.c_str()) {}
+    LogFields(int game_id, const std::string& player, MessageType message_type)
+        : game_id(game_id), player(player.c_str()), message_type(message_type), has_message_type(true) {}
+};
+
+/**
+ * @brief Asynchronous logger. Every thread writes into its own lock-free ring buffer and a background thread
+ * drains all buffers in batches (warnings and errors to stderr, the rest to stdout), so logging on hot paths never
+ * takes a global lock or flushes.
+ * When a ring is full the record is dropped and counted instead of blocking the caller.
+ * Use the LOG_* macros, they are compiled out when the level is below QUORIDOR_LOG_LEVEL and skipped when it is
+ * below the runtime minimum level.
+ */
+class Logger {
+public:
+    static constexpr size_t RING_CAPACITY = 64; // records per thread (must be power of two)
+    static constexpr size_t TEXT_SIZE = 400; // maximum length of the formatted text
+    static constexpr size_t PLAYER_SIZE = 32; // maximum length of the player name
+    static constexpr int DRAIN_INTERVAL_MS = 5; // how often the background thread drains the rings
+
+    // Get the process wide logger (started on first use)
+    static Logger& instance();
+
+    // Record a log line (printf style format), never blocks
+    void log(LogLevel level, const LogFields& fields, const char* format, ...) __attribute__((format(printf, 4, 5)));
+
+    // Drop records below level at runtime (on top of QUORIDOR_LOG_LEVEL, the simulation keeps only warnings)
+    void set_min_level(LogLevel level);
+
+    // Write everything recorded so far to stdout and stderr (used before exit)
+    void flush();
+
+    // Number of records dropped because a ring was full
+    uint64_t get_dropped() const;
+
+private:
+    struct Record {
+        LogLevel level;
+        int64_t timestamp_us; // microseconds since epoch
+        int game_id;
+        MessageType message_type;
+        bool has_message_type;
+        char player[PLAYER_SIZE];
+        char text[TEXT_SIZE];
+    };
+
+    // Single producer (owning thread) single consumer (drain thread) ring buffer
+    struct Ring {
+        Record records[RING_CAPACITY];
+        std::atomic<size_t> head{0}; // next slot to write (producer)
+        std::atomic<size_t> tail{0}; // next slot to read (consumer)
+        std::atomic<bool> retired{false}; // owning thread exited, ring is freed once drained
+    };
+
+    // Releases the ring of a thread when the thread exits
+    struct RingOwner {
+        Ring* ring = nullptr;
+        ~RingOwner();
+    };
+
+    std::mutex rings_mutex; // protects rings (only taken on thread registration and while draining)
+    std::mutex drain_mutex; // serializes drain() calls
+    std::vector<Ring*> rings; // rings of all threads that logged so far
+    std::atomic<uint64_t> dropped{0}; // records dropped because of full rings
+    std::atomic<int> min_level{0}; // records below this level are not recorded (see set_min_level)
+    std::thread drain_thread; // background drain thread
+
+    Logger();
+    Ring* thread_ring();
+    void drain();
+    static void format_record(const Record& record, std::string& out);
+};
+
+#define QUORIDOR_LOG(level, fields, ...) \
+    do { \
+        if constexpr (static_cast<int>(level) >= QUORIDOR_LOG_LEVEL) { \
+            Logger::instance().log(level, fields, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(fields, ...) QUORIDOR_LOG(LogLevel::DEBUG, fields, __VA_ARGS__)
+#define LOG_INFO(fields, ...) QUORIDOR_LOG(LogLevel::INFO, fields, __VA_ARGS__)
+#define LOG_WARNING(fields, ...) QUORIDOR_LOG(LogLevel::WARNING, fields, __VA_ARGS__)
+#define LOG_ERROR(fields, ...) QUORIDOR_LOG(LogLevel::ERROR, fields, __VA_ARGS__)
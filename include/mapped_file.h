@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Read only memory mapping of a file (unmapped on destruction).
+ */
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { unmap(); }
+
+    // Map the whole file (replacing a previous mapping), sequential tells the kernel to read ahead for scans
+    bool map(const std::string& path, bool sequential);
+    void unmap();
+
+    const char* data = nullptr;
+    size_t size = 0;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Subsystem a heap allocation is charged to, set per thread by MemoryScope
+enum class MemoryTag : uint8_t {
+    OTHER = 0, // outside any scope (startup, timers, admin commands)
+    NETWORK, // connection threads: transports, line buffers, spectator queues
+    PROTOCOL, // messages: parsed fields and serialized wire strings
+    GAME, // games and players (pool slabs), moves and snapshots
+    LOGGING, // log rings and formatted output
+    ANALYSIS, // analysis cache, queue and results
+    JOURNAL, // journal rings and write batches
+    COUNT
+};
+
+/**
+ * @brief Heap usage per subsystem. The global operator new and delete are replaced (with QUORIDOR_MEMORY_ACCOUNTING):
+ * every block carries a 16 byte header with its size and the tag current on the allocating thread, so a block is
+ * charged back to the same subsystem whichever thread frees it. Counts are sharded per thread like Counter, the
+ * peak is refreshed from the shard sums every PEAK_SAMPLE allocations of a shard and for every large block, so it
+ * can miss spikes shorter than that. malloc calls (C libraries) and thread stacks are not part of it.
+ */
+class MemoryAccounting {
+public:
+    static constexpr size_t TAGS = static_cast<size_t>(MemoryTag::COUNT);
+    static constexpr size_t SHARDS = 16;
+    static constexpr uint64_t PEAK_SAMPLE = 64; // allocations of a shard between peak updates
+    static constexpr size_t LARGE_BLOCK = 64 * 1024; // blocks at least this large update the peak right away
+
+    struct Usage {
+        int64_t bytes = 0; // requested bytes in use (headers not included)
+        int64_t peak = 0; // highest bytes seen
+        uint64_t allocations = 0; // since start
+        uint64_t frees = 0; // since start
+    };
+
+    static MemoryAccounting& instance();
+    // False if the process was built without QUORIDOR_MEMORY_ACCOUNTING (all usage is then zero)
+    static bool enabled();
+    // Name of a tag in reports
+    static const char* tag_name(MemoryTag tag);
+
+    void record_allocation(MemoryTag tag, size_t bytes);
+    void record_free(MemoryTag tag, size_t bytes);
+    Usage usage(MemoryTag tag) const;
+    // Usage of all tags together (peak of the sum, not the sum of the peaks)
+    Usage total() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<int64_t> bytes[TAGS]; // may go negative, blocks are often freed by another thread
+        std::atomic<uint64_t> allocations[TAGS];
+        std::atomic<uint64_t> frees[TAGS];
+    };
+
+    // trivial, the instance is constant initialized and usable by allocations before main
+    MemoryAccounting() = default;
+    int64_t bytes_of(size_t tag) const;
+    void refresh_peaks(size_t tag);
+
+    std::array<Shard, SHARDS> shards;
+    std::atomic<int64_t> peaks[TAGS];
+    std::atomic<int64_t> total_peak;
+};
+
+/**
+ * @brief Charges the heap allocations of the calling thread to a tag until the scope ends (scopes nest).
+ */
+class MemoryScope {
+public:
+    explicit MemoryScope(MemoryTag tag);
+    ~MemoryScope();
+    MemoryScope(const MemoryScope&) = delete;
+    MemoryScope& operator=(const MemoryScope&) = delete;
+
+    // Tag allocations of the calling thread are charged to
+    static MemoryTag current();
+
+private:
+    MemoryTag previous; // restored when the scope ends
+};
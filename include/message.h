@@ -1,12 +1,16 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <map>
+#include <memory>
 #include <optional>
 #include <vector>
+#include "pool_allocator.h"
 
 // Forward declarations
 class Player;
 class QuoridorGame;
+struct Analysis;
 
 // Enum class for the message type
 enum class MessageType {
@@ -24,9 +28,16 @@ enum class MessageType {
     HEARTBEAT,
     PLAYER_DISCONNECTED,
     PLAYER_RECONNECTED,
-    ABANDON
+    ABANDON,
+    SPECTATE,
+    PREMOVE,
+    ANALYZE,
+    ANALYSIS
 };
 
+// Serialized message in wire format (newline and terminating zero), shared by all recipients of a broadcast
+using WireBuffer = std::shared_ptr<const std::string>;
+
 /**
  * @brief Message class for communication between server and client
  * It is used to create, parse and validate messages. Created message contains type and data fields.
@@ -36,14 +47,20 @@ enum class MessageType {
 class Message {
 private:
     MessageType type;
-    std::map<std::string, std::string> data;
+    // nodes come from a pool, parsing a move or building a reply does not call malloc for them
+    std::map<std::string, std::string, std::less<std::string>, PoolAllocator<std::pair<const std::string, std::string>>> data;
 
     // Helper methods for creating messages with specific data
-    void add_players(std::vector<Player*> player);
+    void add_players(const std::vector<Player*>& players);
     void add_walls(const std::vector<std::pair<int, int>>& horizontal_walls, bool is_horizontal);
+    // cells as "[r,c],[r,c]" ("[]" if there are none)
+    void add_cells(const char* key, const std::vector<std::pair<int, int>>& cells);
+    // append the value of a cell list or of the players field (shared by the data map and the direct NEXT_TURN writer)
+    static void append_cells(std::string& value, const std::vector<std::pair<int, int>>& cells);
+    static void append_players(std::string& value, const std::vector<Player*>& players);
 
     // Helper method for extracting data from string
-    bool extract_data(const std::string& data_str);
+    bool extract_data(std::string_view data_str);
 public:
     // Constructors
     Message(); // Default constructor type = WRONG_MESSAGE
@@ -58,6 +75,10 @@ public:
 
     // Convert message to string
     std::string to_string() const;
+    // Append serialized message to the given buffer (lets callers reuse one buffer for many messages)
+    void serialize_to(std::string& buffer) const;
+    // Serialize once for sending to many recipients
+    WireBuffer to_wire() const;
 
     // Check if message has all required fields
     bool validate() const;
@@ -69,11 +90,15 @@ public:
     static Message create_game_ended(QuoridorGame* game, Player* player);
     static Message create_error(const std::string& message);
     static Message create_next_turn(QuoridorGame* game);
+    // NEXT_TURN serialized straight into a wire buffer, same text as create_next_turn(game).to_wire() (move path)
+    static WireBuffer create_next_turn_wire(QuoridorGame* game);
     static Message create_name_request();
     static Message create_heartbeat();
+    static Message create_heartbeat(uint32_t sequence, int64_t timestamp_us); // echoed by the client in its ACK
     static Message create_player_disconnected(Player* player);
     static Message create_player_reconnected(Player* player);
     static Message create_ack();
+    static Message create_analysis(size_t lobby_id, uint32_t turn, const Analysis& analysis);
 
     // Type conversion
     static std::string message_type_to_string(MessageType type);
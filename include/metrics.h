@@ -0,0 +1,161 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+/**
+ * @brief Counter sharded per thread. Every thread increments its own cache line, so hot paths never contend.
+ * Reading the value sums all shards (relaxed, the value may be slightly behind while threads are writing).
+ */
+class Counter {
+public:
+    static constexpr size_t SHARDS = 16; // number of shards (threads are spread over them)
+
+    void add(uint64_t value = 1);
+    uint64_t value() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard, SHARDS> shards;
+};
+
+/**
+ * @brief Gauge holds a single value that can go up and down (e.g. number of active games).
+ */
+class Gauge {
+public:
+    void add(int64_t delta) { current.fetch_add(delta, std::memory_order_relaxed); }
+    void set(int64_t value) { current.store(value, std::memory_order_relaxed); }
+    int64_t value() const { return current.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> current{0};
+};
+
+/**
+ * @brief Latency histogram with HDR style log-linear buckets (values in nanoseconds).
+ * Each power of two range is split into SUB_BUCKETS linear buckets, which keeps relative error under ~12%
+ * for the whole 64 bit range. Recording is one bucket lookup and two relaxed atomic adds on a per-thread shard.
+ */
+class Histogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 3;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    static constexpr size_t SHARDS = 4;
+
+    // Record one sample
+    void record(uint64_t value);
+
+    // Merged view of all shards
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t p50 = 0;
+        uint64_t p99 = 0;
+        uint64_t p999 = 0;
+        uint64_t max = 0;
+    };
+    Summary summarize() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum{0};
+        std::array<std::atomic<uint64_t>, BUCKETS> buckets{};
+    };
+    std::array<Shard, SHARDS> shards;
+
+    static int bucket_index(uint64_t value);
+    static uint64_t bucket_upper_bound(int index);
+};
+
+/**
+ * @brief ScopedTimer records the lifetime of the scope into a histogram (in nanoseconds).
+ */
+class ScopedTimer {
+public:
+    explicit ScopedTimer(Histogram& histogram) : histogram(histogram), start(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        histogram.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    ScopedTimer(const ScopedTimer&) = delete;
+    ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+    Histogram& histogram;
+    std::chrono::steady_clock::time_point start;
+};
+
+/**
+ * @brief Metrics is the process wide registry of all server metrics.
+ * Metrics are plain members so call sites reach them without any lookup: Metrics::instance().moves.add();
+ */
+class Metrics {
+public:
+    static Metrics& instance();
+
+    // connections and games
+    Counter connections_accepted; // accepted TCP connections
+    Gauge open_connections; // connections currently served by a client thread
+    Gauge active_games; // games currently stored in the server
+    Gauge retired_games; // ended games taken out of the server, deleted once no thread uses them anymore
+    Counter games_started; // games created by matchmaking
+    Counter reconnections; // players that came back to their game
+    Counter heartbeat_timeouts; // players that stopped responding (temporary disconnects)
+    Counter disconnections; // players that were removed from their game for good
+    Counter connections_rejected; // connections closed at admission (connection cap, address rate or overload)
+    Counter messages_rate_limited; // client messages dropped by the per connection rate limit
+    Gauge scheduler_lag_us; // smoothed wakeup lag of the server threads (load shedding input)
+    Histogram heartbeat_rtt_ns; // round trip time of heartbeats echoed by the clients
+    Counter heartbeats_sent; // explicit heartbeats (only sent on quiet connections)
+    Counter acks_suppressed; // heartbeats of clients not answered because other traffic already went out
+
+    // moves
+    Counter moves; // applied moves
+    Counter invalid_moves; // rejected moves (wrong turn, invalid structure or illegal move)
+    Counter premoves_played; // queued premoves played right after the opponent's move
+    Counter premoves_rejected; // queued premoves that were illegal in the resulting position
+    Counter flag_falls; // games lost on time
+    Counter worker_restarts; // game worker processes that exited and were started again (front-end)
+    Histogram wall_validation_ns; // time spent validating wall placements
+    Histogram send_latency_ns; // time spent in send() per message
+
+    // spectators
+    Gauge spectators; // spectators currently watching a game
+    Counter spectator_updates; // updates sent to spectators
+    Counter spectator_conflated; // updates replaced by a newer one before a slow spectator received them
+    Counter spectators_dropped; // spectators disconnected because they fell too far behind
+
+    // analysis
+    Counter analysis_requests; // positions clients asked the engine about
+    Counter analysis_cache_hits; // requests answered from the analysis cache
+    Counter analysis_rejected; // requests refused because the analysis queue was full
+    Histogram analysis_ns; // time spent analysing a position (cache misses only)
+
+    // memory (heap usage per subsystem comes from MemoryAccounting)
+    Gauge live_players; // Player objects allocated (compare with open_connections to spot leaked players)
+    Gauge live_games; // QuoridorGame objects allocated
+
+    // journal
+    Counter journal_events; // game events written to the journal
+    Counter journal_dropped; // game events lost (full thread ring or failed write)
+
+    // Text snapshot of all metrics (one "name value" per line)
+    std::string snapshot();
+
+private:
+    Metrics();
+
+    std::chrono::steady_clock::time_point start_time; // when the registry was created
+    std::mutex snapshot_mutex; // protects the previous snapshot values below
+    std::chrono::steady_clock::time_point last_snapshot_time; // time of the previous snapshot
+    uint64_t last_snapshot_moves = 0; // moves at the previous snapshot (for moves/sec)
+    uint64_t last_snapshot_allocations = 0; // heap allocations at the previous snapshot (for allocations/sec)
+};
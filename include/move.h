@@ -13,13 +13,15 @@ public:
     bool is_valid_structure;
     std::vector<std::pair<int, int>> position; // if it is a wall there will be two positions
 
-    Move(bool is_horizontal, std::vector<std::pair<int, int>> position, int player_id); // currently not used
+    Move(bool is_horizontal, std::vector<std::pair<int, int>> position, int player_id); // used by the benchmarks and the journal replay
     // constructor for creating a move from a message
-    Move(Message message);
+    explicit Move(const Message& message);
+    // decode a message into this move, the position buffer is reused (client threads keep one Move for all messages)
+    void decode(const Message& message);
 
     //getters
     bool get_is_horizontal() const;
-    std::vector<std::pair<int, int>> get_position() const;
+    const std::vector<std::pair<int, int>>& get_position() const;
     bool get_is_valid_structure() const;
     int get_player_id() const;
     //setters
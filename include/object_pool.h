@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+/**
+ * @brief ObjectPool is a slab allocator for objects of a single type.
+ * Memory is taken from the system in slabs of SLAB_SIZE slots and freed slots are kept on a free list,
+ * so once the pool is warmed up creating and deleting objects does not call malloc at all.
+ * Slabs are never returned to the system while the pool is alive.
+ */
+template <typename T, size_t SLAB_SIZE = 64>
+class ObjectPool {
+private:
+    union Slot {
+        Slot* next; // next free slot (valid only while the slot is free)
+        alignas(T) unsigned char storage[sizeof(T)]; // storage for the object
+    };
+
+    std::mutex pool_mutex; // mutex for thread safety
+    Slot* free_list = nullptr; // first free slot
+    std::vector<std::unique_ptr<Slot[]>> slabs; // all slabs allocated by the pool
+    size_t live_objects = 0; // number of slots currently handed out
+
+    // Allocate a new slab and push all of its slots to the free list (pool_mutex must be held)
+    void grow() {
+        std::unique_ptr<Slot[]> slab(new Slot[SLAB_SIZE]);
+        for (size_t i = 0; i < SLAB_SIZE; ++i) {
+            slab[i].next = free_list;
+            free_list = &slab[i];
+        }
+        slabs.push_back(std::move(slab));
+    }
+
+public:
+    ObjectPool() = default;
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    // Returns uninitialized storage for one T
+    void* allocate() {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (free_list == nullptr) {
+            grow();
+        }
+        Slot* slot = free_list;
+        free_list = slot->next;
+        ++live_objects;
+        return slot->storage;
+    }
+
+    // Returns storage previously obtained from allocate() back to the pool
+    void deallocate(void* ptr) {
+        if (ptr == nullptr) return;
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        Slot* slot = reinterpret_cast<Slot*>(ptr);
+        slot->next = free_list;
+        free_list = slot;
+        --live_objects;
+    }
+
+    // Number of objects currently allocated from the pool
+    size_t live_count() {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        return live_objects;
+    }
+
+    // Number of slots the pool owns (allocated or free)
+    size_t capacity() {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        return slabs.size() * SLAB_SIZE;
+    }
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "rules.h"
+
+/**
+ * @brief Moves for the first plies of a game, looked up instead of searched. Early positions repeat across games
+ * and have the most wall candidates, so quoridor_book collects the positions recorded games reached in their first
+ * plies and stores one move per position: the most successful recorded move, or the engine's move where the
+ * recorded games did not settle on a good one.
+ *
+ * File: [magic][version][entry count][entries sorted by position key]. A lookup is a binary search in the mapped
+ * entries, positions are only identified by their 64 bit key, so a caller checks that the move is legal.
+ */
+class OpeningBook {
+public:
+    static constexpr char MAGIC[8] = {'Q', 'B', 'O', 'O', 'K', '0', '0', '1'};
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    // Where the move of an entry comes from
+    enum class Source : uint8_t { GAMES = 0, ENGINE = 1 };
+
+    /**
+     * @brief Book move of one position, stored as is in the file.
+     */
+    struct Entry {
+        uint64_t key; // position_key of the position and the player to move
+        uint32_t games; // recorded games that reached the position
+        uint32_t wins; // of those, games the player to move won after playing the book move
+        uint8_t source; // Source of the move
+        uint8_t flags; // JOURNAL_MOVE_WALL and JOURNAL_MOVE_HORIZONTAL, as in the journal
+        uint8_t cells[4]; // row and column of the first and second cell (the second only for a wall)
+        uint8_t reserved[2];
+    };
+    static_assert(sizeof(Entry) == 24, "book entries are written as they are");
+
+    // Key of a position with to_move to play, the same walls and pawns on another board are a different position
+    static uint64_t position_key(const VariantPosition& position, int to_move);
+    // Write the entries of book to path (atomically, temporary file, fsync and rename), of entries with the same key
+    // the first is kept
+    static bool write(const std::string& path, std::vector<Entry>& book);
+
+    // Map a book file, false if it is missing or malformed
+    bool open(const std::string& path);
+    size_t entry_count() const { return count; }
+    // Book move of a position, false if the position is not in the book
+    bool probe(const VariantPosition& position, int to_move, Entry& entry) const;
+
+private:
+    MappedFile file;
+    const Entry* entries = nullptr; // count entries sorted by key, inside the mapping
+    size_t count = 0;
+};
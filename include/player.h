@@ -3,14 +3,23 @@
 #include <utility>
 #include "message.h"
 #include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include "transport.h"
+#include "link_monitor.h"
+#include "rate_limiter.h"
+#include "rules.h"
 
 /**
  * @brief Class Player represents player inside the game. Player is created as soon as the connection is established.
  * 
  */
 class Player {
+private:
+    std::shared_ptr<Transport> transport; // connection to the client (replaced on reconnection)
+
 public:
-    int socket; // socket for communication
     std::string name; // player name
     std::pair<int, int> position; // player position on the board
     int walls_left; // number of walls left
@@ -21,22 +30,51 @@ public:
     std::chrono::steady_clock::time_point last_heartbeat; // last time the player sent a message
     bool is_connected; // flag for connection status
     bool is_reconnecting; // flag for reconnection status
+    LinkMonitor link; // round trip time, jitter and disconnect suspicion of the connection
     char board_char; // character representing the player on the board
     static constexpr int HEARTBEAT_INTERVAL = 5; // seconds
     static constexpr int NORMAL_HEARTBEAT_TIMEOUT = 15; // seconds
     static constexpr int RECONNECTION_HEARTBEAT_TIMEOUT = 120; // 2 minutes to reconnect
+    static constexpr double MESSAGES_PER_SECOND = 20; // sustained inbound message rate of a connection
+    static constexpr double MESSAGE_BURST = 40; // messages a connection may send at once
+    static constexpr size_t MAX_DROPPED_MESSAGES = 200; // rate limited messages before the client is disconnected
+    TokenBucket inbound_limit{MESSAGES_PER_SECOND, MESSAGE_BURST}; // rate limit of messages from the client
+    size_t dropped_messages = 0; // messages dropped by the rate limit
+    Variant variant = Variant::STANDARD; // variant the player asked for, players are only matched within a variant
+    // held by a waiting player's thread while it reads the connection and by matchmaking while it hands the connection
+    // to a game worker, so the thread never reads bytes that belong to the worker (see game_id)
+    std::mutex handoff_mutex;
 
     // Constructor
-    explicit Player(int sock);
+    explicit Player(std::shared_ptr<Transport> transport);
+
+    // Players are allocated from a shared object pool instead of the general heap
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr, std::size_t size);
+    // Number of Player objects currently alive
+    static size_t live_count();
 
     // Send message to the player
     void send_message(const std::string& message);
     void send_message(const Message& message); // send message object
+    void send_wire(const WireBuffer& wire); // send a message serialized once for many recipients
+
+    // Connection of the player (safe to call while another thread replaces it)
+    std::shared_ptr<Transport> get_transport() const;
+    void set_transport(std::shared_ptr<Transport> transport);
 
     // Update heartbeat
     void update_heartbeat();
-    // Check if the player is connected
+    // Check if the player is connected (the link is not suspected to be gone)
     bool check_connection();
+    // True if the client was silent and not probed for HEARTBEAT_INTERVAL (any message from it counts as liveness)
+    bool heartbeat_due() const;
+    // Send a sequenced heartbeat, the echo in the ACK measures the round trip time
+    void send_heartbeat();
+    // Answer a heartbeat of the client, dropped if other messages went out within HEARTBEAT_INTERVAL
+    void acknowledge_heartbeat();
+    // ACK from the client, records the round trip time if it echoes one of our heartbeats
+    void handle_ack(const Message& message);
 
     // Setters and getters
     void set_id(std::string id);
@@ -52,4 +90,10 @@ public:
     int get_game_id() const;
     void set_board_char(char board_char);
     char get_board_char() const;
+
+private:
+    // Append newline and send the buffer over the socket
+    void send_buffer(std::string& buffer);
+    // Send a line that already ends with a newline
+    void send_line(const std::string& line);
 }; 
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstddef>
+#include <new>
+#include "object_pool.h"
+
+/**
+ * @brief STL compatible allocator that serves single objects from an ObjectPool per type.
+ * Node based containers (map, unordered_map) and shared_ptr control blocks allocate one object at a time,
+ * so with this allocator they stop calling malloc once the pool is warmed up. Arrays (n > 1, hash buckets)
+ * go to the general heap. The pools are shared by all instances and never destroyed, memory handed out by
+ * them may be freed from any thread and after static destruction started.
+ */
+template <typename T>
+class PoolAllocator {
+public:
+    using value_type = T;
+
+    PoolAllocator() = default;
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) {
+        if (n != 1) return static_cast<T*>(::operator new(n * sizeof(T)));
+        return static_cast<T*>(pool().allocate());
+    }
+    void deallocate(T* ptr, size_t n) {
+        if (n != 1) {
+            ::operator delete(ptr);
+            return;
+        }
+        pool().deallocate(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U>&) const { return false; }
+
+private:
+    static ObjectPool<T>& pool() {
+        static ObjectPool<T>* objects = new ObjectPool<T>();
+        return *objects;
+    }
+};
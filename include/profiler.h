@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Profiler collects timed zones from hot paths and exports them as Chrome trace-event JSON
+ * (open the output in chrome://tracing or https://ui.perfetto.dev).
+ * Every thread records into its own fixed-size ring, so recording is lock-free and keeps only the most recent
+ * EVENTS_PER_THREAD zones of each thread. Zones exist only when built with QUORIDOR_PROFILING,
+ * otherwise PROFILE_ZONE expands to nothing.
+ */
+class Profiler {
+public:
+    static constexpr size_t EVENTS_PER_THREAD = 4096; // ring size per thread (must be power of two)
+
+    static Profiler& instance();
+
+    // Record one finished zone (name must be a string literal)
+    void record(const char* name, int64_t start_ns, int64_t duration_ns);
+
+    // Chrome trace-event JSON with the recent zones of all threads
+    std::string dump_chrome_trace();
+
+    // Monotonic time in nanoseconds used for zone timestamps
+    static int64_t now_ns() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+private:
+    struct Event {
+        const char* name;
+        int64_t start_ns;
+        int64_t duration_ns;
+    };
+
+    struct ThreadBuffer {
+        int thread_id; // sequential id shown as tid in the trace
+        Event events[EVENTS_PER_THREAD];
+        std::atomic<uint64_t> written{0}; // total events written (index of the next slot)
+        std::atomic<bool> retired{false}; // owning thread exited
+    };
+
+    // Marks the buffer of a thread as retired when the thread exits
+    struct BufferOwner {
+        ThreadBuffer* buffer = nullptr;
+        ~BufferOwner();
+    };
+
+    std::mutex buffers_mutex; // protects buffers (registration and dump only)
+    std::vector<ThreadBuffer*> buffers; // buffers of all threads that recorded zones
+    int next_thread_id = 1; // id for the next registered thread
+
+    Profiler() = default;
+    ThreadBuffer* thread_buffer();
+};
+
+/**
+ * @brief ProfileZone records the time between its construction and destruction under the given name.
+ */
+class ProfileZone {
+public:
+    explicit ProfileZone(const char* name) : name(name), start_ns(Profiler::now_ns()) {}
+    ~ProfileZone() { Profiler::instance().record(name, start_ns, Profiler::now_ns() - start_ns); }
+    ProfileZone(const ProfileZone&) = delete;
+    ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+    const char* name;
+    int64_t start_ns;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef QUORIDOR_PROFILING
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#else
+#define PROFILE_ZONE(name) do {} while (0)
+#endif
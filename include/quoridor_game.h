@@ -1,20 +1,28 @@
 #pragma once
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <optional>
 #include "player.h"
 #include "game_state.h"
 #include "message.h"
 #include "move.h"
+#include "rules.h"
+#include "journal.h"
+#include "game_snapshot.h"
+#include "spectator.h"
+#include "timer_service.h"
+#include "game_reclaimer.h"
 
 
 /**
  * @brief Class QuoridorGame represents the game logic for the Quoridor game. It is responsible for handling player moves, game state, and game logic.
- * Quoridor game is created in the server.
+ * Quoridor game is created in the server. The rules are checked by the Rules instantiation of the variant of the lobby.
  */
 class QuoridorGame {
 private:
     // Constants
-    static constexpr int BOARD_SIZE = 9;
+    static constexpr int MAX_BOARD_SIZE = Rules<11, 2>::SIZE; // largest hosted variant
     static constexpr char EMPTY_CELL = 'X';
     static constexpr char PLAYER_1_CELL = '1';
     static constexpr char PLAYER_2_CELL = '2';
@@ -23,38 +31,85 @@ private:
     std::vector<Player*> players; // players in the game
     std::vector<std::pair<int, int>> horizontal_walls; // horizontal walls on the board
     std::vector<std::pair<int, int>> vertical_walls; // vertical walls on the board
-    char board[BOARD_SIZE][BOARD_SIZE]; // the board represented by a 2D array
+    char board[MAX_BOARD_SIZE][MAX_BOARD_SIZE]; // the board represented by a 2D array (board_size x board_size used)
+    Variant variant; // board and time control of the lobby
+    int board_size; // rows and columns of the board of the variant
+    VariantPosition rules_position; // walls and pawns as the rules engine of the variant sees them
     GameState state; // current game state
     int current_player; // index of the current player in the players vector
     std::mutex game_mutex; // mutex for thread safety
     size_t lobby_id; // id of the lobby (not used in the current implementation)
+    std::atomic<uint32_t> journal_sequence{0}; // sequence number of the next journaled event of this game
+    std::shared_ptr<SnapshotSlot> snapshot_slot; // latest published state, shared with admin views
+    uint32_t turn = 0; // moves played
+    std::optional<Move> premove; // move queued by the player waiting for its turn (protected by game_mutex)
+    int64_t clock_ms[2]; // time left of each player at turn_started
+    Clock::time_point turn_started; // when the clock of the current player started running
+    TimerService::TimerId flag_timer = 0; // flag-fall deadline of the current player (0 = none)
+    std::mutex spectators_mutex; // protects spectators and latest_update
+    std::vector<std::shared_ptr<Spectator>> spectators; // read-only watchers of the game
+    WireBuffer latest_update; // last NEXT_TURN, sent to spectators when they join
+    GameReclaimer* reclaimer = nullptr; // told when the game ended and when it became unused (none for replays)
+    std::atomic<int> references{0}; // threads that may still use the game (connection threads, heartbeat checker)
+    bool unconnected[2] = {false, false}; // player restored without a connection and not back yet (server_mutex)
 
     // initialization methods (used at the beginning of the game)
     void initialize_players();
     void initialize_board();
+    // rebuild the engine position from players and wall lists (start of the game and restore)
+    void load_rules_position();
 
     // game logic methods
-    void apply_player_move(Move move);
-    void apply_move(Move move);
+    void apply_player_move(const Move& move);
+    void apply_move(const Move& move);
+    // apply a validated move of the current player, count, journal and publish it
+    void play_move(const Move& move);
     bool check_game_end();
-    bool is_valid_player_move(Move move);
-    bool is_valid_wall_move(Move move);
-    bool is_wall_between(int row1, int col1, int row2, int col2);
-    bool is_blocked(Move move);
-    // bfs for checking if the player can reach the goal
-    bool bfs(Player* player);
-
-    // helper methods
-    void remove_move(Move move);
+    bool is_valid_player_move(const Move& move);
+    bool is_valid_wall_move(const Move& move);
 
     // checks if all players are connected
     void check_player_connections();
 
+    // clocks: charge the time of the turn to mover and add the increment, then run the clock of the next player
+    void charge_clock(int mover);
+    // (re)schedule the flag-fall of the current player on the shared timer service
+    void schedule_flag_fall();
+    // timer callback, ends the game if the clock of the current player really ran out
+    void handle_flag_fall();
+    // true if the current player has no time left
+    bool is_flag_down() const;
+
+    // publish a snapshot of the current state (called by the thread that changed the game)
+    void publish_snapshot();
+    // hand the game to the reclaimer, called once by the path that ended it
+    void report_end();
+
+    // queue an update for all spectators (NEXT_TURN and GAME_ENDED are forwarded, other messages are for players)
+    void broadcast_to_spectators(const WireBuffer& wire, MessageType type);
+    // let spectators receive their queued updates and disconnect them (game ended)
+    void finish_spectators();
+
+    // fill in game id, sequence and time of the event and record it in the journal
+    void journal_event(JournalEvent& event);
+    // journal an event about one player (disconnect, reconnect, game end)
+    void journal_player_event(JournalEventType type, Player* player, uint8_t flags);
+    int player_index(const Player* player) const;
+
+    // microbenchmarks (tools/benchmark.cpp) set up positions and call the rule checks directly
+    friend class GameBenchmark;
+
 public:
     // Constructor and destructor
-    QuoridorGame();
+    explicit QuoridorGame(Variant variant = Variant::STANDARD);
     ~QuoridorGame();
 
+    // Games are allocated from a shared object pool instead of the general heap
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr, std::size_t size);
+    // Number of QuoridorGame objects currently alive
+    static size_t live_count();
+
 
     // add player to the game (used by server)
     bool add_player(Player* player);
@@ -63,7 +118,13 @@ public:
     void initialize_game();
     
     // notify all players in the game with a message
-    void notify_all_players(Message message);
+    void notify_all_players(const Message& message);
+    // send an already serialized message to all players and spectators
+    void notify_all_players(const WireBuffer& wire, MessageType type);
+
+    // add a read-only watcher, returns false if the game is not in progress
+    bool add_spectator(std::shared_ptr<Spectator> spectator);
+    size_t spectator_count();
 
     // handle player disconnection of a player
     void handle_player_disconnection(Player* player);
@@ -72,17 +133,48 @@ public:
     void start_heartbeat_checker();
 
     // handle player move (called by server) (client thread)
-    bool can_move(Move move);
+    bool can_move(const Move& move);
     
     // handle player move (called by server)
-    void handle_move(Move move);
+    void handle_move(const Move& move);
+    // queue a move of the waiting player, it is validated and played as soon as the opponent moved
+    void handle_premove(const Move& move);
 
     // Send board and current player turn
     void send_next_turn();
 
-    // handle game end (notify all players and set the game state)
-    void handle_game_end();
-
+    // handle game end (notify all players and set the game state), the player to move lost (reason is journaled)
+    void handle_game_end(uint8_t reason = JOURNAL_END_GOAL);
+
+    // end the game without a winner (operator command), returns false if it was not in progress
+    bool force_end();
+
+    // latest snapshot of the game (nullptr before the game started)
+    std::shared_ptr<const GameSnapshot> get_snapshot() const;
+    // slot the snapshots are published to, it stays valid after the game is deleted
+    std::shared_ptr<SnapshotSlot> get_snapshot_slot() const;
+    // continue a game from a snapshot without notifications (heartbeat checker is started by the caller)
+    void restore(const GameSnapshot& snapshot, Player* player1, Player* player2);
+
+    // replay of journaled games: start a game without notifications and without the heartbeat checker
+    void start_replay(Player* player1, Player* player2);
+    // replay a move of the current player, returns false (and applies nothing) if the move is illegal
+    bool replay_move(const Move& move);
+
+
+    // reclaimer the game reports its end to, set by the server before the game starts
+    void set_reclaimer(GameReclaimer* reclaimer);
+    // keep the game alive while the calling thread uses it (the server only acquires games it still holds)
+    void acquire();
+    // drop a reference, the game may be deleted as soon as this returns
+    void release();
+    // threads holding a reference
+    int reference_count() const;
+    // mark a player as restored without a connection (true) or reconnected (false), called with server_mutex held
+    void set_unconnected(const Player* player, bool unconnected);
+    // delete the players that never had a connection (restored from a snapshot and did not come back), players
+    // with a connection are deleted by their connection thread (called by the reclaimer before deleting the game)
+    void delete_unconnected_players();
 
     // getters and setters
     size_t get_lobby_id() const;
@@ -90,14 +182,22 @@ public:
 
     //getters and setters
     std::string get_board_string() const;
+    // append the board string to out (NEXT_TURN is written into a reused buffer)
+    void append_board_string(std::string& out) const;
     int get_current_player() const; 
+    Variant get_variant() const;
+    int get_board_size() const;
+    // time added to the clock of a player with every move (time control of the variant)
+    int64_t get_clock_increment_ms() const;
+    // time left of a player in milliseconds (the clock of the player to move is running)
+    int64_t get_clock_ms(int player_index) const;
     void set_current_player(int current_player);
     GameState get_state() const;
-    std::vector<std::pair<int, int>> get_horizontal_walls() const;
-    std::vector<std::pair<int, int>> get_vertical_walls() const;
+    const std::vector<std::pair<int, int>>& get_horizontal_walls() const;
+    const std::vector<std::pair<int, int>>& get_vertical_walls() const;
     void set_horizontal_walls(const std::vector<std::pair<int, int>>& horizontal_walls);
     void set_vertical_walls(const std::vector<std::pair<int, int>>& vertical_walls);
-    std::vector<Player*> get_players() const;
+    const std::vector<Player*>& get_players() const;
     void set_players(const std::vector<Player*>& players);
     
 }; 
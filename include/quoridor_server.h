@@ -3,7 +3,43 @@
 #include <vector>
 #include <mutex>
 #include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <string>
 #include "quoridor_game.h"
+#include "game_reclaimer.h"
+#include "admin_server.h"
+#include "clock.h"
+#include "lag_monitor.h"
+#include "rate_limiter.h"
+#include "worker_pool.h"
+
+/**
+ * @brief Read-only view of the server for admin commands. A new view is published (copy, change, atomic pointer swap)
+ * whenever games, waiting players or connections change, readers only load the pointer. Introspection therefore never
+ * takes server_mutex and never blocks a game, live game state (turn, positions) comes from the snapshot slots.
+ */
+struct ServerView {
+    struct Game {
+        size_t lobby_id;
+        std::shared_ptr<SnapshotSlot> snapshot; // latest published state of the game
+    };
+    struct Waiting {
+        std::string name;
+        Clock::time_point since; // when the player started waiting
+    };
+    struct Connection {
+        std::shared_ptr<Transport> transport; // keeps the transport alive for reading its statistics
+        std::string name; // empty until the client sent its name
+        std::shared_ptr<Spectator> spectator; // set for spectators (their update queue depth is reported)
+        Clock::time_point connected_at;
+    };
+
+    std::vector<Game> games;
+    std::vector<Waiting> waiting;
+    std::vector<Connection> connections;
+};
 
 
 /**
@@ -15,50 +51,118 @@ private:
 
     // Constant for the maximum number of games
     static constexpr size_t MAX_GAMES = 50;
+    // Directory of the game journal (relative to the working directory)
+    static constexpr const char* JOURNAL_DIRECTORY = "journal";
+    // Snapshot of all games in progress (relative to the working directory), restored on startup
+    static constexpr const char* SNAPSHOT_FILE = "games.snapshot";
+    static constexpr int SNAPSHOT_INTERVAL_SECONDS = 2;
+    // Solved races for analysis requests (relative to the working directory, built by quoridor_tablebase), optional
+    static constexpr const char* TABLEBASE_FILE = "races.qtb";
+    // Opening moves for analysis requests (relative to the working directory, built by quoridor_book), optional
+    static constexpr const char* BOOK_FILE = "openings.qbk";
+    // Version of the hot restart state format, both processes must use the same one
+    static constexpr uint32_t HANDOFF_VERSION = 4;
+    // How long the old process waits for its client threads to stop during a hot restart
+    static constexpr int HANDOFF_DRAIN_TIMEOUT_SECONDS = 3;
+    // Connections served at once (players, spectators and clients still sending their name)
+    static constexpr size_t MAX_CONNECTIONS = 1024;
+    // New connections per source address, loopback is exempt (local tools and the load generator)
+    static constexpr double CONNECTIONS_PER_SECOND_PER_ADDRESS = 5;
+    static constexpr double CONNECTION_BURST_PER_ADDRESS = 20;
+    static constexpr size_t MAX_TRACKED_ADDRESSES = 65536;
+    // Unfinished line a client may send before its name (same limit as an admin request), longer ones disconnect it
+    static constexpr size_t MAX_SETUP_LINE = 4096;
 
     int server_socket; // server socket
     std::vector<Player*> waiting_players; // players waiting for a match
-    std::map<size_t, QuoridorGame*> active_games; // active games
+    std::map<size_t, QuoridorGame*> active_games; // games in progress, an ended game is removed by the reclaimer
+    std::unique_ptr<GameReclaimer> reclaimer; // removes games as they end and deletes them once unused
     std::mutex server_mutex; // mutex for thread safety
     size_t game_id_counter; // counter for game ids
     std::atomic<bool> running{true}; // flag for the main server loop
-
-    // Thread for client message handling
-    void handle_client(int client_socket);
+    std::unique_ptr<AdminServer> admin_server; // local admin socket (stats and other operator commands)
+    std::unordered_map<const Transport*, bool> client_connections; // transports with a running client thread, true once a reconnection took their player over
+    std::mutex connections_mutex; // mutex for client_connections
+    std::shared_ptr<const ServerView> view; // published view for admin commands (atomic load/store)
+    std::mutex view_mutex; // serializes view updates, always taken last (after server_mutex or connections_mutex)
+    std::atomic<bool> draining{false}; // a new process takes over, client threads stop and leave their connections open
+    std::atomic<size_t> open_connections{0}; // connections with a client thread (bounded by MAX_CONNECTIONS)
+    AddressRateLimiter address_limiter{CONNECTIONS_PER_SECOND_PER_ADDRESS, CONNECTION_BURST_PER_ADDRESS,
+                                       MAX_TRACKED_ADDRESSES}; // connection rate per source address
+    LagMonitor lag_monitor; // scheduler lag, new connections are shed while the server is overloaded
+    std::string journal_directory = JOURNAL_DIRECTORY; // per worker in a front-end setup
+    std::string snapshot_file = SNAPSHOT_FILE; // per worker in a front-end setup
+    std::unique_ptr<WorkerPool> worker_pool; // set on a front-end, matched players are passed to the workers
+    int front_end_channel = -1; // set on a worker, connection to the front-end process
+    std::mutex front_end_mutex; // serializes records sent to the front-end, taken after server_mutex
+
+    // Thread for client message handling, resumed_player is set for connections taken over from a previous process
+    void handle_client(std::shared_ptr<Transport> transport, Player* resumed_player);
+    // Body of the client thread (setup, matchmaking, message loop and cleanup)
+    void serve_client(std::shared_ptr<Transport> transport);
+    // Message loop and cleanup of a player that is set up (matched or waiting)
+    void run_client(Player* player, Transport& transport);
     // Handles clients messages for the game
-    bool handle_game_message(QuoridorGame* game, Player* player, const char* message);
+    bool handle_game_message(QuoridorGame* game, Player* player, const Message& message);
     // Handles client messages for the server (if its for the game it calls handle_game_message)
-    bool validate_client_message(QuoridorGame* game, Player* player, const char* message_string, Message& message);
+    bool validate_client_message(QuoridorGame* game, Player* player, const Message& message, const Move& move);
 
     // Initialize new player
-    Player* initialize_player(int client_socket);
+    Player* initialize_player(std::shared_ptr<Transport> transport);
+
+    // Handle player name setup, spectate_lobby_id is set if the client asked to watch a game instead of playing
+    bool handle_player_name_setup(Player* player, size_t& spectate_lobby_id);
 
-    // Handle player name setup
-    bool handle_player_name_setup(Player* player);
+    // Stream a game to a read-only client until it leaves or the game ends
+    void serve_spectator(Player* player, size_t lobby_id);
+    // Queue the latest position of a game for the analysis threads, reply gets the answer or an error
+    void request_analysis(const SnapshotSlot& slot, std::function<void(const WireBuffer&)> reply);
+    // Let the analysis threads answer races and openings from the tablebase and book files if they exist
+    void load_analysis_files();
 
     // Handle matchmaking (wait/start game)
     bool handle_matchmaking(Player* player);
 
     // Create a new game once two players are matched
-    QuoridorGame* create_game(Player* player1, Player* player2);
+    QuoridorGame* create_game(Player* player1, Player* player2, size_t game_id);
+
+    // Front-end: reconnect the player through its worker or match it, the connection ends up on a worker
+    void serve_front_end_client(Player* player);
+    // Front-end: pass a matched pair to a worker (called with server_mutex held)
+    bool dispatch_match(Player* opponent, Player* player);
+    // Front-end: answer heartbeats of a waiting player until it is matched or leaves
+    void wait_for_match(Player* player);
+    // Front-end: drop the local copy of a connection that a worker took over
+    void release_to_worker(Player* player);
+    // Worker: start the game or reconnection the front-end sent
+    void handle_front_end_record(const std::vector<std::string>& fields, const std::vector<int>& fds);
+    // Worker: send a record to the front-end (ignored once the front-end is gone)
+    void report_to_front_end(const std::vector<std::string>& fields);
+    // Worker: start thread that periodically reports games, players and metrics to the front-end
+    void start_status_reporter();
 
     // Start a new thread for sending heartbeats
     void start_heartbeat_thread(Player* player);
 
     // Set socket timeout
-    void setup_socket_timeout(int client_socket);
+    void setup_socket_timeout(Transport& transport);
 
     // Main client loop is called after player is matched and successfully setup and it is just a loop for receiving messages
-    void main_client_loop(Player* player);
-    // Handle client message is called in the main client loop and it is used to receive and validate messages
-    bool handle_client_message(Player* player);
+    void main_client_loop(Player* player, Transport& transport);
+    // Handle client message is called in the main client loop and it is used to receive and validate messages,
+    // game is the game of the player the loop holds a reference to (acquired on first use)
+    bool handle_client_message(Player* player, Transport& transport, QuoridorGame*& game);
+    // Reference to the game of the player if it is still in progress, nullptr otherwise (release when done)
+    QuoridorGame* acquire_game(Player* player);
+    // Check if the player of this connection was taken over by a reconnection
+    bool is_superseded(const Transport& transport);
     // Check if the error ocured during receiving the message and handle it accordingly
     bool handle_receive_error(Player* player);
 
-    // Handle disconnection of a player (send message to the opponent and cleanup)
-    void handle_disconnection(Player* player);
+    // Handle disconnection of a player (send message to the opponent and cleanup), game as in handle_client_message
+    void handle_disconnection(Player* player, QuoridorGame*& game);
 
-    // Cleanup player (close socket and delete player)
+    // Cleanup player (close connection and delete player)
     void cleanup_player(Player* player);
 
     // Find a player with the same name that is disconnected (used for reconnection)
@@ -67,15 +171,61 @@ private:
     // Handle player reconnection (if the player with the same name is found)
     bool handle_player_reconnection(Player* new_player, Player* existing_player);
 
-     // Start thread that cleans up finished games
-    void start_game_cleaner();
-
-    // Thread for cleaning up finished games
-    void cleanup_finished_games();
+    // Recreate the games of the last snapshot, their players reconnect by name
+    void restore_games();
+    // Recreate one game, players without a transport have to reconnect by name (called with server_mutex held)
+    QuoridorGame* restore_game(const GameSnapshot& snapshot, const std::shared_ptr<Transport> transports[2]);
+    // Start thread that periodically writes the snapshot of all games in progress
+    void start_snapshot_writer();
+    // Write the snapshot of all games in progress
+    void write_snapshot();
+
+    // Take an ended game out of active_games (reclaimer thread), its slot is free for a new game right away
+    void remove_game(QuoridorGame* game);
+
+    // Create the admin socket for the given port and register its commands
+    void setup_admin_server(int port);
+    // Publish a copy of the current view with change applied
+    void update_view(const std::function<void(ServerView&)>& change);
+    // Rebuild games and waiting players of the view (called with server_mutex held)
+    void publish_lobby_view();
+    // Record the name (and spectator) of the client on transport in the view
+    void describe_connection(const Transport* transport, const std::string& name, std::shared_ptr<Spectator> spectator);
+    // Admin commands, they only read the published view (except end_game)
+    std::string list_games() const;
+    std::string list_waiting_players() const;
+    std::string list_connections() const;
+    std::string end_game(const std::string& args);
+
+    // Bind the listening socket to the address from the connection settings, returns the port
+    int open_listener();
+    // Accept new connections until the process exits
+    void accept_loop();
+    // Answer a connection that is not admitted with an error and close it (no player or thread is created)
+    void reject_connection(Transport& transport, const char* reason);
+    // Unix socket a new process connects to for a hot restart
+    static std::string handoff_socket_path(int port);
+    // Start thread that waits for a new process and hands the server over to it
+    void start_handoff_listener(int port);
+    // Drain client threads, send listening socket, connections and games over channel and exit the process
+    void hand_off(int channel);
+    // Recreate games, waiting players and client threads from the state sent by the previous process
+    bool resume_handoff(const std::string& state, const std::vector<int>& fds);
 public:
     // Constructor and destructor
     QuoridorServer();
     ~QuoridorServer();
     // Start the server on the given port 
     void start(int port);
+    // Take the listening socket, connections and games over from the server running on port and continue serving
+    // them (hot restart), starts normally if there is no running server
+    void takeover(int port);
+    // Do handshakes and matchmaking on port and run the games in that many worker processes
+    void start_front_end(int port, size_t workers);
+    // Run the games the front-end passes over channel (worker process started by the front-end with --worker)
+    void run_worker(size_t index, int channel);
+    // Start background tasks without listening, clients are then added with accept_transport (simulation)
+    void start_in_process();
+    // Serve a new client connection on its own thread
+    void accept_transport(std::shared_ptr<Transport> transport);
 }; 
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include "clock.h"
+
+/**
+ * @brief Token bucket: tokens refill at rate per second up to burst, every admitted event takes one.
+ * Not synchronized, each bucket belongs to one thread (or is guarded by its owner).
+ */
+class TokenBucket {
+public:
+    TokenBucket(double rate, double burst, Clock::time_point now = Clock::now());
+
+    // Take count tokens if available
+    bool try_take(Clock::time_point now, double count = 1);
+    // Time until count tokens are available (zero if they are)
+    Clock::duration time_until_available(Clock::time_point now, double count = 1);
+    // True if the bucket refilled completely (nothing was taken for burst / rate seconds)
+    bool is_full(Clock::time_point now);
+
+private:
+    double rate; // tokens per second
+    double burst; // bucket capacity
+    double tokens; // tokens available at last_refill
+    Clock::time_point last_refill;
+
+    void refill(Clock::time_point now);
+};
+
+/**
+ * @brief One token bucket per source address (IPv4 in network byte order), shared by all accepting threads.
+ * Buckets of addresses that stopped connecting are full again and are pruned once max_addresses is reached,
+ * if none can be pruned new addresses are rejected until buckets refill.
+ */
+class AddressRateLimiter {
+public:
+    AddressRateLimiter(double rate, double burst, size_t max_addresses);
+
+    // Admit one event from address
+    bool try_acquire(uint32_t address, Clock::time_point now);
+
+private:
+    double rate; // events per second per address
+    double burst; // events an address may use at once
+    size_t max_addresses; // bound for the bucket map
+    std::mutex limiter_mutex; // protects buckets
+    std::unordered_map<uint32_t, TokenBucket> buckets; // bucket per address
+};
@@ -0,0 +1,267 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "bitboard.h"
+
+/**
+ * @brief Rules engine for an N x N board with P players (2 or 4), one instantiation per variant.
+ * Walls are two bitboards of blocked steps and path checks flood fill whole rows of cells per step, board size and
+ * word count are compile time constants so each instantiation gets its own fully unrolled kernels.
+ * Cells are (row, col), player 0 starts at the bottom and walks up, player 1 walks down, players 2 and 3 (four
+ * player games) start on the left and right edge. A wall move covers two cells: a horizontal wall blocks the
+ * steps from both cells to the row below, a vertical wall the steps from both cells to the column on the right.
+ * A pawn may step onto another pawn, which is sent back to its start cell.
+ */
+template <int N, int P>
+class Rules {
+    static_assert(N >= 3 && N % 2 == 1, "the board needs a middle row and column");
+    static_assert(P == 2 || P == 4, "Quoridor is played by two or four players");
+
+public:
+    static constexpr int SIZE = N;
+    static constexpr int PLAYERS = P;
+    static constexpr int CELLS = N * N;
+    // 10 walls each on the standard board, four players share the same total
+    static constexpr int WALLS_PER_PLAYER = (P == 2) ? N + 1 : (N + 1) / 2;
+
+    using Bits = Bitboard<CELLS>;
+
+    struct Position {
+        using Engine = Rules;
+
+        Bits wall_down; // cells whose step to the row below is blocked (horizontal walls)
+        Bits wall_right; // cells whose step to the column on the right is blocked (vertical walls)
+        uint8_t pawns[P]; // cell index of each pawn
+        uint8_t walls_left[P]; // walls each player can still place
+
+        bool operator==(const Position& other) const {
+            for (int player = 0; player < P; ++player) {
+                if (pawns[player] != other.pawns[player] || walls_left[player] != other.walls_left[player]) return false;
+            }
+            return wall_down == other.wall_down && wall_right == other.wall_right;
+        }
+        bool operator!=(const Position& other) const { return !(*this == other); }
+    };
+
+    static constexpr int index(int row, int col) { return row * N + col; }
+    static constexpr bool on_board(int row, int col) { return row >= 0 && row < N && col >= 0 && col < N; }
+
+    static constexpr std::pair<int, int> start(int player) {
+        switch (player) {
+            case 0: return {N - 1, N / 2};
+            case 1: return {0, N / 2};
+            case 2: return {N / 2, 0};
+            default: return {N / 2, N - 1};
+        }
+    }
+
+    // Cells that win the game for player
+    static constexpr Bits goal(int player) {
+        switch (player) {
+            case 0: return row_mask(0);
+            case 1: return row_mask(N - 1);
+            case 2: return col_mask(N - 1);
+            default: return col_mask(0);
+        }
+    }
+
+    static constexpr Position initial() {
+        Position position{};
+        for (int player = 0; player < P; ++player) {
+            position.pawns[player] = static_cast<uint8_t>(index(start(player).first, start(player).second));
+            position.walls_left[player] = static_cast<uint8_t>(WALLS_PER_PLAYER);
+        }
+        return position;
+    }
+
+    static bool has_won(const Position& position, int player) {
+        return goal(player).test(position.pawns[player]);
+    }
+
+    // One orthogonal step of player to (row, col) that no wall blocks
+    static bool is_valid_step(const Position& position, int player, int row, int col) {
+        if (!on_board(row, col)) return false;
+        int from = position.pawns[player];
+        int to = index(row, col);
+        switch (to - from) {
+            case N: return !position.wall_down.test(from);
+            case -N: return !position.wall_down.test(to);
+            case 1: return from % N != N - 1 && !position.wall_right.test(from);
+            case -1: return from % N != 0 && !position.wall_right.test(to);
+            default: return false;
+        }
+    }
+
+    // Move the pawn of player (the step is validated, player is in [0, P)), returns the player that was sent back to
+    // its start or -1
+    static int move_pawn(Position& position, int player, int row, int col) {
+        if (player < 0 || player >= P) return -1;
+        int to = index(row, col);
+        int bumped = -1;
+        for (int other = 0; other < P; ++other) {
+            if (other == player || position.pawns[other] != to) continue;
+            auto home = start(other);
+            if (index(home.first, home.second) == to) {
+                // the start cell is taken by the pawn that bumped it, it waits next to it
+                if (other < 2) home.second++; else home.first++;
+            }
+            position.pawns[other] = static_cast<uint8_t>(index(home.first, home.second));
+            bumped = other;
+        }
+        position.pawns[player] = static_cast<uint8_t>(to);
+        return bumped;
+    }
+
+    // Wall of player on two adjacent cells that is on the board, overlaps no wall and leaves every pawn a path
+    static bool is_valid_wall(const Position& position, int player, bool horizontal, std::pair<int, int> first,
+                              std::pair<int, int> second) {
+        if (position.walls_left[player] == 0) return false;
+        if (!wall_fits(horizontal, first, second)) return false;
+        const Bits& walls = horizontal ? position.wall_down : position.wall_right;
+        if (walls.test(index(first.first, first.second)) || walls.test(index(second.first, second.second))) return false;
+        Position next = position;
+        place_wall(next, player, horizontal, first, second);
+        for (int other = 0; other < P; ++other) {
+            if (!has_path(next, other)) return false;
+        }
+        return true;
+    }
+
+    // Place a wall of player (the wall is validated)
+    static void place_wall(Position& position, int player, bool horizontal, std::pair<int, int> first,
+                           std::pair<int, int> second) {
+        Bits& walls = horizontal ? position.wall_down : position.wall_right;
+        walls.set(index(first.first, first.second));
+        walls.set(index(second.first, second.second));
+        if (position.walls_left[player] > 0) position.walls_left[player]--;
+    }
+
+    // True if the pawn of player can still reach its goal
+    static bool has_path(const Position& position, int player) {
+        const Bits target = goal(player);
+        Bits reached = Bits::cell(position.pawns[player]);
+        while (!(reached & target).any()) {
+            Bits next = reached | spread(position, reached);
+            if (next == reached) return false;
+            reached = next;
+        }
+        return true;
+    }
+
+    // Steps the pawn of player needs to reach its goal (walls only, pawns never block), -1 if it cannot
+    static int distance(const Position& position, int player) {
+        const Bits target = goal(player);
+        Bits reached = Bits::cell(position.pawns[player]);
+        for (int steps = 0; steps < CELLS; ++steps) {
+            if ((reached & target).any()) return steps;
+            Bits next = reached | spread(position, reached);
+            if (next == reached) return -1;
+            reached = next;
+        }
+        return -1;
+    }
+
+    // Cells of a shortest route of player to its goal (pawn cell excluded, one cell per step), empty if it cannot
+    static std::vector<int> route(const Position& position, int player) {
+        // within[k] holds the cells at most k steps from the goal, flooded from the goal towards the pawn
+        std::vector<Bits> within{goal(player)};
+        while (!within.back().test(position.pawns[player])) {
+            Bits next = within.back() | spread(position, within.back());
+            if (next == within.back()) return {};
+            within.push_back(next);
+        }
+        std::vector<int> cells;
+        int cell = position.pawns[player];
+        for (int steps = static_cast<int>(within.size()) - 2; steps >= 0; --steps) {
+            cell = (spread(position, Bits::cell(cell)) & within[steps]).lowest();
+            cells.push_back(cell);
+        }
+        return cells;
+    }
+
+    // Hash of the position (walls, pawns and walls left), equal positions have equal hashes
+    static uint64_t hash(const Position& position) {
+        uint64_t value = 0;
+        auto mix = [&value](uint64_t word) {
+            // splitmix64 finalizer over the running value
+            value += word + 0x9e3779b97f4a7c15ull;
+            value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+            value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+            value ^= value >> 31;
+        };
+        for (int i = 0; i < Bits::WORDS; ++i) mix(position.wall_down.words[i]);
+        for (int i = 0; i < Bits::WORDS; ++i) mix(position.wall_right.words[i]);
+        for (int player = 0; player < P; ++player) {
+            mix(static_cast<uint64_t>(position.pawns[player]) << 8 | position.walls_left[player]);
+        }
+        return value;
+    }
+
+private:
+    static constexpr Bits row_mask(int row) {
+        Bits mask;
+        for (int col = 0; col < N; ++col) mask.set(index(row, col));
+        return mask;
+    }
+
+    static constexpr Bits col_mask(int col) {
+        Bits mask;
+        for (int row = 0; row < N; ++row) mask.set(index(row, col));
+        return mask;
+    }
+
+    static bool wall_fits(bool horizontal, std::pair<int, int> first, std::pair<int, int> second) {
+        if (horizontal) {
+            // both cells need a row below them
+            return first.first == second.first && std::abs(first.second - second.second) == 1 &&
+                   first.first >= 0 && first.first < N - 1 && on_board(first.first, first.second) &&
+                   on_board(second.first, second.second);
+        }
+        // both cells need a column on their right
+        return first.second == second.second && std::abs(first.first - second.first) == 1 &&
+               first.second >= 0 && first.second < N - 1 && on_board(first.first, first.second) &&
+               on_board(second.first, second.second);
+    }
+
+    // Cells one unblocked step away from cells (cells of the last row shift past the board and are dropped)
+    static constexpr Bits spread(const Position& position, const Bits& cells) {
+        constexpr Bits FIRST_COL = col_mask(0);
+        constexpr Bits LAST_COL = col_mask(N - 1);
+        Bits down = cells.without(position.wall_down).shifted_up(N);
+        Bits up = cells.shifted_down(N).without(position.wall_down);
+        Bits right = cells.without(position.wall_right | LAST_COL).shifted_up(1);
+        Bits left = cells.without(FIRST_COL).shifted_down(1).without(position.wall_right);
+        return down | up | right | left;
+    }
+};
+
+// Variants hosted by the server, a client picks one with the name response (two player games)
+enum class Variant : uint8_t {
+    STANDARD = 0, // 9x9, 10 walls, 5+5 minutes
+    BLITZ = 1, // 5x5, 6 walls, 1+2 minutes
+    LARGE = 2, // 11x11, 12 walls, 10+5 minutes
+};
+
+/**
+ * @brief Board and time control of a variant.
+ */
+struct VariantInfo {
+    const char* name; // name in the name response and in game messages
+    int board_size;
+    int walls_per_player;
+    int64_t initial_clock_ms;
+    int64_t clock_increment_ms;
+};
+
+// Engine state of a game in any hosted variant, the alternative index is the Variant
+using VariantPosition = std::variant<Rules<9, 2>::Position, Rules<5, 2>::Position, Rules<11, 2>::Position>;
+
+const VariantInfo& variant_info(Variant variant);
+// Variant by name, false if there is no such variant
+bool parse_variant(const std::string& name, Variant& variant);
+// Start position of a variant
+VariantPosition initial_position(Variant variant);
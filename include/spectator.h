@@ -0,0 +1,53 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "message.h"
+#include "transport.h"
+
+/**
+ * @brief Read-only watcher of one game. The game thread only queues shared, already serialized updates
+ * (no syscalls, no serialization per spectator), a sender thread per spectator writes them to the connection.
+ * A spectator that cannot keep up gets conflated updates: a pending NEXT_TURN carries the whole board, so a newer
+ * one simply replaces it (the same holds for ANALYSIS answers). If the queue still grows beyond MAX_PENDING_UPDATES the spectator is dropped.
+ */
+class Spectator {
+public:
+    static constexpr size_t MAX_PENDING_UPDATES = 8;
+
+    explicit Spectator(std::shared_ptr<Transport> transport);
+    ~Spectator();
+
+    // Queue an update, never blocks (called by the game and the connection thread)
+    void publish(const WireBuffer& update, MessageType type);
+    // Close the spectator once the queued updates are sent (game ended)
+    void finish();
+    // Close the spectator immediately, queued updates are discarded
+    void close();
+    bool is_open() const;
+    // Number of queued updates
+    size_t queue_depth() const;
+
+    // Send queued updates until the spectator is closed (body of the sender thread)
+    void run_sender();
+
+    std::shared_ptr<Transport> get_transport() const;
+
+private:
+    struct Update {
+        WireBuffer wire; // serialized message
+        MessageType type; // updates of conflatable types replace each other
+    };
+
+    std::shared_ptr<Transport> transport; // connection to the spectator
+    mutable std::mutex queue_mutex; // protects everything below
+    std::condition_variable queue_condition; // signalled when an update is queued or the spectator closes
+    std::deque<Update> pending; // updates not yet sent
+    bool finishing = false; // close after the pending updates
+    bool closed = false; // nothing is sent anymore
+
+    // Only the latest update of these types matters
+    static bool is_conflatable(MessageType type);
+};
@@ -0,0 +1,62 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "rules.h"
+
+/**
+ * @brief Exact results of pawn races. Once neither player has a wall left the walls never change again, so all
+ * placements of the two pawns under one wall layout can be solved by retrograde analysis. Pawns do not block each
+ * other, but a pawn that steps onto the other sends it back to its start, so path lengths alone do not decide a race.
+ * A table holds one value per (player to move, pawn of player 1, pawn of player 2) of one layout.
+ *
+ * File: [magic][version][table count][index: (layout key, offset) sorted by key][tables], a table is
+ * [variant][wall_down][wall_right][values]. Tables only exist for layouts that were generated (quoridor_tablebase
+ * takes them from the journal), a probe is a binary search in the mapped index and one read of the value.
+ */
+class Tablebase {
+public:
+    static constexpr char MAGIC[8] = {'Q', 'T', 'B', 'A', 'S', 'E', '0', '1'};
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    // Result of a race for the player to move, DRAW if neither player can force it (or the placement cannot occur)
+    enum class Result : uint8_t { DRAW = 0, WIN = 1, LOSS = 2 };
+    struct Value {
+        Result result = Result::DRAW;
+        int plies = 0; // moves until the game ends with best play (the winner hurries, the loser delays)
+    };
+
+    /**
+     * @brief Solved layout: walls of the position and the value of every pawn placement.
+     */
+    struct Table {
+        VariantPosition layout; // pawns and walls left are not used
+        std::vector<uint16_t> values;
+    };
+
+    // Solve every pawn placement under the walls of layout
+    static Table solve(const VariantPosition& layout);
+    // Write tables to path (atomically, temporary file, fsync and rename), tables with the same layout are written once
+    static bool write(const std::string& path, std::vector<Table>& tables);
+    // Key of the variant and walls of a position, the index of the file is sorted by it
+    static uint64_t layout_key(const VariantPosition& position);
+
+    // Map a tablebase file, false if it is missing or malformed
+    bool open(const std::string& path);
+    size_t table_count() const { return count; }
+    // Value of a position for to_move, false if the walls of the position are not in the file or a player still
+    // has walls to place
+    bool probe(const VariantPosition& position, int to_move, Value& value) const;
+
+private:
+    struct IndexEntry {
+        uint64_t key;
+        uint64_t offset; // of the table from the start of the file
+    };
+
+    MappedFile file;
+    const IndexEntry* index = nullptr; // count entries sorted by key, inside the mapping
+    size_t count = 0;
+};
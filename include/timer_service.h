@@ -0,0 +1,59 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "clock.h"
+#include "pool_allocator.h"
+
+/**
+ * @brief One thread and one min-heap of deadlines for the whole process. Games schedule their deadlines here
+ * instead of running a thread each, so thousands of running clocks cost one sleeping thread.
+ * Callbacks run on the timer thread and must not block for long. Cancellation is lazy (the entry stays in the
+ * heap and is skipped, the heap is compacted when cancelled entries make up most of it). A timer belongs to an owner: cancel_all waits for a running callback of the owner,
+ * so the owner may be freed afterwards, a single cancel never waits (safe while holding locks the callback takes).
+ */
+class TimerService {
+public:
+    using TimerId = uint64_t;
+
+    static TimerService& instance();
+
+    // Run callback at deadline (Clock time, so virtual time applies), returns an id for cancel
+    TimerId schedule(Clock::time_point deadline, const void* owner, std::function<void()> callback);
+    // Cancel a timer without waiting, returns false if it already ran, is running or is unknown
+    bool cancel(TimerId id);
+    // Cancel every timer of owner and wait until none of its callbacks runs (not from inside such a callback)
+    void cancel_all(const void* owner);
+    // Timers waiting in the heap (including cancelled ones not yet skipped)
+    size_t pending() const;
+
+private:
+    struct Entry {
+        Clock::time_point deadline;
+        TimerId id;
+        const void* owner;
+        std::function<void()> callback;
+        bool operator>(const Entry& other) const { return deadline > other.deadline; }
+    };
+
+    TimerService();
+    void run();
+    // remove the earliest entry from the heap
+    Entry pop_earliest();
+    // drop cancelled entries once they outnumber the live ones, so the heap stops growing (timer_mutex held)
+    void compact();
+
+    mutable std::mutex timer_mutex; // protects everything below
+    std::condition_variable timer_condition; // signalled when an earlier deadline is scheduled or a callback ends
+    std::vector<Entry> heap; // min-heap (std::greater), earliest deadline at the front
+    // owners of timers that are scheduled and neither run nor cancelled (nodes pooled, a move reschedules the clock)
+    std::unordered_map<TimerId, const void*, std::hash<TimerId>, std::equal_to<TimerId>,
+                       PoolAllocator<std::pair<const TimerId, const void*>>> active;
+    TimerId next_id = 1;
+    const void* running_owner = nullptr; // owner of the callback running now
+    std::thread::id timer_thread; // thread that runs the callbacks
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <sys/types.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <utility>
+#include "clock.h"
+
+/**
+ * @brief Transport is the byte stream a Player talks through.
+ * SocketTransport wraps a TCP socket, InMemoryTransport connects two endpoints inside one process
+ * (used by the simulation harness to run the server without a network).
+ * receive follows recv() conventions: >0 bytes read, 0 when the peer closed, -1 with errno set (EAGAIN on timeout).
+ */
+class Transport {
+public:
+    Transport();
+    virtual ~Transport() = default;
+
+    // Send the whole buffer, returns number of bytes sent or -1 on error
+    virtual ssize_t send_bytes(const char* data, size_t length) = 0;
+    // Receive up to length bytes, waits at most the receive timeout
+    virtual ssize_t receive(char* buffer, size_t length) = 0;
+    // Set receive timeout in seconds
+    virtual void set_receive_timeout(int seconds) = 0;
+    // Close the connection (receive on the other side returns 0)
+    virtual void close_transport() = 0;
+    // End the connection but keep the descriptor, wakes other threads blocked in send or receive on it
+    virtual void shutdown_transport() { close_transport(); }
+    // Underlying file descriptor (-1 if there is none)
+    virtual int get_fd() const { return -1; }
+    // Bytes sent but not yet taken by the peer (kernel send queue for sockets)
+    virtual size_t outbound_queue() const { return 0; }
+
+    // Time of the last receive that returned data (creation time before the first one), safe from any thread
+    Clock::time_point last_receive_time() const;
+    // Time of the last successful send (creation time before the first one), safe from any thread
+    Clock::time_point last_send_time() const;
+
+protected:
+    // Remember that data arrived (called by receive implementations)
+    void mark_received();
+    // Remember that data was sent (called by send implementations)
+    void mark_sent();
+
+private:
+    std::atomic<Clock::duration::rep> last_receive; // Clock time of the last received data
+    std::atomic<Clock::duration::rep> last_send; // Clock time of the last sent data
+};
+
+/**
+ * @brief Transport over a connected socket. The socket is closed by close_transport or the destructor.
+ * Other threads may send on it at the same time (analysis replies), so the descriptor is only used under fd_mutex:
+ * send and receive hold it shared, close takes it exclusively, so a closed descriptor number that accept hands out
+ * again is never written to. A call still blocked after CLOSE_WAIT is woken by shutting the socket down (shutdown
+ * ends the connection for every descriptor of it, so it is not done when close does not have to wait).
+ */
+class SocketTransport : public Transport {
+public:
+    explicit SocketTransport(int fd);
+    ~SocketTransport() override;
+
+    ssize_t send_bytes(const char* data, size_t length) override;
+    ssize_t receive(char* buffer, size_t length) override;
+    void set_receive_timeout(int seconds) override;
+    void close_transport() override;
+    void shutdown_transport() override;
+    int get_fd() const override;
+    size_t outbound_queue() const override;
+
+    static constexpr std::chrono::milliseconds CLOSE_WAIT{100}; // time a running send or receive gets to finish
+
+private:
+    mutable std::shared_timed_mutex fd_mutex; // shared while fd is used, exclusive to close it
+    int fd; // socket (-1 once closed)
+};
+
+/**
+ * @brief One endpoint of an in-process connection. Bytes sent on one endpoint are received by its peer.
+ * Receive timeouts use Clock, so they follow virtual time in the simulation.
+ */
+class InMemoryTransport : public Transport {
+public:
+    // Create two connected endpoints
+    static std::pair<std::shared_ptr<InMemoryTransport>, std::shared_ptr<InMemoryTransport>> create_pair();
+
+    ~InMemoryTransport() override;
+
+    ssize_t send_bytes(const char* data, size_t length) override;
+    ssize_t receive(char* buffer, size_t length) override;
+    void set_receive_timeout(int seconds) override;
+    void close_transport() override;
+    size_t outbound_queue() const override;
+
+    // Receive without waiting (returns -1 with EAGAIN when nothing is buffered)
+    ssize_t try_receive(char* buffer, size_t length);
+    // Bytes waiting to be received on this endpoint
+    size_t pending() const;
+
+private:
+    InMemoryTransport();
+
+    mutable std::mutex inbox_mutex; // protects inbox and closed
+    std::condition_variable inbox_condition; // signalled when data arrives or the connection closes
+    std::string inbox; // bytes sent by the peer and not yet received
+    bool closed = false; // connection closed by either side
+    int receive_timeout = 0; // seconds (0 = wait forever)
+    std::weak_ptr<InMemoryTransport> peer; // other endpoint
+
+    // Append bytes to the inbox (called by the peer)
+    bool deliver(const char* data, size_t length);
+    // Mark the endpoint as closed and wake a waiting receive
+    void mark_closed();
+    ssize_t read_inbox(char* buffer, size_t length);
+};
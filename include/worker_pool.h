@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <sys/types.h>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Game worker processes of a front-end server. The front-end does the handshake and matchmaking, then passes
+ * both client sockets of a match to a worker (SCM_RIGHTS over a Unix socket pair), the worker runs the game.
+ * A crashed worker only takes its own games down, it is started again and restores them from its snapshot,
+ * their players reconnect through the front-end, which routes them to the worker by name.
+ *
+ * Channel records are newline separated fields, front-end to worker: "match" lobby name1 name2 variant (two fds),
+ * "reconnect" name (one fd). Worker to front-end: "ended" lobby, "forget" name (reconnection failed),
+ * "status" games metrics and "players" (lobby name)* of the running games, which rebuild the routes after a restart.
+ */
+class WorkerPool {
+public:
+    static constexpr int RESTART_DELAY_SECONDS = 1; // a worker that keeps crashing is not restarted in a tight loop
+    static constexpr int SEND_TIMEOUT_SECONDS = 1; // a worker that does not read its channel is killed and restarted
+    static constexpr int STATUS_INTERVAL_SECONDS = 2; // how often workers report their games and metrics
+
+    // count workers running this executable with --worker, each runs at most max_games games
+    WorkerPool(size_t count, size_t max_games);
+
+    // Start all workers
+    void start();
+    // Pass a matched pair to the least loaded worker, false if every worker is full or down
+    bool dispatch_match(size_t lobby_id, const std::string& variant, const std::string names[2], const int fds[2]);
+    // Pass the connection of a reconnecting player to the worker running its game, false if no game has the name
+    bool route_reconnection(const std::string& name, int fd);
+    // One line per worker (admin 'workers')
+    std::string describe() const;
+    // Last metrics reported by a worker (admin 'worker_stats')
+    std::string worker_stats(size_t index) const;
+
+    // Channel record helpers, used by the worker side as well
+    static std::string encode(const std::vector<std::string>& fields);
+    // Split a record, the last of max_fields keeps the rest (metrics text contains newlines)
+    static std::vector<std::string> decode(const std::string& record, size_t max_fields = SIZE_MAX);
+
+private:
+    struct Worker {
+        pid_t pid = -1;
+        int channel = -1; // front-end end of the socket pair, -1 while the worker is down
+        size_t games = 0; // last reported games plus games dispatched since
+        unsigned restarts = 0;
+        std::string stats; // last reported metrics
+    };
+    struct Route {
+        size_t worker;
+        size_t lobby_id;
+    };
+
+    std::string executable; // this binary, workers are started from it with --worker
+    size_t max_games;
+    mutable std::mutex pool_mutex; // protects workers and routes, taken after server_mutex
+    std::vector<Worker> workers;
+    std::unordered_map<std::string, Route> routes; // players of running games by name
+
+    // Fork and exec worker index and start its reader thread (called with pool_mutex held)
+    bool spawn(size_t index);
+    // Send a record to a worker, a worker that cannot take it is killed (called with pool_mutex held)
+    bool send_record(size_t index, const std::vector<std::string>& fields, const std::vector<int>& fds);
+    // Read the reports of a worker until its channel closes, then restart it
+    void read_reports(size_t index, int channel);
+};
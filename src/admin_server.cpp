@@ -0,0 +1,105 @@
+#include "admin_server.h"
+#include "logger.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cstring>
+#include <thread>
+
+AdminServer::AdminServer(std::string socket_path) : socket_path(std::move(socket_path)) {}
+
+AdminServer::~AdminServer() {
+    running = false;
+    if (admin_socket >= 0) {
+        close(admin_socket);
+        unlink(socket_path.c_str());
+    }
+}
+
+void AdminServer::add_command(const std::string& name, CommandHandler handler) {
+    commands[name] = std::move(handler);
+}
+
+const std::string& AdminServer::get_socket_path() const {
+    return socket_path;
+}
+
+bool AdminServer::start() {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path)) {
+        LOG_ERROR(LogFields(), "Admin socket path too long: %s", socket_path.c_str());
+        return false;
+    }
+    strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+    admin_socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (admin_socket < 0) {
+        LOG_ERROR(LogFields(), "Failed to create admin socket");
+        return false;
+    }
+    unlink(socket_path.c_str()); // stale socket from a previous run
+    if (bind(admin_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(admin_socket, 4) < 0) {
+        LOG_ERROR(LogFields(), "Failed to bind admin socket %s: %s", socket_path.c_str(), strerror(errno));
+        close(admin_socket);
+        admin_socket = -1;
+        return false;
+    }
+
+    running = true;
+    std::thread(&AdminServer::serve, this).detach();
+    LOG_INFO(LogFields(), "Admin socket listening on %s", socket_path.c_str());
+    return true;
+}
+
+void AdminServer::serve() {
+    while (running) {
+        int client_socket = accept4(admin_socket, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client_socket < 0) {
+            if (!running) break;
+            continue;
+        }
+        // commands are cheap and rare, they are served one at a time on this thread
+        handle_connection(client_socket);
+        close(client_socket);
+    }
+}
+
+void AdminServer::handle_connection(int client_socket) {
+    struct timeval tv{1, 0};  // do not let a silent client block the admin thread
+    setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::string line;
+    char buffer[256];
+    while (line.find('\n') == std::string::npos && line.size() < 4096) {
+        int bytes_read = recv(client_socket, buffer, sizeof(buffer), 0);
+        if (bytes_read <= 0) break;
+        line.append(buffer, bytes_read);
+    }
+    line = line.substr(0, line.find('\n'));
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+
+    std::string response = execute(line);
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t result = send(client_socket, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (result <= 0) break;
+        sent += result;
+    }
+}
+
+std::string AdminServer::execute(const std::string& line) {
+    size_t space = line.find(' ');
+    std::string name = line.substr(0, space);
+    std::string args = (space == std::string::npos) ? "" : line.substr(space + 1);
+
+    auto it = commands.find(name);
+    if (it == commands.end()) {
+        std::string response = "unknown command '" + name + "', available:";
+        for (const auto& command : commands) {
+            response += " " + command.first;
+        }
+        return response + "\n";
+    }
+    return it->second(args);
+}
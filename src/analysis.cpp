@@ -0,0 +1,275 @@
+#include "analysis.h"
+#include <algorithm>
+#include <thread>
+#include "game_snapshot.h"
+#include "journal.h"
+#include "memory_accounting.h"
+#include "metrics.h"
+#include "profiler.h"
+
+namespace {
+// Path lead of player after a move, a move that reaches the goal beats everything
+constexpr int WINNING_SCORE = 1 << 16;
+
+template <typename Position>
+int score_for(const Position& position, int player) {
+    using Engine = typename Position::Engine;
+    if (Engine::has_won(position, player)) return WINNING_SCORE;
+    return Engine::distance(position, 1 - player) - Engine::distance(position, player);
+}
+
+template <typename Position>
+std::pair<int, int> cell_of(int index) {
+    return {index / Position::Engine::SIZE, index % Position::Engine::SIZE};
+}
+
+template <typename Position>
+void suggest_move(const Position& position, int player, Analysis& analysis) {
+    using Engine = typename Position::Engine;
+    constexpr int N = Engine::SIZE;
+    int best = 0;
+    bool found = false;
+    // second is only used for walls
+    auto consider = [&](int score, bool is_wall, bool horizontal, std::pair<int, int> first, std::pair<int, int> second) {
+        // walls have to do strictly better than the best pawn step
+        if (found && (score < best || (score == best && is_wall))) return;
+        best = score;
+        found = true;
+        analysis.hint_is_horizontal = horizontal;
+        analysis.hint.assign({first});
+        if (is_wall) analysis.hint.push_back(second);
+    };
+
+    auto pawn = cell_of<Position>(position.pawns[player]);
+    const std::pair<int, int> steps[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (const auto& step : steps) {
+        int row = pawn.first + step.first;
+        int col = pawn.second + step.second;
+        if (!Engine::is_valid_step(position, player, row, col)) continue;
+        Position next = position;
+        Engine::move_pawn(next, player, row, col);
+        consider(score_for(next, player), false, false, {row, col}, {});
+    }
+    if (position.walls_left[player] == 0) return;
+    for (int horizontal = 1; horizontal >= 0; --horizontal) {
+        for (int row = 0; row < N - 1; ++row) {
+            for (int col = 0; col < N - 1; ++col) {
+                // a horizontal wall spans two columns, a vertical one two rows
+                std::pair<int, int> first{row, col};
+                std::pair<int, int> second = horizontal ? std::make_pair(row, col + 1) : std::make_pair(row + 1, col);
+                if (!Engine::is_valid_wall(position, player, horizontal, first, second)) continue;
+                Position next = position;
+                Engine::place_wall(next, player, horizontal, first, second);
+                consider(score_for(next, player), true, horizontal, first, second);
+            }
+        }
+    }
+}
+
+// Replace the hint by the best move of a solved race: the fastest win, else a draw, else the slowest loss
+template <typename Position>
+void suggest_race_move(const Position& position, int player, const Tablebase& tablebase, Analysis& analysis) {
+    using Engine = typename Position::Engine;
+    int best = 0;
+    bool found = false;
+    auto pawn = cell_of<Position>(position.pawns[player]);
+    const std::pair<int, int> steps[] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+    for (const auto& step : steps) {
+        int row = pawn.first + step.first;
+        int col = pawn.second + step.second;
+        if (!Engine::is_valid_step(position, player, row, col)) continue;
+        Position next = position;
+        Engine::move_pawn(next, player, row, col);
+        // the value after the move is the one of the opponent
+        Tablebase::Value reply;
+        int score;
+        if (Engine::has_won(next, player)) {
+            score = WINNING_SCORE;
+        } else if (!tablebase.probe(VariantPosition(next), 1 - player, reply)) {
+            continue;
+        } else if (reply.result == Tablebase::Result::LOSS) {
+            score = WINNING_SCORE - reply.plies;
+        } else if (reply.result == Tablebase::Result::WIN) {
+            score = -WINNING_SCORE + reply.plies;
+        } else {
+            score = 0;
+        }
+        if (found && score <= best) continue;
+        best = score;
+        found = true;
+        analysis.hint_is_horizontal = false;
+        analysis.hint.assign({{row, col}});
+    }
+}
+
+// Use the move of a book entry as hint, false if it is not legal here (another position with the same key)
+template <typename Position>
+bool use_book_move(const Position& position, int player, const OpeningBook::Entry& entry, Analysis& analysis) {
+    using Engine = typename Position::Engine;
+    std::pair<int, int> first{entry.cells[0], entry.cells[1]};
+    std::pair<int, int> second{entry.cells[2], entry.cells[3]};
+    bool horizontal = (entry.flags & JOURNAL_MOVE_HORIZONTAL) != 0;
+    if (entry.flags & JOURNAL_MOVE_WALL) {
+        if (!Engine::is_valid_wall(position, player, horizontal, first, second)) return false;
+        analysis.hint.assign({first, second});
+    } else {
+        if (!Engine::is_valid_step(position, player, first.first, first.second)) return false;
+        analysis.hint.assign({first});
+    }
+    analysis.hint_is_horizontal = horizontal;
+    analysis.from_book = true;
+    analysis.book_games = entry.games;
+    return true;
+}
+}
+
+Analysis analyze_position(const VariantPosition& variant_position, int to_move, const Tablebase* tablebase,
+                          const OpeningBook* book) {
+    PROFILE_ZONE("analyze_position");
+    Analysis analysis;
+    analysis.to_move = to_move;
+    analysis.solved = tablebase && tablebase->probe(variant_position, to_move, analysis.race);
+    OpeningBook::Entry entry;
+    bool in_book = !analysis.solved && book && book->probe(variant_position, to_move, entry);
+    std::visit([&analysis, to_move, tablebase, in_book, &entry](const auto& position) {
+        using Position = std::decay_t<decltype(position)>;
+        using Engine = typename Position::Engine;
+        for (int player = 0; player < 2; ++player) {
+            analysis.distances[player] = Engine::distance(position, player);
+            for (int cell : Engine::route(position, player)) {
+                analysis.routes[player].push_back(cell_of<Position>(cell));
+            }
+        }
+        if (analysis.solved) {
+            suggest_race_move(position, to_move, *tablebase, analysis);
+        } else if (!in_book || !use_book_move(position, to_move, entry, analysis)) {
+            suggest_move(position, to_move, analysis);
+        }
+    }, variant_position);
+    return analysis;
+}
+
+VariantPosition position_from_snapshot(const GameSnapshot& snapshot) {
+    VariantPosition variant_position = initial_position(static_cast<Variant>(snapshot.variant));
+    std::visit([&snapshot](auto& position) {
+        using Engine = typename std::decay_t<decltype(position)>::Engine;
+        for (size_t i = 0; i < snapshot.horizontal_count; ++i) {
+            const auto& cell = snapshot.horizontal_walls[i];
+            if (Engine::on_board(cell.first, cell.second)) position.wall_down.set(Engine::index(cell.first, cell.second));
+        }
+        for (size_t i = 0; i < snapshot.vertical_count; ++i) {
+            const auto& cell = snapshot.vertical_walls[i];
+            if (Engine::on_board(cell.first, cell.second)) position.wall_right.set(Engine::index(cell.first, cell.second));
+        }
+        for (int i = 0; i < 2; ++i) {
+            const PlayerSnapshot& player = snapshot.players[i];
+            if (Engine::on_board(player.row, player.col)) position.pawns[i] = Engine::index(player.row, player.col);
+            position.walls_left[i] = player.walls_left;
+        }
+    }, variant_position);
+    return variant_position;
+}
+
+AnalysisService& AnalysisService::instance() {
+    // never destroyed, analysis threads may still run while the process exits
+    static AnalysisService* service = new AnalysisService();
+    return *service;
+}
+
+AnalysisService::AnalysisService() {
+    {
+        MemoryScope memory(MemoryTag::ANALYSIS);
+        cache.resize(CACHE_SLOTS);
+    }
+    size_t threads = std::max<size_t>(1, std::min<size_t>(MAX_THREADS, std::thread::hardware_concurrency() / 2));
+    for (size_t i = 0; i < threads; ++i) {
+        std::thread(&AnalysisService::run, this).detach();
+    }
+}
+
+bool AnalysisService::submit(const VariantPosition& position, int to_move, Reply reply) {
+    MemoryScope memory(MemoryTag::ANALYSIS);
+    Metrics::instance().analysis_requests.add();
+    uint64_t key = hash(position, to_move);
+    if (auto cached = lookup(key, position, to_move)) {
+        Metrics::instance().analysis_cache_hits.add();
+        reply(*cached);
+        return true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (queue.size() >= MAX_PENDING) {
+            Metrics::instance().analysis_rejected.add();
+            return false;
+        }
+        queue.push_back({position, to_move, key, std::move(reply)});
+    }
+    queue_condition.notify_one();
+    return true;
+}
+
+size_t AnalysisService::pending() const {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return queue.size();
+}
+
+bool AnalysisService::load_tablebase(const std::string& path) {
+    auto loaded = std::make_shared<Tablebase>();
+    if (!loaded->open(path)) return false;
+    std::atomic_store(&tablebase, std::shared_ptr<const Tablebase>(std::move(loaded)));
+    return true;
+}
+
+bool AnalysisService::load_book(const std::string& path) {
+    auto loaded = std::make_shared<OpeningBook>();
+    if (!loaded->open(path)) return false;
+    std::atomic_store(&book, std::shared_ptr<const OpeningBook>(std::move(loaded)));
+    return true;
+}
+
+void AnalysisService::run() {
+    MemoryScope memory(MemoryTag::ANALYSIS);
+    while (true) {
+        Request request;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_condition.wait(lock, [this] { return !queue.empty(); });
+            request = std::move(queue.front());
+            queue.pop_front();
+        }
+        // the same position may have been queued twice, the second request finds the first result
+        auto result = lookup(request.hash, request.position, request.to_move);
+        if (!result) {
+            ScopedTimer timer(Metrics::instance().analysis_ns);
+            auto races = std::atomic_load(&tablebase);
+            auto openings = std::atomic_load(&book);
+            result = std::make_shared<const Analysis>(
+                analyze_position(request.position, request.to_move, races.get(), openings.get()));
+            store(request.hash, request.position, request.to_move, result);
+        }
+        request.reply(*result);
+    }
+}
+
+std::shared_ptr<const Analysis> AnalysisService::lookup(uint64_t key, const VariantPosition& position, int to_move) {
+    size_t index = key & (CACHE_SLOTS - 1);
+    std::lock_guard<std::mutex> lock(cache_locks[index % CACHE_LOCKS]);
+    const Slot& slot = cache[index];
+    if (slot.to_move != to_move || slot.hash != key || slot.position != position) return nullptr;
+    return slot.result;
+}
+
+void AnalysisService::store(uint64_t key, const VariantPosition& position, int to_move,
+                            std::shared_ptr<const Analysis> result) {
+    size_t index = key & (CACHE_SLOTS - 1);
+    std::lock_guard<std::mutex> lock(cache_locks[index % CACHE_LOCKS]);
+    Slot& slot = cache[index];
+    slot.hash = key;
+    slot.position = position;
+    slot.to_move = to_move;
+    slot.result = std::move(result);
+}
+
+uint64_t AnalysisService::hash(const VariantPosition& position, int to_move) {
+    return OpeningBook::position_key(position, to_move);
+}
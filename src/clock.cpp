@@ -0,0 +1,107 @@
+#include "clock.h"
+#include <algorithm>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace {
+std::atomic<bool> virtual_mode{false}; // virtual time enabled
+std::atomic<int64_t> virtual_now_ns{0}; // current virtual time (steady clock epoch based)
+std::mutex clock_mutex; // protects waiters and virtual sleeps
+std::condition_variable clock_condition; // virtual sleepers wait on it
+std::vector<std::pair<std::mutex*, std::condition_variable*>> waiters; // registered deadline waiters
+
+// idle tracking, deadlines_mutex is always taken last (waiters hold their own mutex when they take it)
+std::mutex deadlines_mutex; // protects deadlines and the counters below
+std::multiset<Clock::time_point> deadlines; // deadlines of all threads currently waiting
+int alive_threads = 0; // threads that waited through Clock at least once and did not exit
+int waiting_threads = 0; // threads currently inside a Clock wait
+
+// Counts the thread as alive from its first wait until it exits
+struct ThreadRegistration {
+    bool registered = false;
+    void ensure() {
+        if (registered) return;
+        registered = true;
+        std::lock_guard<std::mutex> lock(deadlines_mutex);
+        ++alive_threads;
+    }
+    ~ThreadRegistration() {
+        if (!registered) return;
+        std::lock_guard<std::mutex> lock(deadlines_mutex);
+        --alive_threads;
+    }
+};
+thread_local ThreadRegistration thread_registration;
+}
+
+Clock::time_point Clock::now() {
+    if (!virtual_mode.load(std::memory_order_acquire)) {
+        return std::chrono::steady_clock::now();
+    }
+    return time_point(std::chrono::nanoseconds(virtual_now_ns.load(std::memory_order_acquire)));
+}
+
+void Clock::sleep_for(duration time) {
+    if (!is_virtual()) {
+        std::this_thread::sleep_for(time);
+        return;
+    }
+    time_point deadline = now() + time;
+    std::unique_lock<std::mutex> lock(clock_mutex);
+    begin_wait(deadline);
+    clock_condition.wait(lock, [deadline]() { return now() >= deadline; });
+    end_wait(deadline);
+}
+
+void Clock::begin_wait(time_point deadline) {
+    thread_registration.ensure();
+    std::lock_guard<std::mutex> lock(deadlines_mutex);
+    deadlines.insert(deadline);
+    ++waiting_threads;
+}
+
+void Clock::end_wait(time_point deadline) {
+    std::lock_guard<std::mutex> lock(deadlines_mutex);
+    deadlines.erase(deadlines.find(deadline));
+    --waiting_threads;
+}
+
+bool Clock::is_idle() {
+    std::lock_guard<std::mutex> lock(deadlines_mutex);
+    if (waiting_threads != alive_threads) return false;
+    return deadlines.empty() || *deadlines.begin() > now();
+}
+
+void Clock::enable_virtual_time() {
+    virtual_now_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    virtual_mode.store(true, std::memory_order_release);
+}
+
+bool Clock::is_virtual() {
+    return virtual_mode.load(std::memory_order_acquire);
+}
+
+void Clock::advance(duration time) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    virtual_now_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count());
+    clock_condition.notify_all();
+    // taking each waiter's mutex guarantees it is either waiting already or will see the new time,
+    // clock_mutex stays locked so no waiter can unregister (and be destroyed) meanwhile
+    for (auto& waiter : waiters) {
+        std::lock_guard<std::mutex> waiter_lock(*waiter.first);
+        waiter.second->notify_all();
+    }
+}
+
+void Clock::add_waiter(std::mutex* mutex, std::condition_variable* condition) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    waiters.emplace_back(mutex, condition);
+}
+
+void Clock::remove_waiter(std::mutex* mutex, std::condition_variable* condition) {
+    std::lock_guard<std::mutex> lock(clock_mutex);
+    waiters.erase(std::remove(waiters.begin(), waiters.end(), std::make_pair(mutex, condition)), waiters.end());
+}
@@ -0,0 +1,115 @@
+#include "fd_channel.h"
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+bool send_all(int socket, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = ::send(socket, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool receive_all(int socket, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t received = recv(socket, data, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        data += received;
+        size -= received;
+    }
+    return true;
+}
+
+void close_all(std::vector<int>& fds) {
+    for (int fd : fds) close(fd);
+    fds.clear();
+}
+}
+
+bool FdChannel::send(int socket, const std::string& payload, const std::vector<int>& fds) {
+    uint32_t header[2] = {static_cast<uint32_t>(payload.size()), static_cast<uint32_t>(fds.size())};
+    if (!send_all(socket, reinterpret_cast<const char*>(header), sizeof(header)) ||
+        !send_all(socket, payload.data(), payload.size())) {
+        return false;
+    }
+
+    // descriptors travel as ancillary data, which needs at least one byte of regular data to ride on
+    for (size_t first = 0; first < fds.size(); first += MAX_FDS_PER_MESSAGE) {
+        size_t count = std::min(MAX_FDS_PER_MESSAGE, fds.size() - first);
+        char marker = 'F';
+        iovec io{&marker, 1};
+        char control[CMSG_SPACE(MAX_FDS_PER_MESSAGE * sizeof(int))] = {};
+        msghdr message{};
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = CMSG_SPACE(count * sizeof(int));
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(count * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds.data() + first, count * sizeof(int));
+
+        ssize_t sent;
+        do {
+            sent = sendmsg(socket, &message, MSG_NOSIGNAL);
+        } while (sent < 0 && errno == EINTR);
+        if (sent != 1) return false;
+    }
+    return true;
+}
+
+bool FdChannel::receive(int socket, std::string& payload, std::vector<int>& fds) {
+    fds.clear();
+    uint32_t header[2];
+    if (!receive_all(socket, reinterpret_cast<char*>(header), sizeof(header))) return false;
+    payload.resize(header[0]);
+    if (!receive_all(socket, &payload[0], payload.size())) return false;
+
+    while (fds.size() < header[1]) {
+        char marker;
+        iovec io{&marker, 1};
+        char control[CMSG_SPACE(MAX_FDS_PER_MESSAGE * sizeof(int))] = {};
+        msghdr message{};
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t received;
+        do {
+            received = recvmsg(socket, &message, MSG_CMSG_CLOEXEC);
+        } while (received < 0 && errno == EINTR);
+        if (received != 1) {
+            close_all(fds);
+            return false;
+        }
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+            size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            size_t offset = fds.size();
+            fds.resize(offset + count);
+            memcpy(fds.data() + offset, CMSG_DATA(cmsg), count * sizeof(int));
+        }
+        if (message.msg_flags & MSG_CTRUNC) {
+            close_all(fds);  // descriptors were lost, the state would not match the connections
+            return false;
+        }
+    }
+    if (fds.size() != header[1]) {
+        close_all(fds);
+        return false;
+    }
+    return true;
+}
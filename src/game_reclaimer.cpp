@@ -0,0 +1,65 @@
+#include "game_reclaimer.h"
+#include <algorithm>
+#include "memory_accounting.h"
+#include "metrics.h"
+#include "quoridor_game.h"
+
+GameReclaimer::GameReclaimer(std::function<void(QuoridorGame*)> remove) : remove(std::move(remove)) {
+}
+
+GameReclaimer::~GameReclaimer() {
+    {
+        std::lock_guard<std::mutex> lock(reclaim_mutex);
+        stopping = true;
+    }
+    reclaim_condition.notify_all();
+    if (reclaim_thread.joinable()) reclaim_thread.join();
+}
+
+void GameReclaimer::start() {
+    reclaim_thread = std::thread(&GameReclaimer::run, this);
+}
+
+void GameReclaimer::game_ended(QuoridorGame* game) {
+    {
+        MemoryScope memory(MemoryTag::GAME);
+        std::lock_guard<std::mutex> lock(reclaim_mutex);
+        ended.push_back(game);
+    }
+    reclaim_condition.notify_one();
+}
+
+void GameReclaimer::game_released() {
+    {
+        std::lock_guard<std::mutex> lock(reclaim_mutex);
+        released = true;
+    }
+    reclaim_condition.notify_one();
+}
+
+void GameReclaimer::run() {
+    MemoryScope memory(MemoryTag::GAME);
+    std::vector<QuoridorGame*> batch;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(reclaim_mutex);
+            reclaim_condition.wait(lock, [this]() { return stopping || released || !ended.empty(); });
+            if (stopping) return;
+            batch.swap(ended);
+            released = false;
+        }
+        for (QuoridorGame* game : batch) {
+            remove(game);
+            retired.push_back(game);
+        }
+        batch.clear();
+        // only this thread deletes, a game found unused here cannot be acquired again
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [](QuoridorGame* game) {
+            if (game->reference_count() > 0) return false;
+            game->delete_unconnected_players();
+            delete game;
+            return true;
+        }), retired.end());
+        Metrics::instance().retired_games.set(static_cast<int64_t>(retired.size()));
+    }
+}
@@ -0,0 +1,157 @@
+#include "game_snapshot.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include "journal.h"
+#include "rules.h"
+
+constexpr char SnapshotFile::MAGIC[8];
+
+namespace {
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool get(const char*& in, const char* end, T& value) {
+    if (static_cast<size_t>(end - in) < sizeof(T)) return false;
+    memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return true;
+}
+}
+
+void GameSnapshot::serialize(std::string& out) const {
+    put<uint32_t>(out, lobby_id);
+    put<uint32_t>(out, journal_sequence);
+    put<uint32_t>(out, turn);
+    put<uint8_t>(out, variant);
+    put<uint8_t>(out, current_player);
+    put<uint8_t>(out, horizontal_count);
+    put<uint8_t>(out, vertical_count);
+    for (size_t i = 0; i < horizontal_count; ++i) {
+        put<uint8_t>(out, horizontal_walls[i].first);
+        put<uint8_t>(out, horizontal_walls[i].second);
+    }
+    for (size_t i = 0; i < vertical_count; ++i) {
+        put<uint8_t>(out, vertical_walls[i].first);
+        put<uint8_t>(out, vertical_walls[i].second);
+    }
+    for (const PlayerSnapshot& player : players) {
+        put<uint8_t>(out, player.row);
+        put<uint8_t>(out, player.col);
+        put<uint8_t>(out, player.walls_left);
+        put<uint32_t>(out, player.clock_ms);
+        uint8_t length = static_cast<uint8_t>(std::min<size_t>(player.name.size(), 255));
+        put<uint8_t>(out, length);
+        out.append(player.name.data(), length);
+    }
+}
+
+size_t GameSnapshot::deserialize(const char* data, size_t size) {
+    const char* cursor = data;
+    const char* end = data + size;
+    if (!get(cursor, end, lobby_id) || !get(cursor, end, journal_sequence) || !get(cursor, end, turn) ||
+        !get(cursor, end, variant) || !get(cursor, end, current_player) ||
+        !get(cursor, end, horizontal_count) || !get(cursor, end, vertical_count)) {
+        return 0;
+    }
+    if (variant > static_cast<uint8_t>(Variant::LARGE) || current_player > 1 || horizontal_count > MAX_WALL_CELLS || vertical_count > MAX_WALL_CELLS) return 0;
+    for (size_t i = 0; i < horizontal_count; ++i) {
+        if (!get(cursor, end, horizontal_walls[i].first) || !get(cursor, end, horizontal_walls[i].second)) return 0;
+    }
+    for (size_t i = 0; i < vertical_count; ++i) {
+        if (!get(cursor, end, vertical_walls[i].first) || !get(cursor, end, vertical_walls[i].second)) return 0;
+    }
+    for (PlayerSnapshot& player : players) {
+        uint8_t length = 0;
+        if (!get(cursor, end, player.row) || !get(cursor, end, player.col) || !get(cursor, end, player.walls_left) ||
+            !get(cursor, end, player.clock_ms) || !get(cursor, end, length) || end - cursor < length) {
+            return 0;
+        }
+        player.name.assign(cursor, length);
+        cursor += length;
+    }
+    // the game writes the cells into its board array, a damaged snapshot must not reach outside of it
+    const VariantInfo& info = variant_info(static_cast<Variant>(variant));
+    auto on_board = [&info](uint8_t row, uint8_t col) { return row < info.board_size && col < info.board_size; };
+    for (size_t i = 0; i < horizontal_count; ++i) {
+        if (!on_board(horizontal_walls[i].first, horizontal_walls[i].second)) return 0;
+    }
+    for (size_t i = 0; i < vertical_count; ++i) {
+        if (!on_board(vertical_walls[i].first, vertical_walls[i].second)) return 0;
+    }
+    for (const PlayerSnapshot& player : players) {
+        if (!on_board(player.row, player.col) || player.walls_left > info.walls_per_player) return 0;
+    }
+    return cursor - data;
+}
+
+bool SnapshotFile::write(const std::string& path, const std::vector<std::shared_ptr<const GameSnapshot>>& games) {
+    std::string buffer(MAGIC, sizeof(MAGIC));
+    put<uint32_t>(buffer, FORMAT_VERSION);
+    put<uint32_t>(buffer, static_cast<uint32_t>(games.size()));
+    for (const auto& game : games) {
+        game->serialize(buffer);
+    }
+    put<uint32_t>(buffer, Journal::crc32(buffer.data(), buffer.size()));
+
+    std::string temporary = path + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const char* data = buffer.data();
+    size_t left = buffer.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        data += written;
+        left -= written;
+    }
+    // data has to be on disk before the rename makes it the current snapshot
+    bool ok = fdatasync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    return ok && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool SnapshotFile::read(const std::string& path, std::vector<GameSnapshot>& games) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return false;
+    std::string buffer;
+    char chunk[4096];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        buffer.append(chunk, length);
+    }
+    fclose(file);
+
+    constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 2 * sizeof(uint32_t);
+    if (buffer.size() < HEADER_SIZE + sizeof(uint32_t) || memcmp(buffer.data(), MAGIC, sizeof(MAGIC)) != 0) return false;
+    size_t body_size = buffer.size() - sizeof(uint32_t);
+    uint32_t checksum;
+    memcpy(&checksum, buffer.data() + body_size, sizeof(checksum));
+    if (Journal::crc32(buffer.data(), body_size) != checksum) return false;
+
+    const char* cursor = buffer.data() + sizeof(MAGIC);
+    const char* end = buffer.data() + body_size;
+    uint32_t version = 0, count = 0;
+    get(cursor, end, version);
+    get(cursor, end, count);
+    if (version != FORMAT_VERSION || count > body_size) return false;
+
+    games.clear();
+    games.resize(count);
+    for (GameSnapshot& game : games) {
+        size_t used = game.deserialize(cursor, end - cursor);
+        if (used == 0) return false;
+        cursor += used;
+    }
+    return true;
+}
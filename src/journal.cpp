@@ -0,0 +1,306 @@
+#include "journal.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include "logger.h"
+#include "memory_accounting.h"
+#include "metrics.h"
+
+constexpr char Journal::SEGMENT_MAGIC[8];
+
+namespace {
+// Fixed part of every payload: type, game id, sequence, timestamp, player, flags
+constexpr size_t FIXED_PAYLOAD_SIZE = 1 + 4 + 4 + 8 + 1 + 1;
+
+template <typename T>
+void put(char*& out, T value) {
+    memcpy(out, &value, sizeof(T));
+    out += sizeof(T);
+}
+
+template <typename T>
+T get(const char*& in) {
+    T value;
+    memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return value;
+}
+
+bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+}
+
+Journal& Journal::instance() {
+    // never destroyed, detached threads may record events while the process exits
+    static Journal* journal = new Journal();
+    return *journal;
+}
+
+Journal::RingOwner::~RingOwner() {
+    if (ring) ring->retired.store(true, std::memory_order_release);
+}
+
+bool Journal::open(const std::string& directory, size_t segment_size) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    if (opened) return true;
+
+    if (mkdir(directory.c_str(), 0755) < 0 && errno != EEXIST) {
+        LOG_ERROR(LogFields(), "Cannot create journal directory %s: %s", directory.c_str(), strerror(errno));
+        return false;
+    }
+    // continue after the newest segment, an existing segment may end with a torn record
+    uint32_t last_index = 0;
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            unsigned index = 0;
+            if (sscanf(entry->d_name, "journal_%u.qj", &index) == 1) {
+                last_index = std::max<uint32_t>(last_index, index);
+            }
+        }
+        closedir(dir);
+    }
+
+    this->directory = directory;
+    this->segment_size = segment_size;
+    if (!open_segment(last_index + 1)) {
+        return false;
+    }
+    opened = true;
+
+    writer_thread = std::thread([this]() {
+        MemoryScope memory(MemoryTag::JOURNAL);
+        auto last_sync = std::chrono::steady_clock::now();
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(WRITE_INTERVAL_MS));
+            auto now = std::chrono::steady_clock::now();
+            bool sync = now - last_sync >= std::chrono::milliseconds(SYNC_INTERVAL_MS);
+            if (sync) last_sync = now;
+            write_pending(sync);
+        }
+    });
+    writer_thread.detach();
+    LOG_INFO(LogFields(), "Journaling games into %s/%s", directory.c_str(), segment_name(segment_index).c_str());
+    return true;
+}
+
+bool Journal::is_open() const {
+    return opened.load(std::memory_order_relaxed);
+}
+
+Journal::Ring* Journal::thread_ring() {
+    thread_local RingOwner owner;
+    if (owner.ring == nullptr) {
+        MemoryScope memory(MemoryTag::JOURNAL);
+        owner.ring = new Ring();
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        rings.push_back(owner.ring);
+    }
+    return owner.ring;
+}
+
+void Journal::record(const JournalEvent& event) {
+    if (!opened.load(std::memory_order_relaxed)) return;
+    Ring* ring = thread_ring();
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= RING_CAPACITY) {
+        Metrics::instance().journal_dropped.add();
+        return;
+    }
+    ring->events[head & (RING_CAPACITY - 1)] = event;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Journal::flush() {
+    if (!opened) return;
+    write_pending(true);
+}
+
+bool Journal::open_segment(uint32_t index) {
+    std::string path = directory + "/" + segment_name(index);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_ERROR(LogFields(), "Cannot create journal segment %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    char header[SEGMENT_HEADER_SIZE];
+    char* out = header;
+    memcpy(out, SEGMENT_MAGIC, sizeof(SEGMENT_MAGIC));
+    out += sizeof(SEGMENT_MAGIC);
+    put<uint32_t>(out, FORMAT_VERSION);
+    put<uint32_t>(out, index);
+    if (!write_all(fd, header, sizeof(header))) {
+        LOG_ERROR(LogFields(), "Cannot write journal segment header %s: %s", path.c_str(), strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    if (segment_fd >= 0) {
+        fdatasync(segment_fd);
+        ::close(segment_fd);
+    }
+    segment_fd = fd;
+    segment_index = index;
+    segment_bytes = sizeof(header);
+    return true;
+}
+
+void Journal::write_pending(bool sync) {
+    std::lock_guard<std::mutex> write_lock(write_mutex);
+    thread_local std::vector<JournalEvent> batch; // the writer keeps the capacity between batches
+    batch.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (auto it = rings.begin(); it != rings.end();) {
+            Ring* ring = *it;
+            // read retired before the events, so events recorded before the thread exited are not lost
+            bool retired = ring->retired.load(std::memory_order_acquire);
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                batch.push_back(ring->events[tail & (RING_CAPACITY - 1)]);
+            }
+            ring->tail.store(tail, std::memory_order_release);
+
+            if (retired) {
+                delete ring;
+                it = rings.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    if (!batch.empty()) {
+        // events of one game may come from different threads, keep the file roughly in time order
+        std::stable_sort(batch.begin(), batch.end(), [](const JournalEvent& a, const JournalEvent& b) {
+            return a.timestamp_us < b.timestamp_us;
+        });
+
+        thread_local std::string buffer;
+        buffer.clear();
+        char record[MAX_RECORD_SIZE];
+        for (const auto& event : batch) {
+            buffer.append(record, encode(event, record));
+        }
+
+        if (segment_bytes + buffer.size() > segment_size && segment_bytes > SEGMENT_HEADER_SIZE) {
+            open_segment(segment_index + 1);
+        }
+        if (write_all(segment_fd, buffer.data(), buffer.size())) {
+            segment_bytes += buffer.size();
+            unsynced = true;
+            Metrics::instance().journal_events.add(batch.size());
+        } else {
+            LOG_ERROR(LogFields(), "Journal write failed: %s", strerror(errno));
+            Metrics::instance().journal_dropped.add(batch.size());
+        }
+    }
+
+    if (sync && unsynced) {
+        fdatasync(segment_fd);
+        unsynced = false;
+    }
+}
+
+size_t Journal::encode(const JournalEvent& event, char* out) {
+    char* payload = out + RECORD_HEADER_SIZE;
+    char* cursor = payload;
+    put<uint8_t>(cursor, static_cast<uint8_t>(event.type));
+    put<uint32_t>(cursor, event.game_id);
+    put<uint32_t>(cursor, event.sequence);
+    put<int64_t>(cursor, event.timestamp_us);
+    put<uint8_t>(cursor, event.player);
+    put<uint8_t>(cursor, event.flags);
+    if (event.type == JournalEventType::MOVE) {
+        memcpy(cursor, event.cells, sizeof(event.cells));
+        cursor += sizeof(event.cells);
+    } else if (event.type == JournalEventType::GAME_START) {
+        for (const char* name : event.names) {
+            uint8_t length = static_cast<uint8_t>(strnlen(name, JournalEvent::NAME_SIZE - 1));
+            put<uint8_t>(cursor, length);
+            memcpy(cursor, name, length);
+            cursor += length;
+        }
+    }
+
+    uint16_t payload_size = static_cast<uint16_t>(cursor - payload);
+    char* header = out;
+    put<uint16_t>(header, payload_size);
+    put<uint32_t>(header, crc32(payload, payload_size));
+    return RECORD_HEADER_SIZE + payload_size;
+}
+
+size_t Journal::decode(const char* data, size_t size, JournalEvent& event) {
+    if (size < RECORD_HEADER_SIZE) return 0;
+    const char* cursor = data;
+    uint16_t payload_size = get<uint16_t>(cursor);
+    uint32_t checksum = get<uint32_t>(cursor);
+    if (payload_size < FIXED_PAYLOAD_SIZE || size - RECORD_HEADER_SIZE < payload_size) return 0;
+    if (crc32(cursor, payload_size) != checksum) return 0;
+
+    const char* end = cursor + payload_size;
+    event = JournalEvent();
+    event.type = static_cast<JournalEventType>(get<uint8_t>(cursor));
+    event.game_id = get<uint32_t>(cursor);
+    event.sequence = get<uint32_t>(cursor);
+    event.timestamp_us = get<int64_t>(cursor);
+    event.player = get<uint8_t>(cursor);
+    event.flags = get<uint8_t>(cursor);
+    if (event.type == JournalEventType::MOVE) {
+        if (end - cursor < static_cast<ptrdiff_t>(sizeof(event.cells))) return 0;
+        memcpy(event.cells, cursor, sizeof(event.cells));
+    } else if (event.type == JournalEventType::GAME_START) {
+        for (char* name : event.names) {
+            if (cursor >= end) return 0;
+            uint8_t length = get<uint8_t>(cursor);
+            if (length >= JournalEvent::NAME_SIZE || end - cursor < length) return 0;
+            memcpy(name, cursor, length);
+            name[length] = '\0';
+            cursor += length;
+        }
+    }
+    return RECORD_HEADER_SIZE + payload_size;
+}
+
+std::string Journal::segment_name(uint32_t index) {
+    char name[32];
+    snprintf(name, sizeof(name), "journal_%06u.qj", index);
+    return name;
+}
+
+uint32_t Journal::crc32(const char* data, size_t size) {
+    // table for the reflected IEEE polynomial, built once
+    static const auto table = []() {
+        std::vector<uint32_t> values(256);
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+            }
+            values[i] = value;
+        }
+        return values;
+    }();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
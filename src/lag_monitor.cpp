@@ -0,0 +1,47 @@
+#include "lag_monitor.h"
+#include <algorithm>
+#include <thread>
+#include "logger.h"
+#include "metrics.h"
+
+constexpr std::chrono::milliseconds LagMonitor::TICK;
+constexpr std::chrono::milliseconds LagMonitor::SHED_LAG;
+constexpr std::chrono::milliseconds LagMonitor::RECOVER_LAG;
+
+void LagMonitor::start() {
+    if (started.exchange(true)) return;
+    std::thread(&LagMonitor::run, this).detach();
+}
+
+int64_t LagMonitor::lag_us() const {
+    return smoothed_lag_us.load(std::memory_order_relaxed);
+}
+
+bool LagMonitor::is_overloaded() const {
+    return overloaded.load(std::memory_order_relaxed);
+}
+
+void LagMonitor::run() {
+    const int64_t shed_us = std::chrono::duration_cast<std::chrono::microseconds>(SHED_LAG).count();
+    const int64_t recover_us = std::chrono::duration_cast<std::chrono::microseconds>(RECOVER_LAG).count();
+    while (true) {
+        auto before = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(TICK);
+        auto late = std::chrono::steady_clock::now() - before - TICK;
+        int64_t sample = std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::microseconds>(late).count());
+        // EWMA with weight 1/4, a single slow wakeup does not start shedding
+        int64_t lag = smoothed_lag_us.load(std::memory_order_relaxed);
+        lag += (sample - lag) / 4;
+        smoothed_lag_us.store(lag, std::memory_order_relaxed);
+        Metrics::instance().scheduler_lag_us.set(lag);
+
+        bool was_overloaded = overloaded.load(std::memory_order_relaxed);
+        if (!was_overloaded && lag > shed_us) {
+            overloaded.store(true, std::memory_order_relaxed);
+            LOG_WARNING(LogFields(), "Scheduler lag %lld us, shedding new connections", (long long)lag);
+        } else if (was_overloaded && lag < recover_us) {
+            overloaded.store(false, std::memory_order_relaxed);
+            LOG_INFO(LogFields(), "Scheduler lag %lld us, accepting connections again", (long long)lag);
+        }
+    }
+}
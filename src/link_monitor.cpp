@@ -0,0 +1,119 @@
+#include "link_monitor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double GAP_WEIGHT = 0.1; // EWMA weight of a new gap
+constexpr double RTT_WEIGHT = 0.125; // RFC 6298 alpha
+constexpr double DEVIATION_WEIGHT = 0.25; // RFC 6298 beta
+
+double seconds_between(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+}
+}
+
+LinkMonitor::LinkMonitor(Clock::time_point now) : last_message(now), last_probe(now) {}
+
+void LinkMonitor::reset(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    last_message = now;
+    last_probe = now;
+    gap_mean = gap_variance = 0;
+    samples = 0;
+    smoothed_rtt = rtt_deviation = 0;
+    has_rtt = false;
+    last_acked = next_sequence - 1;  // echoes of heartbeats sent on the old connection are stale
+}
+
+void LinkMonitor::record_arrival(Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    double gap = seconds_between(last_message, now);
+    if (gap < BURST_SECONDS) return;
+    last_message = now;
+    if (gap >= MAX_SUSPECT_SECONDS) return;  // an outage, not a sample of the normal gaps
+    if (samples == 0) {
+        gap_mean = gap;
+        gap_variance = 0;
+    } else {
+        double difference = gap - gap_mean;
+        gap_mean += GAP_WEIGHT * difference;
+        gap_variance = (1 - GAP_WEIGHT) * (gap_variance + GAP_WEIGHT * difference * difference);
+    }
+    samples++;
+}
+
+uint32_t LinkMonitor::next_heartbeat(Clock::time_point now, int64_t& timestamp_us) {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    timestamp_us = to_timestamp_us(now);
+    last_probe = now;
+    return next_sequence++;
+}
+
+bool LinkMonitor::record_ack(uint32_t sequence, int64_t timestamp_us, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    int64_t now_us = to_timestamp_us(now);
+    if (sequence <= last_acked || sequence >= next_sequence || timestamp_us > now_us) return false;
+    last_acked = sequence;
+    double rtt = (now_us - timestamp_us) / 1e6;
+    if (!has_rtt) {
+        smoothed_rtt = rtt;
+        rtt_deviation = rtt / 2;
+        has_rtt = true;
+    } else {
+        rtt_deviation = (1 - DEVIATION_WEIGHT) * rtt_deviation + DEVIATION_WEIGHT * std::fabs(smoothed_rtt - rtt);
+        smoothed_rtt = (1 - RTT_WEIGHT) * smoothed_rtt + RTT_WEIGHT * rtt;
+    }
+    return true;
+}
+
+double LinkMonitor::phi(Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    return phi_locked(now);
+}
+
+double LinkMonitor::phi_locked(Clock::time_point now) const {
+    double silence = seconds_between(last_message, now);
+    // jitter of the link widens the distribution as well, a late echo is not yet a lost client
+    double deviation = std::max({std::sqrt(gap_variance), rtt_deviation, MIN_DEVIATION_SECONDS});
+    double y = (silence - gap_mean) / deviation;
+    // logistic approximation of the normal tail (as in the Akka phi-accrual detector)
+    double e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+    double p_later = (silence > gap_mean) ? e / (1.0 + e) : 1.0 - 1.0 / (1.0 + e);
+    return -std::log10(std::max(p_later, 1e-300));
+}
+
+bool LinkMonitor::is_suspected(Clock::time_point now) const {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    double silence = seconds_between(last_message, now);
+    if (silence < MIN_SUSPECT_SECONDS) return false;
+    if (silence >= MAX_SUSPECT_SECONDS) return true;
+    // silence alone is not enough, a probe sent after the last message has to go unanswered first
+    double probe_grace = PROBE_GRACE_SECONDS + smoothed_rtt + 4 * rtt_deviation;
+    if (last_probe <= last_message || seconds_between(last_probe, now) < probe_grace) return false;
+    if (samples < MIN_SAMPLES) return silence >= FALLBACK_SUSPECT_SECONDS;
+    return phi_locked(now) >= PHI_THRESHOLD;
+}
+
+double LinkMonitor::rtt_ms() const {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    return smoothed_rtt * 1000;
+}
+
+double LinkMonitor::jitter_ms() const {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    return rtt_deviation * 1000;
+}
+
+Clock::time_point LinkMonitor::last_arrival() const {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    return last_message;
+}
+
+Clock::time_point LinkMonitor::last_heartbeat() const {
+    std::lock_guard<std::mutex> lock(monitor_mutex);
+    return last_probe;
+}
+
+int64_t LinkMonitor::to_timestamp_us(Clock::time_point time) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+}
@@ -0,0 +1,164 @@
+#include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include "memory_accounting.h"
+
+Logger& Logger::instance() {
+    // never destroyed, detached threads may log while the process exits
+    static Logger* logger = new Logger();
+    return *logger;
+}
+
+Logger::Logger() {
+    drain_thread = std::thread([this]() {
+        MemoryScope memory(MemoryTag::LOGGING);
+        while (true) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(DRAIN_INTERVAL_MS));
+            drain();
+        }
+    });
+    drain_thread.detach();
+}
+
+Logger::RingOwner::~RingOwner() {
+    if (ring) ring->retired.store(true, std::memory_order_release);
+}
+
+Logger::Ring* Logger::thread_ring() {
+    thread_local RingOwner owner;
+    if (owner.ring == nullptr) {
+        MemoryScope memory(MemoryTag::LOGGING);
+        owner.ring = new Ring();
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        rings.push_back(owner.ring);
+    }
+    return owner.ring;
+}
+
+void Logger::log(LogLevel level, const LogFields& fields, const char* format, ...) {
+    if (static_cast<int>(level) < min_level.load(std::memory_order_relaxed)) return;
+    Ring* ring = thread_ring();
+    size_t head = ring->head.load(std::memory_order_relaxed);
+    if (head - ring->tail.load(std::memory_order_acquire) >= RING_CAPACITY) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Record& record = ring->records[head & (RING_CAPACITY - 1)];
+    record.level = level;
+    record.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    record.game_id = fields.game_id;
+    record.message_type = fields.message_type;
+    record.has_message_type = fields.has_message_type;
+    record.player[0] = '\0';
+    if (fields.player) {
+        strncpy(record.player, fields.player, PLAYER_SIZE - 1);
+        record.player[PLAYER_SIZE - 1] = '\0';
+    }
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(record.text, TEXT_SIZE, format, args);
+    va_end(args);
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+void Logger::set_min_level(LogLevel level) {
+    min_level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+void Logger::flush() {
+    drain();
+}
+
+uint64_t Logger::get_dropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+void Logger::drain() {
+    MemoryScope memory(MemoryTag::LOGGING);
+    std::lock_guard<std::mutex> drain_lock(drain_mutex);
+    thread_local std::vector<Record> batch; // drain runs on few threads, batch keeps its capacity
+    batch.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        for (auto it = rings.begin(); it != rings.end();) {
+            Ring* ring = *it;
+            // read retired before the records, so records written before the thread exited are not lost
+            bool retired = ring->retired.load(std::memory_order_acquire);
+            size_t tail = ring->tail.load(std::memory_order_relaxed);
+            size_t head = ring->head.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                batch.push_back(ring->records[tail & (RING_CAPACITY - 1)]);
+            }
+            ring->tail.store(tail, std::memory_order_release);
+
+            if (retired) {
+                delete ring;
+                it = rings.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    if (batch.empty()) return;
+
+    // records from different threads are merged by time so the output reads in order
+    std::stable_sort(batch.begin(), batch.end(), [](const Record& a, const Record& b) {
+        return a.timestamp_us < b.timestamp_us;
+    });
+
+    // warnings and errors go to stderr like before the logger was asynchronous, the rest to stdout
+    thread_local std::string output;
+    thread_local std::string errors;
+    output.clear();
+    errors.clear();
+    for (const auto& record : batch) {
+        format_record(record, record.level >= LogLevel::WARNING ? errors : output);
+    }
+    if (!output.empty()) {
+        fwrite(output.data(), 1, output.size(), stdout);
+        fflush(stdout);
+    }
+    if (!errors.empty()) {
+        fwrite(errors.data(), 1, errors.size(), stderr);
+        fflush(stderr);
+    }
+}
+
+void Logger::format_record(const Record& record, std::string& out) {
+    static const char* level_names[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+    time_t seconds = record.timestamp_us / 1000000;
+    tm local_time{};
+    localtime_r(&seconds, &local_time);
+    char prefix[64];
+    int length = snprintf(prefix, sizeof(prefix), "%02d:%02d:%02d.%06lld [%s]",
+        local_time.tm_hour, local_time.tm_min, local_time.tm_sec,
+        static_cast<long long>(record.timestamp_us % 1000000), level_names[static_cast<int>(record.level)]);
+    out.append(prefix, length);
+
+    if (record.game_id >= 0) {
+        out += " game=";
+        out += std::to_string(record.game_id);
+    }
+    if (record.player[0] != '\0') {
+        out += " player=";
+        out += record.player;
+    }
+    if (record.has_message_type) {
+        out += " type=";
+        out += Message::message_type_to_string(record.message_type);
+    }
+    out += ' ';
+    out += record.text;
+    out += '\n';
+}
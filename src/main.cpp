@@ -2,10 +2,18 @@
 #include <iostream>
 #include <fstream>
 #include "message.h"
+#include "logger.h"
 #include <any>
 
-int main() {
+int main(int argc, char* argv[]) {
     try {
+        // --worker <index> <channel fd> is how a front-end starts its game workers
+        if (argc > 3 && std::string(argv[1]) == "--worker") {
+            QuoridorServer worker;
+            worker.run_worker(std::stoul(argv[2]), std::stoi(argv[3]));
+            return 0;
+        }
+
         std::ifstream settings_file("../connection_settings.txt");
         if (!settings_file.is_open()) {
             throw std::runtime_error("Could not open connection settings file.");
@@ -16,8 +24,17 @@ int main() {
         settings_file >> address >> port;
 
         QuoridorServer server;
-        server.start(port);
+        // --takeover replaces the server already running on the port without dropping its connections
+        if (argc > 1 && std::string(argv[1]) == "--takeover") {
+            server.takeover(port);
+        } else if (argc > 2 && std::string(argv[1]) == "--workers") {
+            // --workers N does the handshakes and matchmaking here and runs the games in N worker processes
+            server.start_front_end(port, std::stoul(argv[2]));
+        } else {
+            server.start(port);
+        }
     } catch (const std::exception& e) {
+        Logger::instance().flush();
         std::cerr << "Server error: " << e.what() << std::endl;
         return 1;
     }
@@ -0,0 +1,29 @@
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool MappedFile::map(const std::string& path, bool sequential) {
+    unmap();
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat info{};
+    if (fstat(fd, &info) < 0 || info.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void* address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) return false;
+    if (sequential) madvise(address, info.st_size, MADV_SEQUENTIAL);
+    data = static_cast<const char*>(address);
+    size = info.st_size;
+    return true;
+}
+
+void MappedFile::unmap() {
+    if (data) munmap(const_cast<char*>(data), size);
+    data = nullptr;
+    size = 0;
+}
@@ -0,0 +1,189 @@
+#include "memory_accounting.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+namespace {
+thread_local MemoryTag current_tag = MemoryTag::OTHER;
+
+// Index of the shard used by the calling thread, threads are assigned round robin on first use
+size_t thread_shard() {
+    static std::atomic<size_t> next_shard{0};
+    thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed) % MemoryAccounting::SHARDS;
+    return shard;
+}
+}
+
+MemoryAccounting& MemoryAccounting::instance() {
+    // constant initialized (zeroed atomics, no constructor code), so it exists before the first allocation
+    static MemoryAccounting accounting;
+    return accounting;
+}
+
+bool MemoryAccounting::enabled() {
+#ifdef QUORIDOR_MEMORY_ACCOUNTING
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* MemoryAccounting::tag_name(MemoryTag tag) {
+    static const char* names[] = {"other", "network", "protocol", "game", "logging", "analysis", "journal"};
+    static_assert(sizeof(names) / sizeof(names[0]) == TAGS, "every tag needs a name");
+    return names[static_cast<size_t>(tag) % TAGS];
+}
+
+void MemoryAccounting::record_allocation(MemoryTag tag, size_t bytes) {
+    size_t index = static_cast<size_t>(tag);
+    Shard& shard = shards[thread_shard()];
+    shard.bytes[index].fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    uint64_t count = shard.allocations[index].fetch_add(1, std::memory_order_relaxed);
+    if (count % PEAK_SAMPLE == 0 || bytes >= LARGE_BLOCK) refresh_peaks(index);
+}
+
+void MemoryAccounting::record_free(MemoryTag tag, size_t bytes) {
+    size_t index = static_cast<size_t>(tag);
+    Shard& shard = shards[thread_shard()];
+    shard.bytes[index].fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    shard.frees[index].fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t MemoryAccounting::bytes_of(size_t tag) const {
+    int64_t bytes = 0;
+    for (const Shard& shard : shards) {
+        bytes += shard.bytes[tag].load(std::memory_order_relaxed);
+    }
+    return bytes;
+}
+
+void MemoryAccounting::refresh_peaks(size_t tag) {
+    auto raise = [](std::atomic<int64_t>& peak, int64_t value) {
+        int64_t seen = peak.load(std::memory_order_relaxed);
+        while (value > seen && !peak.compare_exchange_weak(seen, value, std::memory_order_relaxed)) {
+        }
+    };
+    raise(peaks[tag], bytes_of(tag));
+    int64_t all = 0;
+    for (size_t other = 0; other < TAGS; ++other) {
+        all += bytes_of(other);
+    }
+    raise(total_peak, all);
+}
+
+MemoryAccounting::Usage MemoryAccounting::usage(MemoryTag tag) const {
+    size_t index = static_cast<size_t>(tag);
+    Usage usage;
+    for (const Shard& shard : shards) {
+        usage.bytes += shard.bytes[index].load(std::memory_order_relaxed);
+        usage.allocations += shard.allocations[index].load(std::memory_order_relaxed);
+        usage.frees += shard.frees[index].load(std::memory_order_relaxed);
+    }
+    usage.peak = std::max(usage.bytes, peaks[index].load(std::memory_order_relaxed));
+    return usage;
+}
+
+MemoryAccounting::Usage MemoryAccounting::total() const {
+    Usage all;
+    for (size_t tag = 0; tag < TAGS; ++tag) {
+        Usage part = usage(static_cast<MemoryTag>(tag));
+        all.bytes += part.bytes;
+        all.allocations += part.allocations;
+        all.frees += part.frees;
+    }
+    all.peak = std::max(all.bytes, total_peak.load(std::memory_order_relaxed));
+    return all;
+}
+
+MemoryScope::MemoryScope(MemoryTag tag) : previous(current_tag) {
+    current_tag = tag;
+}
+
+MemoryScope::~MemoryScope() {
+    current_tag = previous;
+}
+
+MemoryTag MemoryScope::current() {
+    return current_tag;
+}
+
+#ifdef QUORIDOR_MEMORY_ACCOUNTING
+// Replacement of the global allocation functions. Every block starts HEADER_SIZE (or the alignment, if larger)
+// bytes before the pointer handed out, the header right in front of the pointer records what to undo on free.
+namespace {
+struct BlockHeader {
+    uint64_t size; // requested bytes
+    uint32_t offset; // from the start of the malloc block to the pointer handed out
+    MemoryTag tag;
+    uint8_t reserved[3];
+};
+constexpr size_t HEADER_SIZE = sizeof(BlockHeader);
+static_assert(HEADER_SIZE == 16 && HEADER_SIZE >= alignof(std::max_align_t), "header keeps malloc alignment");
+
+void* allocate_block(size_t size, size_t alignment) {
+    size_t offset = alignment > HEADER_SIZE ? alignment : HEADER_SIZE;
+    void* block;
+    if (alignment > HEADER_SIZE) {
+        // aligned_alloc needs a multiple of the alignment
+        block = aligned_alloc(alignment, (size + offset + alignment - 1) / alignment * alignment);
+    } else {
+        block = malloc(size + offset);
+    }
+    if (!block) return nullptr;
+    char* pointer = static_cast<char*>(block) + offset;
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(pointer - HEADER_SIZE);
+    header->size = size;
+    header->offset = static_cast<uint32_t>(offset);
+    header->tag = current_tag;
+    MemoryAccounting::instance().record_allocation(header->tag, size);
+    return pointer;
+}
+
+void* allocate_or_throw(size_t size, size_t alignment) {
+    while (true) {
+        if (void* pointer = allocate_block(size, alignment)) return pointer;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void free_block(void* pointer) {
+    if (!pointer) return;
+    BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<char*>(pointer) - HEADER_SIZE);
+    MemoryAccounting::instance().record_free(header->tag, header->size);
+    free(static_cast<char*>(pointer) - header->offset);
+}
+}
+
+void* operator new(size_t size) { return allocate_or_throw(size, 0); }
+void* operator new[](size_t size) { return allocate_or_throw(size, 0); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate_block(size, 0); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate_block(size, 0); }
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, static_cast<size_t>(alignment));
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate_block(size, static_cast<size_t>(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate_block(size, static_cast<size_t>(alignment));
+}
+
+// the header knows how the block was allocated, so every form of delete frees the same way
+void operator delete(void* pointer) noexcept { free_block(pointer); }
+void operator delete[](void* pointer) noexcept { free_block(pointer); }
+void operator delete(void* pointer, size_t) noexcept { free_block(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { free_block(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { free_block(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { free_block(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { free_block(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { free_block(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { free_block(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { free_block(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { free_block(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { free_block(pointer); }
+#endif
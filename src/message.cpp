@@ -1,31 +1,104 @@
 #include "message.h"
 #include "player.h"
+#include "analysis.h"
 #include "quoridor_game.h"
 #include <stdexcept>
-#include <iostream>
-#include <sstream>
+#include "logger.h"
+#include "memory_accounting.h"
+#include "profiler.h"
 #include <string>
 #include <optional>
 #include <map>
+#include <charconv>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+namespace {
+// Append decimal representation of value without creating a temporary string
+template <typename T>
+void append_int(std::string& buffer, T value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, result.ptr);
+}
+
+/**
+ * @brief Recycles the strings of wire buffers. When the last recipient drops a buffer its string returns here
+ * with its capacity, so serializing the next broadcast does not allocate. The control block of the shared_ptr
+ * comes from a PoolAllocator.
+ */
+class WirePool {
+public:
+    static constexpr size_t MAX_FREE = 256; // strings kept for reuse, more are freed
+    static constexpr size_t MAX_CAPACITY = 64 * 1024; // larger strings are freed instead of kept
+
+    static WirePool& instance() {
+        // never destroyed, buffers may be released by detached threads during exit
+        static WirePool* pool = new WirePool();
+        return *pool;
+    }
+
+    // Empty string to serialize into, owned by the caller until it is wrapped by share()
+    std::string* acquire() {
+        {
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (!free_strings.empty()) {
+                std::string* text = free_strings.back();
+                free_strings.pop_back();
+                return text;
+            }
+        }
+        return new std::string();
+    }
+
+    static WireBuffer share(std::string* text) {
+        return WireBuffer(text, [](const std::string* released) {
+            WirePool::instance().release(const_cast<std::string*>(released));
+        }, PoolAllocator<char>());
+    }
+
+private:
+    WirePool() { free_strings.reserve(MAX_FREE); }
+
+    void release(std::string* text) {
+        if (text->capacity() <= MAX_CAPACITY) {
+            text->clear();
+            std::lock_guard<std::mutex> lock(pool_mutex);
+            if (free_strings.size() < MAX_FREE) {
+                free_strings.push_back(text);
+                return;
+            }
+        }
+        delete text;
+    }
+
+    std::mutex pool_mutex; // protects free_strings
+    std::vector<std::string*> free_strings; // cleared strings with their capacity (never grows past MAX_FREE)
+};
+}
 
 Message::Message() {
     type = MessageType::WRONG_MESSAGE;
 }
 
 Message::Message(const std::string& message_string) {
+    PROFILE_ZONE("message_parse");
+    MemoryScope memory(MemoryTag::PROTOCOL);
     try {
         if (message_string.empty() || message_string.length() < 10) {
             type = MessageType::WRONG_MESSAGE;
             return;
         }
-        std::istringstream stream(message_string);
-        std::string type_str;
-        std::string data_str;
-        std::getline(stream, type_str, '|');
-        type = string_to_message_type(type_str.substr(5)); // Remove "type:"
-        data_str = message_string.substr(type_str.length() + 1); // Remove "type:" and "|"
-        if (data_str.substr(0, 5) == "data:") {
-            extract_data(data_str.substr(5));
+        // type:TYPE|data:... is split in place so parsing does not allocate a stream and copies of the input
+        size_t separator = message_string.find('|');
+        if (separator == std::string::npos || separator < 5) {
+            type = MessageType::WRONG_MESSAGE;
+            return;
+        }
+        type = string_to_message_type(message_string.substr(5, separator - 5)); // Remove "type:"
+        if (message_string.compare(separator + 1, 5, "data:") == 0) {
+            extract_data(std::string_view(message_string).substr(separator + 6));
         } else {
             type = MessageType::WRONG_MESSAGE;
         }
@@ -35,26 +108,30 @@ Message::Message(const std::string& message_string) {
             set_data("message", "Invalid message structure");
         }
     } catch (std::exception& e) {
-        std::cerr << "Error in Message constructor: " << e.what() << std::endl;
+        LOG_WARNING(LogFields(), "Error in Message constructor: %s", e.what());
         type = MessageType::WRONG_MESSAGE;
     }
 }
 
-bool Message::extract_data(const std::string& data_str) {
+bool Message::extract_data(std::string_view data_str) {
     if (data_str.length() == 1 && data_str[0] == ';') {
         return true; // No data, but validly formatted
     }
-    std::istringstream stream(data_str);
-    std::string pair;
-    while (std::getline(stream, pair, ';')) {
+    size_t start = 0;
+    while (start < data_str.length()) {
+        size_t end = data_str.find(';', start);
+        if (end == std::string_view::npos) end = data_str.length();
+        std::string_view pair = data_str.substr(start, end - start);
+        start = end + 1;
+
         auto delimiter_pos = pair.find('=');
-        if (delimiter_pos != std::string::npos) {
-            std::string key = pair.substr(0, delimiter_pos);
-            std::string value = pair.substr(delimiter_pos + 1);
+        if (delimiter_pos != std::string_view::npos) {
+            std::string_view key = pair.substr(0, delimiter_pos);
+            std::string_view value = pair.substr(delimiter_pos + 1);
             if (value.empty()) {
                 return false; // Empty values we do not allow
             }
-            data[key] = value;
+            data[std::string(key)] = std::string(value);
         }
     }
     return true;
@@ -65,6 +142,7 @@ void Message::set_type(MessageType msg_type) {
 }
 
 void Message::set_data(const std::string& key, const std::string& value) {
+    MemoryScope memory(MemoryTag::PROTOCOL);
     data[key] = value;
 }
 
@@ -81,14 +159,33 @@ std::optional<std::string> Message::get_data(const std::string& key) const {
 }
 
 std::string Message::to_string() const {
-    std::string message = "type:" + message_type_to_string(type) + "|data:";
+    std::string message;
+    serialize_to(message);
+    return message;
+}
+
+void Message::serialize_to(std::string& buffer) const {
+    MemoryScope memory(MemoryTag::PROTOCOL);
+    buffer += "type:";
+    buffer += message_type_to_string(type);
+    buffer += "|data:";
     for (const auto& pair : data) {
-        message += pair.first + "=" + pair.second + ";";
+        buffer += pair.first;
+        buffer += '=';
+        buffer += pair.second;
+        buffer += ';';
     }
     if (data.empty()) {
-        message += ";";
+        buffer += ';';
     }
-    return message;
+}
+
+WireBuffer Message::to_wire() const {
+    MemoryScope memory(MemoryTag::PROTOCOL);
+    std::string* wire = WirePool::instance().acquire();
+    serialize_to(*wire);
+    *wire += '\n';
+    return WirePool::share(wire);
 }
 
 // only implemented for those types that server receives
@@ -97,13 +194,18 @@ bool Message::validate() const {
         case MessageType::WELCOME:
             return (data.find("message") != data.end());
         case MessageType::MOVE:
-            // type:move|data:is_horizontal=false;player_id=1;position=[1,4];
+        case MessageType::PREMOVE:
+            // type:move|data:is_horizontal=false;player_id=1;position=[1,4]; (premove has the same fields)
             return (data.find("is_horizontal") != data.end() &&
                     data.find("player_id") != data.end() &&
                     data.find("position") != data.end());
         case MessageType::NAME_RESPONSE:
             return (data.find("name") != data.end());
+        case MessageType::SPECTATE:
+            // type:spectate|data:lobby_id=3;
+            return (data.find("lobby_id") != data.end());
         case MessageType::ABANDON:
+        case MessageType::ANALYZE:
         case MessageType::ACK:
         case MessageType::HEARTBEAT:
             return true;
@@ -148,49 +250,118 @@ Message Message::create_error(const std::string& message) {
 }
 
 Message Message::create_next_turn(QuoridorGame* game) {
+    PROFILE_ZONE("create_next_turn");
     Message msg;
     msg.set_type(MessageType::NEXT_TURN);
     msg.set_data("lobby_id", std::to_string(game->get_lobby_id()));
     msg.set_data("board", game->get_board_string());
-    msg.set_data("current_player_id", game->get_players()[game->get_current_player()]->id);
+    const std::vector<Player*>& players = game->get_players();
+    msg.set_data("current_player_id", players[game->get_current_player()]->id);
 
     // send walls
     msg.add_walls(game->get_horizontal_walls(), true);
     msg.add_walls(game->get_vertical_walls(), false);
+
+    // time left of both players in player order, the clock of current_player_id is running
+    msg.set_data("clocks", "[" + std::to_string(game->get_clock_ms(0)) + "," + std::to_string(game->get_clock_ms(1)) + "]");
+    msg.set_data("increment_ms", std::to_string(game->get_clock_increment_ms()));
+    // the board string has board_size x board_size cells
+    msg.set_data("variant", variant_info(game->get_variant()).name);
+    msg.set_data("board_size", std::to_string(game->get_board_size()));
     
     // Add players using the new method
-    msg.add_players(game->get_players());
+    msg.add_players(players);
     
     
     return msg;
 }
 
+WireBuffer Message::create_next_turn_wire(QuoridorGame* game) {
+    PROFILE_ZONE("create_next_turn");
+    MemoryScope memory(MemoryTag::PROTOCOL);
+    const std::vector<Player*>& players = game->get_players();
+    std::string* wire = WirePool::instance().acquire();
+    std::string& buffer = *wire;
+    // keys in the order of the data map, so the text matches create_next_turn(game).to_wire()
+    buffer += "type:next_turn|data:board=";
+    game->append_board_string(buffer);
+    buffer += ";board_size=";
+    append_int(buffer, game->get_board_size());
+    buffer += ";clocks=[";
+    append_int(buffer, game->get_clock_ms(0));
+    buffer += ',';
+    append_int(buffer, game->get_clock_ms(1));
+    buffer += "];current_player_id=";
+    buffer += players[game->get_current_player()]->id;
+    buffer += ";horizontal_walls=";
+    append_cells(buffer, game->get_horizontal_walls());
+    buffer += ";increment_ms=";
+    append_int(buffer, game->get_clock_increment_ms());
+    buffer += ";lobby_id=";
+    append_int(buffer, game->get_lobby_id());
+    buffer += ";players=";
+    append_players(buffer, players);
+    buffer += ";variant=";
+    buffer += variant_info(game->get_variant()).name;
+    buffer += ";vertical_walls=";
+    append_cells(buffer, game->get_vertical_walls());
+    buffer += ";\n";
+    return WirePool::share(wire);
+}
+
 void Message::add_walls(const std::vector<std::pair<int, int>>& walls, bool is_horizontal) {
-    std::string key = (is_horizontal) ? "horizontal_walls" : "vertical_walls";
-    std::string value = "";
-    for (int i = 0; i < walls.size(); i++) {
-        value += "[" + std::to_string(walls[i].first) + "," + std::to_string(walls[i].second) + "]";
-        if (i != walls.size() - 1) {
-            value += ",";
+    add_cells(is_horizontal ? "horizontal_walls" : "vertical_walls", walls);
+}
+
+void Message::add_cells(const char* key, const std::vector<std::pair<int, int>>& cells) {
+    std::string& value = data[key];
+    value.clear();
+    value.reserve(cells.size() * 6);
+    append_cells(value, cells);
+}
+
+void Message::append_cells(std::string& value, const std::vector<std::pair<int, int>>& cells) {
+    for (size_t i = 0; i < cells.size(); i++) {
+        value += '[';
+        append_int(value, cells[i].first);
+        value += ',';
+        append_int(value, cells[i].second);
+        value += ']';
+        if (i != cells.size() - 1) {
+            value += ',';
         }
     }
-    if (walls.empty()) {
+    if (cells.empty()) {
         value += "[]";
     }
-    data[key] = value;
 }
 
-void Message::add_players(std::vector<Player*> players) {
-    std::string key = "players";
-    std::string value = "";
-    for (int i = 0; i < players.size(); i++) {
-        value += "[id:" + players[i]->id + ",row:" + std::to_string(players[i]->position.first) + ",col:" + std::to_string(players[i]->position.second) + ",name:" + players[i]->name + ",board_char:" + std::string(1, players[i]->get_board_char()) + ",walls_left:" + std::to_string(players[i]->get_walls_left()) + "]";
+void Message::add_players(const std::vector<Player*>& players) {
+    std::string& value = data["players"];
+    value.clear();
+    append_players(value, players);
+    // here we do not check if the value is empty or not if it is I am throwing the pc out of the window.
+}
+
+void Message::append_players(std::string& value, const std::vector<Player*>& players) {
+    for (size_t i = 0; i < players.size(); i++) {
+        value += "[id:";
+        value += players[i]->id;
+        value += ",row:";
+        append_int(value, players[i]->position.first);
+        value += ",col:";
+        append_int(value, players[i]->position.second);
+        value += ",name:";
+        value += players[i]->name;
+        value += ",board_char:";
+        value += players[i]->get_board_char();
+        value += ",walls_left:";
+        append_int(value, players[i]->get_walls_left());
+        value += ']';
         if (i != players.size() - 1) {
             value += ",";
         }
     }
-    // here we do not check if the value is empty or not if it is I am throwing the pc out of the window.
-    data[key] = value;
 }
 
 Message Message::create_name_request() {
@@ -205,12 +376,48 @@ Message Message::create_heartbeat() {
     return msg;
 }
 
+Message Message::create_heartbeat(uint32_t sequence, int64_t timestamp_us) {
+    Message msg = create_heartbeat();
+    msg.set_data("seq", std::to_string(sequence));
+    msg.set_data("ts", std::to_string(timestamp_us));
+    return msg;
+}
+
 Message Message::create_ack() {
     Message msg;
     msg.set_type(MessageType::ACK);
     return msg;
 }
 
+Message Message::create_analysis(size_t lobby_id, uint32_t turn, const Analysis& analysis) {
+    Message msg;
+    msg.set_type(MessageType::ANALYSIS);
+    msg.set_data("lobby_id", std::to_string(lobby_id));
+    // the position after turn moves, a client can drop answers for positions it already left
+    msg.set_data("turn", std::to_string(turn));
+    msg.set_data("current_player_id", std::to_string(analysis.to_move + 1));
+    msg.set_data("distances", "[" + std::to_string(analysis.distances[0]) + "," + std::to_string(analysis.distances[1]) + "]");
+    // cells in the format of the wall lists, player ids are 1 and 2
+    msg.add_cells("route_1", analysis.routes[0]);
+    msg.add_cells("route_2", analysis.routes[1]);
+    // suggested move in the fields of a move message: one cell for a pawn step, two for a wall
+    if (!analysis.hint.empty()) {
+        msg.set_data("hint_is_horizontal", analysis.hint_is_horizontal ? "true" : "false");
+        msg.add_cells("hint_position", analysis.hint);
+    }
+    // the hint was looked up in the opening book instead of searched
+    if (analysis.from_book) {
+        msg.set_data("book_games", std::to_string(analysis.book_games));
+    }
+    // exact value of a race from the tablebase, for the player to move
+    if (analysis.solved) {
+        static const char* results[] = {"draw", "win", "loss"};
+        msg.set_data("race_result", results[static_cast<int>(analysis.race.result) % 3]);
+        msg.set_data("race_plies", std::to_string(analysis.race.plies));
+    }
+    return msg;
+}
+
 Message Message::create_player_disconnected(Player* player) {
     Message msg;
     msg.set_type(MessageType::PLAYER_DISCONNECTED);
@@ -242,6 +449,10 @@ std::string Message::message_type_to_string(MessageType type) {
         case MessageType::PLAYER_DISCONNECTED: return "player_disconnected";
         case MessageType::PLAYER_RECONNECTED: return "player_reconnected";
         case MessageType::ABANDON: return "abandon";
+        case MessageType::SPECTATE: return "spectate";
+        case MessageType::PREMOVE: return "premove";
+        case MessageType::ANALYZE: return "analyze";
+        case MessageType::ANALYSIS: return "analysis";
         default: return "unknown";
     }
 }
@@ -261,6 +472,10 @@ MessageType Message::string_to_message_type(const std::string& typeStr) {
     if (typeStr == "player_disconnected") return MessageType::PLAYER_DISCONNECTED;
     if (typeStr == "player_reconnected") return MessageType::PLAYER_RECONNECTED;
     if (typeStr == "abandon") return MessageType::ABANDON;
+    if (typeStr == "spectate") return MessageType::SPECTATE;
+    if (typeStr == "premove") return MessageType::PREMOVE;
+    if (typeStr == "analyze") return MessageType::ANALYZE;
+    if (typeStr == "analysis") return MessageType::ANALYSIS;
     return MessageType::WRONG_MESSAGE;
 }
 
@@ -0,0 +1,207 @@
+#include "metrics.h"
+#include <pthread.h>
+#include <fstream>
+#include <sstream>
+#include "memory_accounting.h"
+
+namespace {
+// Index of the shard used by the calling thread, threads are assigned round robin on first use
+size_t thread_shard() {
+    static std::atomic<size_t> next_shard{0};
+    thread_local size_t shard = next_shard.fetch_add(1, std::memory_order_relaxed);
+    return shard;
+}
+}
+
+void Counter::add(uint64_t value) {
+    shards[thread_shard() % SHARDS].value.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t Counter::value() const {
+    uint64_t total = 0;
+    for (const auto& shard : shards) {
+        total += shard.value.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+int Histogram::bucket_index(uint64_t value) {
+    if (value < SUB_BUCKETS) {
+        return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value); // position of the highest set bit (>= SUB_BUCKET_BITS)
+    int sub_bucket = static_cast<int>((value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub_bucket;
+}
+
+uint64_t Histogram::bucket_upper_bound(int index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+    int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    uint64_t sub_bucket = index % SUB_BUCKETS;
+    uint64_t lower = (uint64_t(1) << exponent) | (sub_bucket << (exponent - SUB_BUCKET_BITS));
+    return lower + (uint64_t(1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+void Histogram::record(uint64_t value) {
+    Shard& shard = shards[thread_shard() % SHARDS];
+    shard.buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.count.fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::Summary Histogram::summarize() const {
+    Summary summary;
+    std::array<uint64_t, BUCKETS> merged{};
+    for (const auto& shard : shards) {
+        summary.sum += shard.sum.load(std::memory_order_relaxed);
+        for (int i = 0; i < BUCKETS; ++i) {
+            uint64_t bucket = shard.buckets[i].load(std::memory_order_relaxed);
+            merged[i] += bucket;
+            summary.count += bucket;
+        }
+    }
+    if (summary.count == 0) return summary;
+
+    // walk buckets once and pick the first bucket that covers each percentile
+    uint64_t p50_rank = (summary.count * 500 + 999) / 1000;
+    uint64_t p99_rank = (summary.count * 990 + 999) / 1000;
+    uint64_t p999_rank = (summary.count * 999 + 999) / 1000;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; ++i) {
+        if (merged[i] == 0) continue;
+        seen += merged[i];
+        uint64_t bound = bucket_upper_bound(i);
+        if (summary.p50 == 0 && seen >= p50_rank) summary.p50 = bound;
+        if (summary.p99 == 0 && seen >= p99_rank) summary.p99 = bound;
+        if (summary.p999 == 0 && seen >= p999_rank) summary.p999 = bound;
+        summary.max = bound;
+    }
+    return summary;
+}
+
+Metrics& Metrics::instance() {
+    // never destroyed, detached threads may record while the process exits
+    static Metrics* metrics = new Metrics();
+    return *metrics;
+}
+
+Metrics::Metrics() : start_time(std::chrono::steady_clock::now()), last_snapshot_time(start_time) {}
+
+namespace {
+void write_histogram(std::ostringstream& out, const std::string& name, const Histogram& histogram) {
+    Histogram::Summary summary = histogram.summarize();
+    out << name << "_count " << summary.count << "\n";
+    out << name << "_avg " << (summary.count ? summary.sum / summary.count : 0) << "\n";
+    out << name << "_p50 " << summary.p50 << "\n";
+    out << name << "_p99 " << summary.p99 << "\n";
+    out << name << "_p999 " << summary.p999 << "\n";
+    out << name << "_max " << summary.max << "\n";
+}
+
+// Threads of the process (from /proc) and the stack size a new thread reserves
+void thread_usage(size_t& threads, size_t& stack_size) {
+    threads = 0;
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.compare(0, 8, "Threads:") == 0) {
+            threads = std::stoul(line.substr(8));
+            break;
+        }
+    }
+    stack_size = 0;
+    pthread_attr_t attributes;
+    if (pthread_attr_init(&attributes) == 0) {
+        pthread_attr_getstacksize(&attributes, &stack_size);
+        pthread_attr_destroy(&attributes);
+    }
+}
+
+void write_memory(std::ostringstream& out, double allocations_per_sec, int64_t connections) {
+    const MemoryAccounting& memory = MemoryAccounting::instance();
+    MemoryAccounting::Usage heap = memory.total();
+    out << "memory_accounting " << (MemoryAccounting::enabled() ? 1 : 0) << "\n";
+    out << "memory_bytes " << heap.bytes << "\n";
+    out << "memory_peak_bytes " << heap.peak << "\n";
+    out << "memory_allocations_per_sec " << allocations_per_sec << "\n";
+    for (size_t tag = 0; tag < MemoryAccounting::TAGS; ++tag) {
+        std::string name = std::string("memory_") + MemoryAccounting::tag_name(static_cast<MemoryTag>(tag));
+        MemoryAccounting::Usage usage = memory.usage(static_cast<MemoryTag>(tag));
+        out << name << "_bytes " << usage.bytes << "\n";
+        out << name << "_peak_bytes " << usage.peak << "\n";
+        out << name << "_allocations " << usage.allocations << "\n";
+        out << name << "_blocks " << usage.allocations - usage.frees << "\n";
+    }
+    // what each connection costs on the heap: its buffers, its messages and its share of the games
+    int64_t per_connection = memory.usage(MemoryTag::NETWORK).bytes + memory.usage(MemoryTag::PROTOCOL).bytes +
+        memory.usage(MemoryTag::GAME).bytes;
+    out << "memory_per_connection_bytes " << (connections > 0 ? per_connection / connections : 0) << "\n";
+    size_t threads;
+    size_t stack_size;
+    thread_usage(threads, stack_size);
+    out << "threads " << threads << "\n";
+    // address space reserved for stacks, only the touched pages are resident
+    out << "thread_stack_bytes " << threads * stack_size << "\n";
+}
+}
+
+std::string Metrics::snapshot() {
+    auto now = std::chrono::steady_clock::now();
+    uint64_t total_moves = moves.value();
+    uint64_t total_allocations = MemoryAccounting::instance().total().allocations;
+    double moves_per_sec = 0;
+    double allocations_per_sec = 0;
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex);
+        double elapsed = std::chrono::duration<double>(now - last_snapshot_time).count();
+        if (elapsed > 0) {
+            moves_per_sec = (total_moves - last_snapshot_moves) / elapsed;
+            allocations_per_sec = (total_allocations - last_snapshot_allocations) / elapsed;
+        }
+        last_snapshot_time = now;
+        last_snapshot_moves = total_moves;
+        last_snapshot_allocations = total_allocations;
+    }
+
+    std::ostringstream out;
+    out << "uptime_seconds " << std::chrono::duration_cast<std::chrono::seconds>(now - start_time).count() << "\n";
+    out << "connections_accepted " << connections_accepted.value() << "\n";
+    out << "open_connections " << open_connections.value() << "\n";
+    out << "active_games " << active_games.value() << "\n";
+    out << "retired_games " << retired_games.value() << "\n";
+    out << "games_started " << games_started.value() << "\n";
+    out << "reconnections " << reconnections.value() << "\n";
+    out << "heartbeat_timeouts " << heartbeat_timeouts.value() << "\n";
+    out << "disconnections " << disconnections.value() << "\n";
+    out << "connections_rejected " << connections_rejected.value() << "\n";
+    out << "messages_rate_limited " << messages_rate_limited.value() << "\n";
+    out << "scheduler_lag_us " << scheduler_lag_us.value() << "\n";
+    out << "heartbeats_sent " << heartbeats_sent.value() << "\n";
+    out << "acks_suppressed " << acks_suppressed.value() << "\n";
+    out << "moves " << total_moves << "\n";
+    out << "moves_per_sec " << moves_per_sec << "\n";
+    out << "invalid_moves " << invalid_moves.value() << "\n";
+    out << "premoves_played " << premoves_played.value() << "\n";
+    out << "premoves_rejected " << premoves_rejected.value() << "\n";
+    out << "flag_falls " << flag_falls.value() << "\n";
+    out << "worker_restarts " << worker_restarts.value() << "\n";
+    write_histogram(out, "heartbeat_rtt_ns", heartbeat_rtt_ns);
+    write_histogram(out, "wall_validation_ns", wall_validation_ns);
+    write_histogram(out, "send_latency_ns", send_latency_ns);
+    out << "spectators " << spectators.value() << "\n";
+    out << "spectator_updates " << spectator_updates.value() << "\n";
+    out << "spectator_conflated " << spectator_conflated.value() << "\n";
+    out << "spectators_dropped " << spectators_dropped.value() << "\n";
+    out << "analysis_requests " << analysis_requests.value() << "\n";
+    out << "analysis_cache_hits " << analysis_cache_hits.value() << "\n";
+    out << "analysis_rejected " << analysis_rejected.value() << "\n";
+    write_histogram(out, "analysis_ns", analysis_ns);
+    out << "live_players " << live_players.value() << "\n";
+    out << "live_games " << live_games.value() << "\n";
+    write_memory(out, allocations_per_sec, open_connections.value());
+    out << "journal_events " << journal_events.value() << "\n";
+    out << "journal_dropped " << journal_dropped.value() << "\n";
+    return out.str();
+}
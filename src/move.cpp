@@ -1,11 +1,18 @@
 #include "move.h"
-#include <sstream>
+#include <charconv>
+#include "profiler.h"
 
 Move::Move(bool is_horizontal, std::vector<std::pair<int, int>> position, int player_id) 
-    : is_horizontal(is_horizontal), position(position), player_id(player_id) {}
+    : player_id(player_id), is_horizontal(is_horizontal), is_valid_structure(true), position(position) {}
 
-Move::Move(Message message) {
-    if (message.get_type() != MessageType::MOVE) {
+Move::Move(const Message& message) {
+    decode(message);
+}
+
+void Move::decode(const Message& message) {
+    PROFILE_ZONE("move_decode");
+    position.clear();
+    if (message.get_type() != MessageType::MOVE && message.get_type() != MessageType::PREMOVE) {
         is_valid_structure = false;
         return;
     }
@@ -25,22 +32,29 @@ Move::Move(Message message) {
         is_horizontal = (*is_horizontal_opt == "true");
         player_id = std::stoi(*player_id_opt);
 
-        std::istringstream pos_stream(*position_opt);
-        std::string pos_pair;
-        while (std::getline(pos_stream, pos_pair, ']')) {
-            if (pos_pair.empty()) continue;
-            pos_pair = pos_pair.substr(pos_pair.find('[') + 1);
-            auto delimiter_pos = pos_pair.find(',');
-            if (delimiter_pos != std::string::npos) {
-                int row = std::stoi(pos_pair.substr(0, delimiter_pos));
-                int col = std::stoi(pos_pair.substr(delimiter_pos + 1));
+        // position is "[r,c]" for player moves and "[r1,c1],[r2,c2]" for walls
+        const std::string& positions = *position_opt;
+        position.reserve(2);
+        size_t open = positions.find('[');
+        while (open != std::string::npos) {
+            size_t close = positions.find(']', open);
+            if (close == std::string::npos) break;
+            size_t delimiter_pos = positions.find(',', open);
+            if (delimiter_pos != std::string::npos && delimiter_pos < close) {
+                int row = 0, col = 0;
+                auto row_result = std::from_chars(positions.data() + open + 1, positions.data() + delimiter_pos, row);
+                auto col_result = std::from_chars(positions.data() + delimiter_pos + 1, positions.data() + close, col);
+                if (row_result.ec != std::errc() || col_result.ec != std::errc()) {
+                    is_valid_structure = false;
+                    return;
+                }
                 if (row < 0 || col < 0) {
                     is_valid_structure = false;
                     return;
                 }
                 position.emplace_back(row, col);
             }
-            pos_stream.ignore(1, ','); // Ignore the comma
+            open = positions.find('[', close);
         }
 
 
@@ -54,7 +68,7 @@ bool Move::get_is_horizontal() const {
     return is_horizontal;
 }
 
-std::vector<std::pair<int, int>> Move::get_position() const {
+const std::vector<std::pair<int, int>>& Move::get_position() const {
     return position;
 }
 
@@ -0,0 +1,70 @@
+#include "opening_book.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+};
+}
+
+uint64_t OpeningBook::position_key(const VariantPosition& position, int to_move) {
+    uint64_t value = std::visit([](const auto& alternative) {
+        return std::decay_t<decltype(alternative)>::Engine::hash(alternative);
+    }, position);
+    return value ^ ((position.index() * 2 + static_cast<uint64_t>(to_move)) * 0x9e3779b97f4a7c15ull);
+}
+
+bool OpeningBook::write(const std::string& path, std::vector<Entry>& book) {
+    std::stable_sort(book.begin(), book.end(), [](const Entry& a, const Entry& b) { return a.key < b.key; });
+    book.erase(std::unique(book.begin(), book.end(), [](const Entry& a, const Entry& b) { return a.key == b.key; }),
+               book.end());
+
+    FileHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.entry_count = static_cast<uint32_t>(book.size());
+    std::string temporary = path + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (!out) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+        fwrite(book.data(), sizeof(Entry), book.size(), out) == book.size();
+    // data has to be on disk before the rename, the server maps the file on its next start
+    ok = ok && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    ok = (fclose(out) == 0) && ok;
+    return ok && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool OpeningBook::open(const std::string& path) {
+    entries = nullptr;
+    count = 0;
+    if (!file.map(path, false)) return false;
+    FileHeader header;
+    if (file.size < sizeof(header)) return false;
+    memcpy(&header, file.data, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != FORMAT_VERSION ||
+        file.size < sizeof(header) + header.entry_count * sizeof(Entry)) {
+        file.unmap();
+        return false;
+    }
+    // the header is 16 bytes, so the entries stay 8 byte aligned in the mapping
+    entries = reinterpret_cast<const Entry*>(file.data + sizeof(header));
+    count = header.entry_count;
+    return true;
+}
+
+bool OpeningBook::probe(const VariantPosition& position, int to_move, Entry& entry) const {
+    if (count == 0) return false;
+    uint64_t key = position_key(position, to_move);
+    const Entry* end = entries + count;
+    const Entry* found = std::lower_bound(entries, end, key, [](const Entry& candidate, uint64_t wanted) {
+        return candidate.key < wanted;
+    });
+    if (found == end || found->key != key) return false;
+    entry = *found;
+    return true;
+}
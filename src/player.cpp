@@ -1,24 +1,100 @@
 #include "player.h"
-#include <sys/socket.h>
-#include <iostream>
+#include "clock.h"
+#include "logger.h"
 #include "message.h"
+#include "object_pool.h"
+#include "memory_accounting.h"
+#include "metrics.h"
+#include "profiler.h"
+
+namespace {
+// Pool is intentionally never destroyed, detached client threads may still delete players during exit
+ObjectPool<Player>& player_pool() {
+    static ObjectPool<Player>* pool = new ObjectPool<Player>();
+    return *pool;
+}
+
+// Serialization buffer reused for every message sent from this thread
+std::string& outbound_buffer() {
+    thread_local std::string buffer;
+    buffer.clear();
+    return buffer;
+}
+}
 
 // Define static const members
 const int Player::HEARTBEAT_INTERVAL;
 const int Player::NORMAL_HEARTBEAT_TIMEOUT;
 const int Player::RECONNECTION_HEARTBEAT_TIMEOUT;
+const double Player::MESSAGES_PER_SECOND;
+const double Player::MESSAGE_BURST;
+const size_t Player::MAX_DROPPED_MESSAGES;
+
+Player::Player(std::shared_ptr<Transport> transport)
+    : transport(std::move(transport)), game_id(-1), is_connected(true), is_reconnecting(false) {}
 
-Player::Player(int sock) : socket(sock), is_reconnecting(false), is_connected(true) {}
+void* Player::operator new(std::size_t size) {
+    MemoryScope memory(MemoryTag::GAME);
+    Metrics::instance().live_players.add(1);
+    if (size != sizeof(Player)) return ::operator new(size);
+    return player_pool().allocate();
+}
+
+void Player::operator delete(void* ptr, std::size_t size) {
+    Metrics::instance().live_players.add(-1);
+    if (size != sizeof(Player)) {
+        ::operator delete(ptr);
+        return;
+    }
+    player_pool().deallocate(ptr);
+}
+
+size_t Player::live_count() {
+    return player_pool().live_count();
+}
 
 void Player::send_message(const std::string& message) {
-    std::string msg = message + "\n";
-    send(socket, msg.c_str(), msg.length()+1, 0);
+    std::string& buffer = outbound_buffer();
+    buffer += message;
+    send_buffer(buffer);
 }
 
 void Player::send_message(const Message& message) {
+    std::string& buffer = outbound_buffer();
+    message.serialize_to(buffer);
     // first line only for debugging
-    if (message.get_type() != MessageType::HEARTBEAT) std::cout << "Sending message: " << message.to_string() << std::endl;
-    send_message(message.to_string());
+    if (message.get_type() != MessageType::HEARTBEAT) {
+        LOG_DEBUG(LogFields(game_id, name, message.get_type()), "Sending message: %s", buffer.c_str());
+    }
+    send_buffer(buffer);
+}
+
+void Player::send_buffer(std::string& buffer) {
+    buffer += '\n';
+    send_line(buffer);
+}
+
+void Player::send_wire(const WireBuffer& wire) {
+    send_line(*wire);
+}
+
+void Player::send_line(const std::string& line) {
+    // wire format includes the terminating zero after the newline
+    PROFILE_ZONE("socket_send");
+    ScopedTimer timer(Metrics::instance().send_latency_ns);
+    auto connection = get_transport();
+    if (!connection) {
+        return;  // player restored from a snapshot that has not reconnected yet
+    }
+    connection->send_bytes(line.c_str(), line.length() + 1);
+}
+
+std::shared_ptr<Transport> Player::get_transport() const {
+    return std::atomic_load(&transport);
+}
+
+void Player::set_transport(std::shared_ptr<Transport> transport) {
+    std::atomic_store(&this->transport, std::move(transport));
 }
 
 void Player::set_id(std::string id) {
@@ -66,15 +142,54 @@ void Player::set_game_id(int game_id) {
 }
 
 void Player::update_heartbeat() {
-    last_heartbeat = std::chrono::steady_clock::now();
+    last_heartbeat = Clock::now();
+    link.record_arrival(last_heartbeat);
     is_connected = true;
 }
 
 bool Player::check_connection() {
-    auto now = std::chrono::steady_clock::now();
-    auto duration = std::chrono::duration_cast<std::chrono::seconds>(
-        now - last_heartbeat).count();
-    return duration < NORMAL_HEARTBEAT_TIMEOUT;
+    return !link.is_suspected(Clock::now());
+}
+
+bool Player::heartbeat_due() const {
+    auto current = get_transport();
+    auto now = Clock::now();
+    const auto interval = std::chrono::seconds(HEARTBEAT_INTERVAL);
+    // our own messages do not make the client answer, only its silence decides
+    return current && now - current->last_receive_time() >= interval && now - link.last_heartbeat() >= interval;
+}
+
+void Player::send_heartbeat() {
+    int64_t timestamp_us;
+    uint32_t sequence = link.next_heartbeat(Clock::now(), timestamp_us);
+    send_message(Message::create_heartbeat(sequence, timestamp_us));
+    Metrics::instance().heartbeats_sent.add();
+}
+
+void Player::acknowledge_heartbeat() {
+    auto current = get_transport();
+    if (current && Clock::now() - current->last_send_time() < std::chrono::seconds(HEARTBEAT_INTERVAL)) {
+        // the client heard from us recently, that already proves the server is alive
+        Metrics::instance().acks_suppressed.add();
+        return;
+    }
+    send_message(Message::create_ack());
+}
+
+void Player::handle_ack(const Message& message) {
+    auto sequence = message.get_data("seq");
+    auto timestamp = message.get_data("ts");
+    if (!sequence || !timestamp) return;  // plain ACK (older clients)
+    try {
+        auto now = Clock::now();
+        int64_t sent_us = std::stoll(timestamp.value());
+        if (link.record_ack(static_cast<uint32_t>(std::stoul(sequence.value())), sent_us, now)) {
+            Metrics::instance().heartbeat_rtt_ns.record(
+                static_cast<uint64_t>(LinkMonitor::to_timestamp_us(now) - sent_us) * 1000);
+        }
+    } catch (const std::exception&) {
+        // malformed echo, nothing to measure
+    }
 }
 
 void Player::set_board_char(char board_char) {
@@ -0,0 +1,73 @@
+#include "profiler.h"
+#include <unistd.h>
+
+Profiler& Profiler::instance() {
+    // never destroyed, detached threads may record while the process exits
+    static Profiler* profiler = new Profiler();
+    return *profiler;
+}
+
+Profiler::BufferOwner::~BufferOwner() {
+    if (buffer) buffer->retired.store(true, std::memory_order_release);
+}
+
+Profiler::ThreadBuffer* Profiler::thread_buffer() {
+    thread_local BufferOwner owner;
+    if (owner.buffer == nullptr) {
+        owner.buffer = new ThreadBuffer();
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        owner.buffer->thread_id = next_thread_id++;
+        buffers.push_back(owner.buffer);
+    }
+    return owner.buffer;
+}
+
+void Profiler::record(const char* name, int64_t start_ns, int64_t duration_ns) {
+    ThreadBuffer* buffer = thread_buffer();
+    uint64_t index = buffer->written.load(std::memory_order_relaxed);
+    buffer->events[index & (EVENTS_PER_THREAD - 1)] = Event{name, start_ns, duration_ns};
+    buffer->written.store(index + 1, std::memory_order_release);
+}
+
+std::string Profiler::dump_chrome_trace() {
+    std::string json = "{\"traceEvents\":[";
+    bool first = true;
+    int pid = getpid();
+    char line[256];
+
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for (auto it = buffers.begin(); it != buffers.end();) {
+        ThreadBuffer* buffer = *it;
+        bool retired = buffer->retired.load(std::memory_order_acquire);
+        uint64_t end = buffer->written.load(std::memory_order_acquire);
+        uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+
+        std::vector<Event> events;
+        events.reserve(end - begin);
+        for (uint64_t i = begin; i < end; ++i) {
+            events.push_back(buffer->events[i & (EVENTS_PER_THREAD - 1)]);
+        }
+        // slots the owner overwrote while we were copying are dropped
+        uint64_t after = buffer->written.load(std::memory_order_acquire);
+        size_t skip = (after > begin + EVENTS_PER_THREAD) ? after - begin - EVENTS_PER_THREAD : 0;
+
+        for (size_t i = skip; i < events.size(); ++i) {
+            int length = snprintf(line, sizeof(line),
+                "%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+                first ? "" : ",", events[i].name, events[i].start_ns / 1000.0, events[i].duration_ns / 1000.0,
+                pid, buffer->thread_id);
+            json.append(line, length);
+            first = false;
+        }
+
+        // buffers of exited threads are released once they made it into a dump
+        if (retired) {
+            delete buffer;
+            it = buffers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    json += "]}\n";
+    return json;
+}
@@ -1,13 +1,61 @@
 #include "quoridor_game.h"
 #include <thread>
-#include <queue>
 #include <vector>
 #include <algorithm>
+#include <type_traits>
 #include <utility>
+#include <variant>
+#include "object_pool.h"
+#include "pool_allocator.h"
+#include "memory_accounting.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "clock.h"
+#include "journal.h"
+#include "timer_service.h"
+#include <cstring>
+
+namespace {
+// Pool is intentionally never destroyed, same as the player pool
+ObjectPool<QuoridorGame, 16>& game_pool() {
+    static ObjectPool<QuoridorGame, 16>* pool = new ObjectPool<QuoridorGame, 16>();
+    return *pool;
+}
+}
+
+QuoridorGame::QuoridorGame(Variant variant)
+    : variant(variant), board_size(variant_info(variant).board_size), rules_position(initial_position(variant)),
+      state(GameState::WAITING), current_player(0), snapshot_slot(std::make_shared<SnapshotSlot>()) {
+    const VariantInfo& info = variant_info(variant);
+    // walls come in pairs of cells, each player places at most walls_per_player walls
+    horizontal_walls.reserve(2 * 2 * info.walls_per_player);
+    vertical_walls.reserve(2 * 2 * info.walls_per_player);
+    clock_ms[0] = clock_ms[1] = info.initial_clock_ms;
+}
+
+void* QuoridorGame::operator new(std::size_t size) {
+    MemoryScope memory(MemoryTag::GAME);
+    Metrics::instance().live_games.add(1);
+    if (size != sizeof(QuoridorGame)) return ::operator new(size);
+    return game_pool().allocate();
+}
+
+void QuoridorGame::operator delete(void* ptr, std::size_t size) {
+    Metrics::instance().live_games.add(-1);
+    if (size != sizeof(QuoridorGame)) {
+        ::operator delete(ptr);
+        return;
+    }
+    game_pool().deallocate(ptr);
+}
 
-QuoridorGame::QuoridorGame() : state(GameState::WAITING), current_player(0) {}
+size_t QuoridorGame::live_count() {
+    return game_pool().live_count();
+}
 
 QuoridorGame::~QuoridorGame() {
+    // a running flag-fall callback takes game_mutex, wait for it before the game goes away
+    TimerService::instance().cancel_all(this);
     std::lock_guard<std::mutex> lock(game_mutex);
     state = GameState::ENDED;
     /*
@@ -37,8 +85,8 @@ bool QuoridorGame::add_player(Player* player) {
 }
 
 void QuoridorGame::initialize_board() {
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
+    for (int i = 0; i < board_size; ++i) {
+        for (int j = 0; j < board_size; ++j) {
             board[i][j] = EMPTY_CELL;
         }
     }
@@ -50,45 +98,219 @@ void QuoridorGame::initialize_game() {
     initialize_players();
     initialize_board();
     state = GameState::IN_PROGRESS;
+    if (Journal::instance().is_open()) {
+        JournalEvent event;
+        event.type = JournalEventType::GAME_START;
+        event.flags = static_cast<uint8_t>(variant);
+        for (int i = 0; i < 2; ++i) {
+            strncpy(event.names[i], players[i]->name.c_str(), JournalEvent::NAME_SIZE - 1);
+        }
+        journal_event(event);
+    }
+    turn_started = Clock::now();
+    schedule_flag_fall();
+    publish_snapshot();
     notify_all_players(Message::create_game_started(this));
     send_next_turn();
     start_heartbeat_checker();
 }
 
 
-void QuoridorGame::handle_move(Move move) {
+void QuoridorGame::handle_move(const Move& move) {
+    PROFILE_ZONE("handle_move");
+    std::lock_guard<std::mutex> lock(game_mutex);
+    if (state != GameState::IN_PROGRESS) return;
+    if (is_flag_down()) {
+        handle_game_end(JOURNAL_END_TIMEOUT);  // the move came in after the flag fell, the timer was just slower
+        return;
+    }
     if (move.get_player_id() != current_player) {
+        Metrics::instance().invalid_moves.add();
         players[move.get_player_id()]->send_message(Message::create_error("Not your turn"));
         return;
     }
     if (!can_move(move)) {
+        Metrics::instance().invalid_moves.add();
         players[current_player]->send_message(Message::create_error("Invalid move"));
         return;
     }
-    // handle move
-    apply_move(move);
+    play_move(move);
     if (check_game_end()) {
         handle_game_end();
         return;
     }
+    // the opponent may have queued its answer, it is played right away and both moves go out in one update
+    if (premove && premove->get_player_id() == current_player) {
+        Move queued = std::move(*premove);
+        premove.reset();
+        if (can_move(queued)) {
+            Metrics::instance().premoves_played.add();
+            play_move(queued);
+            if (check_game_end()) {
+                handle_game_end();
+                return;
+            }
+        } else {
+            Metrics::instance().premoves_rejected.add();
+            players[current_player]->send_message(Message::create_error("Premove is not valid anymore"));
+        }
+    }
     send_next_turn();
 }
 
-void QuoridorGame::handle_game_end() {
+void QuoridorGame::handle_premove(const Move& move) {
+    {
+        std::lock_guard<std::mutex> lock(game_mutex);
+        if (state != GameState::IN_PROGRESS) return;
+        if (move.get_player_id() != current_player) {
+            premove = move;  // a newer premove replaces the queued one
+            return;
+        }
+    }
+    // the opponent already moved (the premove crossed NEXT_TURN), so it is an ordinary move
+    handle_move(move);
+}
+
+void QuoridorGame::play_move(const Move& move) {
+    int mover = current_player;
+    charge_clock(mover);
+    apply_move(move);
+    schedule_flag_fall();
+    Metrics::instance().moves.add();
+    if (Journal::instance().is_open()) {
+        JournalEvent event;
+        event.type = JournalEventType::MOVE;
+        event.player = static_cast<uint8_t>(mover);
+        const auto& cells = move.get_position();
+        if (!move.is_player_move()) {
+            event.flags = JOURNAL_MOVE_WALL | (move.get_is_horizontal() ? JOURNAL_MOVE_HORIZONTAL : 0);
+        }
+        for (size_t i = 0; i < cells.size() && i < 2; ++i) {
+            event.cells[2 * i] = static_cast<uint8_t>(cells[i].first);
+            event.cells[2 * i + 1] = static_cast<uint8_t>(cells[i].second);
+        }
+        journal_event(event);
+    }
+    publish_snapshot();
+}
+
+void QuoridorGame::handle_game_end(uint8_t reason) {
+    bool was_in_progress = (state == GameState::IN_PROGRESS);
     state = GameState::ENDED;
+    TimerService::instance().cancel(flag_timer);
+    if (reason == JOURNAL_END_TIMEOUT) clock_ms[current_player] = 0;
     int winner = (current_player == 0) ? 1 : 0;
+    if (was_in_progress) {
+        journal_player_event(JournalEventType::GAME_END, players[winner], reason);
+    }
+    publish_snapshot();
     notify_all_players(Message::create_game_ended(this, players[winner]));
+    finish_spectators();
     for (auto player : players) {
         player->is_connected = false;
         player->is_reconnecting = false;
         player->set_game_id(-1);
     }
+    if (was_in_progress) report_end();
+}
+
+std::shared_ptr<const GameSnapshot> QuoridorGame::get_snapshot() const {
+    return snapshot_slot->load();
+}
+
+std::shared_ptr<SnapshotSlot> QuoridorGame::get_snapshot_slot() const {
+    return snapshot_slot;
+}
+
+void QuoridorGame::publish_snapshot() {
+    MemoryScope memory(MemoryTag::GAME);
+    // published after every move, the snapshots (with their control blocks) are recycled by a pool
+    auto next = std::allocate_shared<GameSnapshot>(PoolAllocator<GameSnapshot>());
+    next->lobby_id = static_cast<uint32_t>(lobby_id);
+    next->journal_sequence = journal_sequence.load(std::memory_order_relaxed);
+    next->turn = turn;
+    next->variant = static_cast<uint8_t>(variant);
+    next->in_progress = (state == GameState::IN_PROGRESS);
+    next->current_player = static_cast<uint8_t>(current_player);
+    next->horizontal_count = static_cast<uint8_t>(std::min(horizontal_walls.size(), GameSnapshot::MAX_WALL_CELLS));
+    for (size_t i = 0; i < next->horizontal_count; ++i) {
+        next->horizontal_walls[i] = {horizontal_walls[i].first, horizontal_walls[i].second};
+    }
+    next->vertical_count = static_cast<uint8_t>(std::min(vertical_walls.size(), GameSnapshot::MAX_WALL_CELLS));
+    for (size_t i = 0; i < next->vertical_count; ++i) {
+        next->vertical_walls[i] = {vertical_walls[i].first, vertical_walls[i].second};
+    }
+    for (size_t i = 0; i < 2 && i < players.size(); ++i) {
+        next->players[i].name = players[i]->name;
+        next->players[i].row = static_cast<uint8_t>(players[i]->position.first);
+        next->players[i].col = static_cast<uint8_t>(players[i]->position.second);
+        next->players[i].walls_left = static_cast<uint8_t>(players[i]->get_walls_left());
+        next->players[i].clock_ms = static_cast<uint32_t>(clock_ms[i]);
+    }
+    snapshot_slot->store(std::move(next));
+}
+
+void QuoridorGame::restore(const GameSnapshot& snapshot, Player* player1, Player* player2) {
+    players = {player1, player2};
+    initialize_players();
+    for (size_t i = 0; i < 2; ++i) {
+        players[i]->set_name(snapshot.players[i].name);
+        players[i]->set_position({snapshot.players[i].row, snapshot.players[i].col});
+        players[i]->set_walls_left(snapshot.players[i].walls_left);
+    }
+    horizontal_walls.clear();
+    for (size_t i = 0; i < snapshot.horizontal_count; ++i) {
+        horizontal_walls.emplace_back(snapshot.horizontal_walls[i].first, snapshot.horizontal_walls[i].second);
+    }
+    vertical_walls.clear();
+    for (size_t i = 0; i < snapshot.vertical_count; ++i) {
+        vertical_walls.emplace_back(snapshot.vertical_walls[i].first, snapshot.vertical_walls[i].second);
+    }
+    lobby_id = snapshot.lobby_id;
+    journal_sequence = snapshot.journal_sequence;
+    turn = snapshot.turn;
+    current_player = snapshot.current_player;
+    for (size_t i = 0; i < 2; ++i) {
+        clock_ms[i] = snapshot.players[i].clock_ms;
+    }
+    load_rules_position();
+    initialize_board();
+    state = GameState::IN_PROGRESS;
+    // the turn restarts with the time left at its beginning, downtime of the server is not charged
+    turn_started = Clock::now();
+    schedule_flag_fall();
+    publish_snapshot();
+    latest_update = Message::create_next_turn(this).to_wire();
+}
+
+void QuoridorGame::start_replay(Player* player1, Player* player2) {
+    players = {player1, player2};
+    initialize_players();
+    initialize_board();
+    current_player = 0;
+    state = GameState::IN_PROGRESS;
+}
+
+bool QuoridorGame::replay_move(const Move& move) {
+    if (state != GameState::IN_PROGRESS || move.get_player_id() != current_player || !can_move(move)) {
+        return false;
+    }
+    apply_move(move);
+    if (check_game_end()) {
+        state = GameState::ENDED;
+    }
+    return true;
 }
 
-void QuoridorGame::apply_move(Move move) {
+void QuoridorGame::apply_move(const Move& move) {
     if (move.is_player_move()) {
         apply_player_move(move);
     } else {
+        const auto& cells = move.get_position();
+        std::visit([&](auto& position) {
+            using Engine = typename std::decay_t<decltype(position)>::Engine;
+            Engine::place_wall(position, current_player, move.get_is_horizontal(), cells[0], cells[1]);
+        }, rules_position);
         if (move.get_is_horizontal()) {
             horizontal_walls.push_back(move.get_position()[0]);
             horizontal_walls.push_back(move.get_position()[1]);
@@ -99,31 +321,32 @@ void QuoridorGame::apply_move(Move move) {
         players[current_player]->walls_left--;
     }
     current_player = (current_player + 1) % 2;
+    turn++;
 }
 
-void QuoridorGame::apply_player_move(Move move) {
+void QuoridorGame::apply_player_move(const Move& move) {
     // Get current player position
     int curr_row = players[current_player]->position.first;
     int curr_col = players[current_player]->position.second;
     
     // Get target position
-    std::pair<int, int> new_pos = move.get_position()[0];
-    
-    // Check if target square has another player
-    char target_square = board[new_pos.first][new_pos.second];
-    if (target_square == PLAYER_1_CELL || target_square == PLAYER_2_CELL) {
-        // Move the other player to their starting position
-        std::pair<int, int> reset_pos = std::make_pair(
-            (target_square == PLAYER_1_CELL) ? BOARD_SIZE - 1 : 0, 
-            BOARD_SIZE / 2
-        );
-        if (new_pos == reset_pos) reset_pos.second++;
-        players[target_square - '0' - 1]->set_position(reset_pos);
-        board[reset_pos.first][reset_pos.second] = target_square;
-    }
-    
+    const std::pair<int, int>& new_pos = move.get_position()[0];
+
+    // a pawn on the target square is sent back to its starting position by the rules engine
+    std::pair<int, int> bumped_pos;
+    int bumped = std::visit([&](auto& position) {
+        using Engine = typename std::decay_t<decltype(position)>::Engine;
+        int other = Engine::move_pawn(position, current_player, new_pos.first, new_pos.second);
+        if (other >= 0) bumped_pos = {position.pawns[other] / Engine::SIZE, position.pawns[other] % Engine::SIZE};
+        return other;
+    }, rules_position);
+
     // Clear current position
     board[curr_row][curr_col] = EMPTY_CELL;
+    if (bumped >= 0) {
+        players[bumped]->set_position(bumped_pos);
+        board[bumped_pos.first][bumped_pos.second] = PLAYER_1_CELL + bumped;
+    }
     
     // Move player to new position
     players[current_player]->set_position(new_pos);
@@ -131,26 +354,93 @@ void QuoridorGame::apply_player_move(Move move) {
 }
 
 void QuoridorGame::initialize_players() {
-    players[0]->set_position({BOARD_SIZE - 1, BOARD_SIZE / 2});
+    std::visit([this](const auto& position) {
+        using Engine = typename std::decay_t<decltype(position)>::Engine;
+        for (int i = 0; i < 2; ++i) {
+            players[i]->set_position(Engine::start(i));
+            players[i]->set_walls_left(Engine::WALLS_PER_PLAYER);
+        }
+    }, rules_position);
+
     players[0]->set_color("red");
     players[0]->set_id("1");
     players[0]->set_board_char(PLAYER_1_CELL);
     players[0]->set_goal_row(0);
-    players[0]->set_walls_left(10);
 
-    players[1]->set_position({0, BOARD_SIZE / 2});
     players[1]->set_color("blue");
     players[1]->set_id("2");
     players[1]->set_board_char(PLAYER_2_CELL);
-    players[1]->set_goal_row(BOARD_SIZE - 1);
-    players[1]->set_walls_left(10);
+    players[1]->set_goal_row(board_size - 1);
+    load_rules_position();
+}
+
+void QuoridorGame::load_rules_position() {
+    std::visit([this](auto& position) {
+        using Engine = typename std::decay_t<decltype(position)>::Engine;
+        position = Engine::initial();
+        // GameSnapshot::deserialize rejects cells outside the board, the check here keeps the engine safe anyway
+        for (const auto& cell : horizontal_walls) {
+            if (Engine::on_board(cell.first, cell.second)) position.wall_down.set(Engine::index(cell.first, cell.second));
+        }
+        for (const auto& cell : vertical_walls) {
+            if (Engine::on_board(cell.first, cell.second)) position.wall_right.set(Engine::index(cell.first, cell.second));
+        }
+        for (int i = 0; i < 2; ++i) {
+            const auto& cell = players[i]->position;
+            if (Engine::on_board(cell.first, cell.second)) position.pawns[i] = Engine::index(cell.first, cell.second);
+            position.walls_left[i] = static_cast<uint8_t>(std::max(0, players[i]->get_walls_left()));
+        }
+    }, rules_position);
 }
 
-void QuoridorGame::notify_all_players(Message message) {
+void QuoridorGame::notify_all_players(const Message& message) {
+    // serialized once, players and spectators share the same buffer
+    notify_all_players(message.to_wire(), message.get_type());
+}
+
+void QuoridorGame::notify_all_players(const WireBuffer& wire, MessageType type) {
     for (auto player : players) {
-        player->send_message(message);
+        player->send_wire(wire);
+    }
+    broadcast_to_spectators(wire, type);
+}
+
+void QuoridorGame::broadcast_to_spectators(const WireBuffer& wire, MessageType type) {
+    if (type != MessageType::NEXT_TURN && type != MessageType::GAME_ENDED) return;
+    std::lock_guard<std::mutex> lock(spectators_mutex);
+    if (type == MessageType::NEXT_TURN) {
+        latest_update = wire;
+    }
+    spectators.erase(std::remove_if(spectators.begin(), spectators.end(), [](const std::shared_ptr<Spectator>& spectator) {
+        return !spectator->is_open();
+    }), spectators.end());
+    for (const auto& spectator : spectators) {
+        spectator->publish(wire, type);
+    }
+}
+
+void QuoridorGame::finish_spectators() {
+    std::lock_guard<std::mutex> lock(spectators_mutex);
+    for (const auto& spectator : spectators) {
+        spectator->finish();
     }
-} 
+    spectators.clear();
+}
+
+bool QuoridorGame::add_spectator(std::shared_ptr<Spectator> spectator) {
+    std::lock_guard<std::mutex> lock(spectators_mutex);
+    if (state != GameState::IN_PROGRESS) return false;
+    if (latest_update) {
+        spectator->publish(latest_update, MessageType::NEXT_TURN);
+    }
+    spectators.push_back(std::move(spectator));
+    return true;
+}
+
+size_t QuoridorGame::spectator_count() {
+    std::lock_guard<std::mutex> lock(spectators_mutex);
+    return spectators.size();
+}
 
 size_t QuoridorGame::get_lobby_id() const {
     return lobby_id;
@@ -160,33 +450,116 @@ void QuoridorGame::set_lobby_id(size_t lobby_id) {
     this->lobby_id = lobby_id;
 }
 
+void QuoridorGame::set_reclaimer(GameReclaimer* reclaimer) {
+    this->reclaimer = reclaimer;
+}
+
+void QuoridorGame::acquire() {
+    references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void QuoridorGame::release() {
+    GameReclaimer* target = reclaimer;  // read before the count drops, the game may be deleted right after
+    if (references.fetch_sub(1, std::memory_order_acq_rel) == 1 && target) target->game_released();
+}
+
+int QuoridorGame::reference_count() const {
+    return references.load(std::memory_order_acquire);
+}
+
+void QuoridorGame::set_unconnected(const Player* player, bool unconnected) {
+    int index = player_index(player);
+    if (index >= 0) this->unconnected[index] = unconnected;
+}
+
+void QuoridorGame::delete_unconnected_players() {
+    // only the flags are read, the other players may already be deleted by their connection threads
+    for (size_t i = 0; i < players.size() && i < 2; ++i) {
+        if (unconnected[i]) {
+            delete players[i];
+            players[i] = nullptr;
+            unconnected[i] = false;
+        }
+    }
+}
+
+void QuoridorGame::report_end() {
+    if (reclaimer) reclaimer->game_ended(this);
+}
+
+void QuoridorGame::charge_clock(int mover) {
+    auto now = Clock::now();
+    int64_t spent = std::chrono::duration_cast<std::chrono::milliseconds>(now - turn_started).count();
+    clock_ms[mover] = std::max<int64_t>(0, clock_ms[mover] - spent) + get_clock_increment_ms();
+    turn_started = now;
+}
+
+void QuoridorGame::schedule_flag_fall() {
+    // the old deadline is only cancelled, a callback that already runs finds the clock reset and does nothing
+    TimerService::instance().cancel(flag_timer);
+    flag_timer = TimerService::instance().schedule(turn_started + std::chrono::milliseconds(clock_ms[current_player]),
+                                                   this, [this]() { handle_flag_fall(); });
+}
+
+bool QuoridorGame::is_flag_down() const {
+    return Clock::now() - turn_started >= std::chrono::milliseconds(clock_ms[current_player]);
+}
+
+void QuoridorGame::handle_flag_fall() {
+    std::lock_guard<std::mutex> lock(game_mutex);
+    if (state != GameState::IN_PROGRESS || !is_flag_down()) return;
+    Metrics::instance().flag_falls.add();
+    handle_game_end(JOURNAL_END_TIMEOUT);
+}
+
+int64_t QuoridorGame::get_clock_ms(int player_index) const {
+    if (player_index != current_player || state != GameState::IN_PROGRESS) return clock_ms[player_index];
+    int64_t spent = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - turn_started).count();
+    return std::max<int64_t>(0, clock_ms[player_index] - spent);
+}
+
 void QuoridorGame::send_next_turn() {
-    notify_all_players(Message::create_next_turn(this));
+    notify_all_players(Message::create_next_turn_wire(this), MessageType::NEXT_TURN);
 }
 
 std::string QuoridorGame::get_board_string() const {
     std::string board_string;
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            board_string += board[i][j];
-        }
-    }
+    board_string.reserve(board_size * board_size);
+    append_board_string(board_string);
     return board_string;
 }
 
+void QuoridorGame::append_board_string(std::string& out) const {
+    for (int i = 0; i < board_size; ++i) {
+        out.append(board[i], board_size);
+    }
+}
+
 int QuoridorGame::get_current_player() const {
     return current_player;
 }
 
+Variant QuoridorGame::get_variant() const {
+    return variant;
+}
+
+int QuoridorGame::get_board_size() const {
+    return board_size;
+}
+
+int64_t QuoridorGame::get_clock_increment_ms() const {
+    return variant_info(variant).clock_increment_ms;
+}
+
 void QuoridorGame::set_current_player(int current_player) {
     this->current_player = current_player;
 }
 
-std::vector<std::pair<int, int>> QuoridorGame::get_horizontal_walls() const {
+const std::vector<std::pair<int, int>>& QuoridorGame::get_horizontal_walls() const {
     return horizontal_walls;
 }
 
-std::vector<std::pair<int, int>> QuoridorGame::get_vertical_walls() const {
+const std::vector<std::pair<int, int>>& QuoridorGame::get_vertical_walls() const {
     return vertical_walls;
 }
 
@@ -198,7 +571,7 @@ void QuoridorGame::set_vertical_walls(const std::vector<std::pair<int, int>>& ve
     this->vertical_walls = vertical_walls;
 }
 
-std::vector<Player*> QuoridorGame::get_players() const {
+const std::vector<Player*>& QuoridorGame::get_players() const {
     return players;
 }
 
@@ -216,188 +589,47 @@ bool QuoridorGame::check_game_end() {
     return false;
 }
 
-bool QuoridorGame::can_move(Move move) {
+bool QuoridorGame::can_move(const Move& move) {
+    PROFILE_ZONE("can_move");
     if (!move.get_is_valid_structure()) return false;
 
     if (move.is_player_move() && QuoridorGame::is_valid_player_move(move)) {
         return true;
-    } else if (!move.is_player_move() && QuoridorGame::is_valid_wall_move(move)) {
-        return true;
-    }
-    return false;
-}
-
-bool QuoridorGame::is_valid_player_move(Move move) {
-    std::pair<int, int> new_pos = move.get_position()[0];
-    int curr_row = -1, curr_col = -1;
-
-    // check if move isnt out of bounds
-    if (new_pos.first < 0 || new_pos.first >= BOARD_SIZE || new_pos.second < 0 || new_pos.second >= BOARD_SIZE) return false;
-    
-    // Find current player position on board
-    for (int i = 0; i < BOARD_SIZE; i++) {
-        for (int j = 0; j < BOARD_SIZE; j++) {
-            if (board[i][j] == ('0' + current_player + 1)) {
-                curr_row = i;
-                curr_col = j;
-                break;
-            }
-        }
-        if (curr_row != -1) break;
-    }
-    if (curr_row == -1 || curr_col == -1) return false;
-
-    // Check if move is exactly 1 square away (no diagonals)
-    int row_diff = std::abs(new_pos.first - curr_row);
-    int col_diff = std::abs(new_pos.second - curr_col);
-
-
-    if (((row_diff == 1 && col_diff == 0) || (row_diff == 0 && col_diff == 1)) && !is_wall_between(curr_row, curr_col, new_pos.first, new_pos.second)) {
-        return true;
-    }
-    return false;
-}
-
-// bug here in situation where wall is under the player player cannot move to his right 
-// if player is on 0, 0 and wall is under him (meaning wall is 00 and 01 but horizontal) he cannot move to 0, 1
-bool QuoridorGame::is_wall_between(int row1, int col1, int row2, int col2) {
-    // horizontal movement
-    bool vertical_blocked = false;
-    if (row1 == row2) {
-        int wall_row = row1;
-        int wall_col = std::min(col1, col2);
-        vertical_blocked = std::find(vertical_walls.begin(), vertical_walls.end(), std::make_pair(wall_row, wall_col)) != vertical_walls.end();
-    }
-    // vertical movement
-    bool horizontal_blocked = false;
-    if (col1 == col2) {
-        int wall_col = col1; 
-        int wall_row = std::min(row1, row2);
-        horizontal_blocked = std::find(horizontal_walls.begin(), horizontal_walls.end(), std::make_pair(wall_row, wall_col)) != horizontal_walls.end();
-    }
-    return vertical_blocked || horizontal_blocked;
-}
-
-bool QuoridorGame::is_valid_wall_move(Move move) {
-    std::pair<int, int> wall_1 = move.get_position()[0];
-    std::pair<int, int> wall_2 = move.get_position()[1];
-
-    // check if player has wall left
-    if (players[current_player]->get_walls_left() <= 0) return false;
-
-    // check if wall is placed next to each other
-    if (move.get_is_horizontal() && (wall_1.first != wall_2.first || std::abs(wall_1.second - wall_2.second) != 1)) return false;
-    if (!move.get_is_horizontal() && (wall_1.second != wall_2.second || std::abs(wall_1.first - wall_2.first) != 1)) return false;
-
-    // check if wall is already placed - if wall conntains the same pair of points
-    if (move.get_is_horizontal()) {
-        if (std::find(horizontal_walls.begin(), horizontal_walls.end(), std::make_pair(wall_1.first, wall_1.second)) != horizontal_walls.end() ||
-            std::find(horizontal_walls.begin(), horizontal_walls.end(), std::make_pair(wall_2.first, wall_2.second)) != horizontal_walls.end()) {
-            return false;
-        }
-    } else {
-        if (std::find(vertical_walls.begin(), vertical_walls.end(), std::make_pair(wall_1.first, wall_1.second)) != vertical_walls.end() ||
-            std::find(vertical_walls.begin(), vertical_walls.end(), std::make_pair(wall_2.first, wall_2.second)) != vertical_walls.end()) {
-            return false;
-        }
-    }
-
-    // check if player is blocked comepletely -> if there is no path to the other side of the board (forbidden by rules)
-    if (QuoridorGame::is_blocked(move)) return false;
-
-    return true;
-}
-
-bool QuoridorGame::is_blocked(Move move) {
-    // Save current player
-    int saved_player = current_player;
-    
-    apply_move(move);
-    for (auto player : players) {
-        if(!QuoridorGame::bfs(player)) {
-            current_player = saved_player;
-            remove_move(move);
-            return true;
-        }
+    } else if (!move.is_player_move()) {
+        ScopedTimer timer(Metrics::instance().wall_validation_ns);
+        return QuoridorGame::is_valid_wall_move(move);
     }
-    current_player = saved_player;
-    remove_move(move);
     return false;
 }
 
-// bfs for purpose of checking if player is blocked
-bool QuoridorGame::bfs(Player* player) {
-    // Store original position
-    std::pair<int, int> original_pos = player->position;
-    
-    // Create visited array and queue for BFS
-    bool visited[BOARD_SIZE][BOARD_SIZE] = {false};
-    std::queue<std::pair<int, int>> queue;
-    
-    // Start BFS from current position
-    queue.push(player->position);
-    visited[player->position.first][player->position.second] = true;
-    
-    // Possible moves: up, right, down, left
-    const int dx[] = {-1, 0, 1, 0};
-    const int dy[] = {0, 1, 0, -1};
-    
-    while (!queue.empty()) {
-        auto current = queue.front();
-        queue.pop();
-        
-        // If we reached the goal row
-        if (current.first == player->get_goal_row()) {
-            // Reset position and return success
-            player->position = original_pos;
-            return true;
-        }
-        
-        // Try all four directions
-        for (int i = 0; i < 4; i++) {
-            int new_x = current.first + dx[i];
-            int new_y = current.second + dy[i];
-            
-            // Check if new position is within bounds
-            if (new_x < 0 || new_x >= BOARD_SIZE || new_y < 0 || new_y >= BOARD_SIZE) {
-                continue;
-            }
-            
-            // Check if already visited
-            if (visited[new_x][new_y]) {
-                continue;
-            }
-            
-            // Check if there's a wall blocking the move
-            if (is_wall_between(current.first, current.second, new_x, new_y)) {
-                continue;
-            }
-            
-            // Valid move found, add to queue
-            queue.push({new_x, new_y});
-            visited[new_x][new_y] = true;
-        }
-    }
-    
-    // Reset position and return failure - no path found
-    player->position = original_pos;
-    return false;
+bool QuoridorGame::is_valid_player_move(const Move& move) {
+    // one step of the current player that no wall blocks (bounds are checked by the rules engine)
+    const std::pair<int, int>& new_pos = move.get_position()[0];
+    return std::visit([&](const auto& position) {
+        using Engine = typename std::decay_t<decltype(position)>::Engine;
+        return Engine::is_valid_step(position, current_player, new_pos.first, new_pos.second);
+    }, rules_position);
 }
 
-void QuoridorGame::remove_move(Move move) {
-    if (move.get_is_horizontal()) {
-        horizontal_walls.erase(std::find(horizontal_walls.begin(), horizontal_walls.end(), move.get_position()[0]));
-        horizontal_walls.erase(std::find(horizontal_walls.begin(), horizontal_walls.end(), move.get_position()[1]));
-    } else {
-        vertical_walls.erase(std::find(vertical_walls.begin(), vertical_walls.end(), move.get_position()[0]));
-        vertical_walls.erase(std::find(vertical_walls.begin(), vertical_walls.end(), move.get_position()[1]));
-    }
-    
-    players[current_player]->walls_left++;
+bool QuoridorGame::is_valid_wall_move(const Move& move) {
+    PROFILE_ZONE("is_valid_wall_move");
+    const auto& cells = move.get_position();
+    if (cells.size() != 2) return false;
+    // walls left, adjacent cells on the board, no overlap and no player blocked completely (forbidden by rules)
+    return std::visit([&](const auto& position) {
+        using Engine = typename std::decay_t<decltype(position)>::Engine;
+        return Engine::is_valid_wall(position, current_player, move.get_is_horizontal(), cells[0], cells[1]);
+    }, rules_position);
 }
 
 void QuoridorGame::handle_player_disconnection(Player* player) {
     std::lock_guard<std::mutex> lock(game_mutex);
+    // an ended game already notified everyone, its players may be gone
+    if (state != GameState::IN_PROGRESS) return;
+    journal_player_event(JournalEventType::DISCONNECT, player, JOURNAL_DISCONNECT_PERMANENT);
+    for (auto p : players) {
+        if (p != player) journal_player_event(JournalEventType::GAME_END, p, JOURNAL_END_DISCONNECT);
+    }
     
     // Notify remaining player about opponent permanent disconnection
     for (auto p : players) {
@@ -405,27 +637,67 @@ void QuoridorGame::handle_player_disconnection(Player* player) {
             p->send_message(Message::create_game_ended(this, p));
         }
     }
+    for (auto p : players) {
+        if (p != player) broadcast_to_spectators(Message::create_game_ended(this, p).to_wire(), MessageType::GAME_ENDED);
+    }
     
     // Set game state to ended
     state = GameState::ENDED;
+    TimerService::instance().cancel(flag_timer);
+    publish_snapshot();
+    finish_spectators();
+    // the connection threads delete their players like after a normal game end
+    for (auto p : players) {
+        p->set_game_id(-1);
+    }
+    report_end();
+}
+
+bool QuoridorGame::force_end() {
+    std::lock_guard<std::mutex> lock(game_mutex);
+    if (state != GameState::IN_PROGRESS) return false;
+    journal_player_event(JournalEventType::GAME_END, players[0], JOURNAL_END_OPERATOR);
+    state = GameState::ENDED;
+    TimerService::instance().cancel(flag_timer);
+    publish_snapshot();
+    // there is no winner, players get an error and their connections are closed like after a normal game end
+    notify_all_players(Message::create_error("Game was ended by the server"));
+    finish_spectators();
+    for (auto player : players) {
+        player->is_connected = false;
+        player->is_reconnecting = false;
+        player->set_game_id(-1);
+    }
+    report_end();
+    return true;
 }
 
 void QuoridorGame::check_player_connections() {
     for (auto player : players) {
-        auto now = std::chrono::steady_clock::now();
+        auto now = Clock::now();
         auto duration = std::chrono::duration_cast<std::chrono::seconds>(
             now - player->last_heartbeat).count();
-        
+
+        // messages of the client already prove it alive, heartbeats only fill its quiet periods
+        if (player->is_connected && !player->is_reconnecting && player->heartbeat_due()) {
+            player->send_heartbeat();
+        }
+
         if (player->is_reconnecting && player->check_connection()) {
             player->is_connected = true;
             player->is_reconnecting = false;
+            Metrics::instance().reconnections.add();
+            journal_player_event(JournalEventType::RECONNECT, player, 0);
             notify_all_players(Message::create_player_reconnected(player));
             player->send_message(Message::create_next_turn(this));
             continue;
         }
 
-        if (player->is_connected && duration >= Player::NORMAL_HEARTBEAT_TIMEOUT && !player->is_reconnecting) {
+        // the timeout adapts to the link: phi-accrual suspicion instead of a fixed NORMAL_HEARTBEAT_TIMEOUT
+        if (player->is_connected && !player->is_reconnecting && !player->check_connection()) {
             player->is_reconnecting = true;
+            Metrics::instance().heartbeat_timeouts.add();
+            journal_player_event(JournalEventType::DISCONNECT, player, 0);
             // Notify other players about temporary disconnection
             for (auto p : players) {
                 if (p != player && p->is_connected) {
@@ -438,6 +710,7 @@ void QuoridorGame::check_player_connections() {
         if (player->is_reconnecting && 
             duration >= Player::RECONNECTION_HEARTBEAT_TIMEOUT) {
             player->is_connected = false;
+            Metrics::instance().disconnections.add();
             handle_player_disconnection(player);
             return;
         }
@@ -445,14 +718,40 @@ void QuoridorGame::check_player_connections() {
 }
 
 void QuoridorGame::start_heartbeat_checker() {
+    acquire();  // the checker sleeps between its checks, the game must outlive the last one
     std::thread([this]() {
         while (state == GameState::IN_PROGRESS) {
             check_player_connections();
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+            Clock::sleep_for(std::chrono::seconds(1));
         }
+        release();
     }).detach();
 }
 
 GameState QuoridorGame::get_state() const {
     return state;
-}
\ No newline at end of file
+}
+
+void QuoridorGame::journal_event(JournalEvent& event) {
+    event.game_id = static_cast<uint32_t>(lobby_id);
+    event.sequence = journal_sequence.fetch_add(1, std::memory_order_relaxed);
+    event.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    Journal::instance().record(event);
+}
+
+void QuoridorGame::journal_player_event(JournalEventType type, Player* player, uint8_t flags) {
+    if (!Journal::instance().is_open()) return;
+    JournalEvent event;
+    event.type = type;
+    event.player = static_cast<uint8_t>(player_index(player));
+    event.flags = flags;
+    journal_event(event);
+}
+
+int QuoridorGame::player_index(const Player* player) const {
+    for (size_t i = 0; i < players.size(); ++i) {
+        if (players[i] == player) return static_cast<int>(i);
+    }
+    return -1;
+}
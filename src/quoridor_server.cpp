@@ -1,7 +1,10 @@
 #include "quoridor_server.h"
-#include <iostream>
+#include "logger.h"
 #include <thread>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <unistd.h>
 #include <netinet/tcp.h>
@@ -9,20 +12,228 @@
 #include "move.h"
 #include "quoridor_game.h"
 #include "player.h"
+#include "memory_accounting.h"
+#include "metrics.h"
+#include "profiler.h"
+#include "clock.h"
+#include "journal.h"
+#include "game_snapshot.h"
+#include "fd_channel.h"
+#include "rate_limiter.h"
+#include "worker_pool.h"
+#include "analysis.h"
 #include <fstream>
 #include <arpa/inet.h>
 #include <sstream>
 #include <cstring>
 #include <algorithm>
 
-QuoridorServer::QuoridorServer() : game_id_counter(0) {
-    server_socket = socket(AF_INET, SOCK_STREAM, 0);
+namespace {
+template <typename T>
+void put(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+bool get(const char*& in, const char* end, T& value) {
+    if (static_cast<size_t>(end - in) < sizeof(T)) return false;
+    memcpy(&value, in, sizeof(T));
+    in += sizeof(T);
+    return true;
+}
+}
+
+QuoridorServer::QuoridorServer() : game_id_counter(0), view(std::make_shared<ServerView>()) {
+    reclaimer = std::make_unique<GameReclaimer>([this](QuoridorGame* game) { remove_game(game); });
+    server_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (server_socket < 0) {
         throw std::runtime_error("Failed to create socket");
     }
 }
 
 void QuoridorServer::start(int port) {
+    port = open_listener();
+    setup_admin_server(port);
+    // games are still played without a journal, they are just not recorded
+    Journal::instance().open(journal_directory);
+    restore_games();
+    load_analysis_files();
+    reclaimer->start();
+    lag_monitor.start();
+    start_snapshot_writer();
+    start_handoff_listener(port);
+    accept_loop();
+}
+
+void QuoridorServer::takeover(int port) {
+    std::string path = handoff_socket_path(port);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int channel = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (channel < 0 || connect(channel, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        LOG_WARNING(LogFields(), "No server to take over on %s, starting normally", path.c_str());
+        if (channel >= 0) close(channel);
+        start(port);
+        return;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    LOG_INFO(LogFields(), "Taking over the server on port %d...", port);
+    std::string state;
+    std::vector<int> fds;
+    bool received = FdChannel::receive(channel, state, fds);
+    close(channel);
+    if (!received || fds.empty()) {
+        // the old process writes a snapshot and exits when the handoff fails, so a normal start restores the games
+        LOG_ERROR(LogFields(), "Hot restart failed, starting normally");
+        for (int fd : fds) close(fd);
+        Clock::sleep_for(std::chrono::seconds(1));
+        start(port);
+        return;
+    }
+
+    close(server_socket);
+    server_socket = fds[0];
+    setup_admin_server(port);
+    Journal::instance().open(journal_directory);
+    if (!resume_handoff(state, fds)) {
+        LOG_ERROR(LogFields(), "Hot restart state is malformed, connections that were not resumed are closed");
+    }
+    load_analysis_files();
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+    LOG_INFO(LogFields(), "Took over %zu games and %zu connections in %.2f ms", active_games.size(), fds.size() - 1,
+             elapsed_ms);
+    reclaimer->start();
+    lag_monitor.start();
+    start_snapshot_writer();
+    start_handoff_listener(port);
+    accept_loop();
+}
+
+void QuoridorServer::start_front_end(int port, size_t workers) {
+    port = open_listener();
+    // games, their journal and snapshots belong to the workers, the front-end only holds waiting players
+    worker_pool = std::make_unique<WorkerPool>(workers, MAX_GAMES);
+    worker_pool->start();
+    setup_admin_server(port);
+    lag_monitor.start();
+    accept_loop();
+}
+
+void QuoridorServer::run_worker(size_t index, int channel) {
+    close(server_socket);  // clients arrive over the channel
+    server_socket = -1;
+    front_end_channel = channel;
+    journal_directory = "journal_worker" + std::to_string(index);
+    snapshot_file = "games.worker" + std::to_string(index) + ".snapshot";
+    LOG_INFO(LogFields(), "Game worker %zu started (pid %d)", index, getpid());
+    Journal::instance().open(journal_directory);
+    restore_games();
+    load_analysis_files();
+    reclaimer->start();
+    start_snapshot_writer();
+    start_status_reporter();
+
+    std::string record;
+    std::vector<int> fds;
+    while (FdChannel::receive(channel, record, fds)) {
+        handle_front_end_record(WorkerPool::decode(record), fds);
+    }
+    // without the front-end nobody can reconnect to these games, the next worker restores them from the snapshot
+    LOG_WARNING(LogFields(), "Front-end closed the channel, game worker %zu exits", index);
+    write_snapshot();
+    Journal::instance().flush();
+    Logger::instance().flush();
+    _exit(0);
+}
+
+void QuoridorServer::handle_front_end_record(const std::vector<std::string>& fields, const std::vector<int>& fds) {
+    auto new_player = [&](int fd, const std::string& name) {
+        auto transport = std::make_shared<SocketTransport>(fd);
+        setup_socket_timeout(*transport);
+        Player* player = new Player(std::move(transport));
+        player->set_name(name);
+        player->update_heartbeat();
+        return player;
+    };
+
+    // a malformed record is dropped, it must not take the worker and its games down
+    const std::string type = fields.empty() ? std::string() : fields[0];
+    Variant variant = Variant::STANDARD;
+    size_t lobby_id = 0;
+    bool match = type == "match" && fields.size() == 5 && fds.size() == 2 && parse_variant(fields[4], variant);
+    if (match) {
+        try {
+            lobby_id = std::stoul(fields[1]);
+        } catch (const std::exception&) {
+            match = false;
+        }
+    }
+    if (match) {
+        Player* players[2] = {new_player(fds[0], fields[2]), new_player(fds[1], fields[3])};
+        players[0]->variant = players[1]->variant = variant;
+        {
+            std::lock_guard<std::mutex> lock(server_mutex);
+            game_id_counter = std::max(game_id_counter, lobby_id);
+            create_game(players[0], players[1], lobby_id);
+            publish_lobby_view();
+        }
+        LOG_INFO(LogFields(lobby_id, ""), "Game received from the front-end");
+        for (Player* player : players) {
+            open_connections.fetch_add(1);
+            std::thread(&QuoridorServer::handle_client, this, player->get_transport(), player).detach();
+        }
+    } else if (type == "reconnect" && fields.size() == 2 && fds.size() == 1) {
+        Player* player = new_player(fds[0], fields[1]);
+        auto transport = player->get_transport();
+        Player* existing_player = find_disconnected_player(player->name);
+        if (existing_player && handle_player_reconnection(player, existing_player)) {
+            open_connections.fetch_add(1);
+            std::thread(&QuoridorServer::handle_client, this, transport, existing_player).detach();
+            return;
+        }
+        // the game ended (or was lost with the previous worker), the client connects again and is matched
+        player->send_message(Message::create_error("Game not found"));
+        transport->close_transport();
+        report_to_front_end({"forget", player->name});
+        delete player;
+    } else {
+        LOG_ERROR(LogFields(), "Malformed record from the front-end (%s), dropped", type.c_str());
+        for (int fd : fds) close(fd);
+    }
+}
+
+void QuoridorServer::report_to_front_end(const std::vector<std::string>& fields) {
+    std::lock_guard<std::mutex> lock(front_end_mutex);
+    FdChannel::send(front_end_channel, WorkerPool::encode(fields), {});
+}
+
+void QuoridorServer::start_status_reporter() {
+    std::thread([this]() {
+        while (running) {
+            // players of the running games let a new front-end (or a restarted worker) route reconnections again
+            std::vector<std::string> players{"players"};
+            size_t games;
+            {
+                std::lock_guard<std::mutex> lock(server_mutex);
+                games = active_games.size();
+                for (const auto& game_pair : active_games) {
+                    if (game_pair.second->get_state() != GameState::IN_PROGRESS) continue;
+                    for (Player* player : game_pair.second->get_players()) {
+                        players.push_back(std::to_string(game_pair.first));
+                        players.push_back(player->name);
+                    }
+                }
+            }
+            report_to_front_end({"status", std::to_string(games), Metrics::instance().snapshot()});
+            report_to_front_end(players);
+            Clock::sleep_for(std::chrono::seconds(WorkerPool::STATUS_INTERVAL_SECONDS));
+        }
+    }).detach();
+}
+
+int QuoridorServer::open_listener() {
     sockaddr_in server_addr{};
     server_addr.sin_family = AF_INET;
     // read address from ../connection_settings.txt
@@ -35,90 +246,567 @@ void QuoridorServer::start(int port) {
     std::getline(settings_file, address);
     std::string port_str;
     std::getline(settings_file, port_str);
-    port = std::stoi(port_str);
+    int port = std::stoi(port_str);
 
     if (port < 0 || port > 65535) {
         throw std::runtime_error("Invalid port number in connection settings: " + port_str);
     }
 
-    std::cout << "Starting server on port " << port << "..." << std::endl;
+    LOG_INFO(LogFields(), "Starting server on port %d...", port);
     if (inet_pton(AF_INET, address.c_str(), &server_addr.sin_addr) <= 0) {
         throw std::runtime_error("Invalid IP address format in connection settings: " + address);
     }
     server_addr.sin_port = htons(port);
 
+    // a restarted server must be able to bind while connections of the previous process are in TIME_WAIT
+    int reuse = 1;
+    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0) {
+        LOG_WARNING(LogFields(), "Failed to set SO_REUSEADDR");
+    }
+
     if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
         throw std::runtime_error("Failed to bind socket");
     }
 
     listen(server_socket, 5);
-    std::cout << "Server started on port " << port << std::endl;
-
-    start_game_cleaner();
+    LOG_INFO(LogFields(), "Server started on port %d", port);
+    return port;
+}
 
+void QuoridorServer::accept_loop() {
     while (true) {
+        // accept is polled so a draining server stops accepting, pending connections stay queued for the new process
+        if (draining) {
+            Clock::sleep_for(std::chrono::milliseconds(250));
+            continue;
+        }
+        pollfd listener{server_socket, POLLIN, 0};
+        if (poll(&listener, 1, 250) <= 0) continue;
         sockaddr_in client_addr{};
         socklen_t client_len = sizeof(client_addr);
-        int client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
+        // close-on-exec, a game worker started later must not hold the connections of the front-end
+        int client_socket = accept4(server_socket, (struct sockaddr*)&client_addr, &client_len, SOCK_CLOEXEC);
         
         if (client_socket < 0) {
-            std::cerr << "Failed to accept connection" << std::endl;
+            LOG_ERROR(LogFields(), "Failed to accept connection");
             continue;
         }
 
-        std::cout << "New connection accepted" << std::endl;
+        LOG_INFO(LogFields(), "New connection accepted");
+        Metrics::instance().connections_accepted.add();
         int flag = 1;
         if (setsockopt(client_socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag)) < 0) {
-            std::cerr << "Failed to set TCP_NODELAY" << std::endl;
+            LOG_ERROR(LogFields(), "Failed to set TCP_NODELAY");
             close(client_socket);
             continue;
         }
-        std::thread client_thread(&QuoridorServer::handle_client, this, client_socket);
-        client_thread.detach();
+        auto transport = std::make_shared<SocketTransport>(client_socket);
+        uint32_t address = client_addr.sin_addr.s_addr;
+        bool loopback = (ntohl(address) >> 24) == 127;
+        if (!loopback && !address_limiter.try_acquire(address, Clock::now())) {
+            reject_connection(*transport, "Too many connections");
+            continue;
+        }
+        accept_transport(std::move(transport));
     }
 }
 
-void QuoridorServer::start_game_cleaner() {
+void QuoridorServer::start_in_process() {
+    reclaimer->start();
+}
+
+void QuoridorServer::reject_connection(Transport& transport, const char* reason) {
+    Metrics::instance().connections_rejected.add();
+    WireBuffer error = Message::create_error(reason).to_wire();
+    transport.send_bytes(error->c_str(), error->size() + 1);
+    transport.close_transport();
+}
+
+void QuoridorServer::accept_transport(std::shared_ptr<Transport> transport) {
+    // admission is decided before a player or a thread exists, so a flood costs one send per connection
+    if (lag_monitor.is_overloaded()) {
+        reject_connection(*transport, "Server is busy");
+        return;
+    }
+    if (open_connections.fetch_add(1) >= MAX_CONNECTIONS) {
+        open_connections.fetch_sub(1);
+        reject_connection(*transport, "Server is full");
+        return;
+    }
+    std::thread client_thread(&QuoridorServer::handle_client, this, std::move(transport), nullptr);
+    client_thread.detach();
+}
+
+void QuoridorServer::restore_games() {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<GameSnapshot> snapshots;
+    if (!SnapshotFile::read(snapshot_file, snapshots)) {
+        return;  // no snapshot (first start) or damaged file, nothing to restore
+    }
+
+    std::lock_guard<std::mutex> lock(server_mutex);
+    const std::shared_ptr<Transport> no_transports[2];
+    for (const GameSnapshot& snapshot : snapshots) {
+        restore_game(snapshot, no_transports);
+    }
+    Metrics::instance().active_games.set(active_games.size());
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOG_INFO(LogFields(), "Restored %zu games from %s in %.2f ms", snapshots.size(), snapshot_file.c_str(), elapsed_ms);
+}
+
+QuoridorGame* QuoridorServer::restore_game(const GameSnapshot& snapshot, const std::shared_ptr<Transport> transports[2]) {
+    if (active_games.count(snapshot.lobby_id) != 0) return nullptr;
+    MemoryScope memory(MemoryTag::GAME);
+    Player* player1 = new Player(transports[0]);
+    Player* player2 = new Player(transports[1]);
+    QuoridorGame* game = new QuoridorGame(static_cast<Variant>(snapshot.variant));
+    game->set_reclaimer(reclaimer.get());
+    game->restore(snapshot, player1, player2);
+    // nobody else deletes a player that never reconnects, the reclaimer does it with the game
+    game->set_unconnected(player1, !transports[0]);
+    game->set_unconnected(player2, !transports[1]);
+    for (Player* player : {player1, player2}) {
+        player->set_game_id(snapshot.lobby_id);
+        // players get the normal heartbeat timeout and then the reconnection window to come back
+        player->update_heartbeat();
+        player->is_reconnecting = false;
+    }
+    active_games[snapshot.lobby_id] = game;
+    game_id_counter = std::max<size_t>(game_id_counter, snapshot.lobby_id);
+    game->start_heartbeat_checker();
+    publish_lobby_view();
+    return game;
+}
+
+void QuoridorServer::start_snapshot_writer() {
     std::thread([this]() {
         while (running) {
-            std::this_thread::sleep_for(std::chrono::seconds(10));
-            cleanup_finished_games();
+            Clock::sleep_for(std::chrono::seconds(SNAPSHOT_INTERVAL_SECONDS));
+            if (!draining) write_snapshot();  // the new process owns the snapshot file
+        }
+    }).detach();
+}
+
+void QuoridorServer::write_snapshot() {
+    // only the published snapshots are copied under the lock, games keep playing while the file is written
+    std::vector<std::shared_ptr<const GameSnapshot>> snapshots;
+    {
+        std::lock_guard<std::mutex> lock(server_mutex);
+        snapshots.reserve(active_games.size());
+        for (const auto& game_pair : active_games) {
+            if (game_pair.second->get_state() != GameState::IN_PROGRESS) continue;
+            if (auto snapshot = game_pair.second->get_snapshot()) {
+                snapshots.push_back(std::move(snapshot));
+            }
+        }
+    }
+    if (!SnapshotFile::write(snapshot_file, snapshots)) {
+        LOG_ERROR(LogFields(), "Failed to write game snapshot %s: %s", snapshot_file.c_str(), strerror(errno));
+    }
+}
+
+std::string QuoridorServer::handoff_socket_path(int port) {
+    return "/tmp/quoridor_handoff_" + std::to_string(port) + ".sock";
+}
+
+void QuoridorServer::start_handoff_listener(int port) {
+    std::string path = handoff_socket_path(port);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listener < 0) {
+        LOG_ERROR(LogFields(), "Failed to create handoff socket");
+        return;
+    }
+    unlink(path.c_str()); // left by the previous process
+    // whoever connects gets every client connection, only the user running the server may (checked again on accept)
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 || chmod(path.c_str(), 0600) < 0 ||
+        listen(listener, 1) < 0) {
+        // server keeps running, it just cannot be restarted without dropping connections
+        LOG_ERROR(LogFields(), "Failed to bind handoff socket %s: %s", path.c_str(), strerror(errno));
+        close(listener);
+        return;
+    }
+
+    std::thread([this, listener]() {
+        while (true) {
+            int channel = accept(listener, nullptr, nullptr);
+            if (channel < 0) continue;
+            ucred peer{};
+            socklen_t length = sizeof(peer);
+            if (getsockopt(channel, SOL_SOCKET, SO_PEERCRED, &peer, &length) < 0 || peer.uid != geteuid()) {
+                LOG_WARNING(LogFields(), "Handoff request from pid %d of uid %u refused", peer.pid, peer.uid);
+                close(channel);
+                continue;
+            }
+            hand_off(channel);
         }
     }).detach();
 }
 
-void QuoridorServer::cleanup_finished_games() {
+void QuoridorServer::hand_off(int channel) {
+    auto begin = std::chrono::steady_clock::now();
+    LOG_INFO(LogFields(), "New process is taking over, draining client threads");
+    draining = true;
+
+    // client threads stop within their receive timeout, a game stalls at most that long
+    auto deadline = begin + std::chrono::seconds(HANDOFF_DRAIN_TIMEOUT_SECONDS);
+    while (true) {
+        size_t remaining;
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            remaining = client_connections.size();
+        }
+        if (remaining == 0) break;
+        if (std::chrono::steady_clock::now() > deadline) {
+            LOG_WARNING(LogFields(), "%zu client threads did not stop, handing over anyway", remaining);
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    // state: [version][game id counter][game count]([snapshot][connected flags])*[waiting count]([variant][name])*
+    // fds: listening socket first, then the connections in the order their players appear in the state
+    std::string state;
+    std::vector<int> fds{server_socket};
+    size_t games = 0;
+    put<uint32_t>(state, HANDOFF_VERSION);
+    {
+        std::lock_guard<std::mutex> lock(server_mutex);
+        put<uint32_t>(state, static_cast<uint32_t>(game_id_counter));
+        std::string games_state;
+        for (const auto& game_pair : active_games) {
+            QuoridorGame* game = game_pair.second;
+            auto snapshot = game->get_snapshot();
+            if (game->get_state() != GameState::IN_PROGRESS || !snapshot) continue;
+            snapshot->serialize(games_state);
+            for (Player* player : game->get_players()) {
+                auto transport = player->get_transport();
+                int fd = player->is_connected && !player->is_reconnecting && transport ? transport->get_fd() : -1;
+                put<uint8_t>(games_state, fd >= 0);
+                if (fd >= 0) fds.push_back(fd);
+            }
+            ++games;
+        }
+        put<uint32_t>(state, static_cast<uint32_t>(games));
+        state += games_state;
+
+        std::string waiting_state;
+        uint32_t waiting = 0;
+        for (Player* player : waiting_players) {
+            auto transport = player->get_transport();
+            if (!player->is_connected || !transport || transport->get_fd() < 0) continue;
+            uint8_t length = static_cast<uint8_t>(std::min<size_t>(player->name.size(), 255));
+            put<uint8_t>(waiting_state, static_cast<uint8_t>(player->variant));
+            put<uint8_t>(waiting_state, length);
+            waiting_state.append(player->name.data(), length);
+            fds.push_back(transport->get_fd());
+            ++waiting;
+        }
+        put<uint32_t>(state, waiting);
+        state += waiting_state;
+    }
+
+    // the new process starts a new journal segment, everything of this process has to be written first
+    Journal::instance().flush();
+    if (FdChannel::send(channel, state, fds)) {
+        double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        LOG_INFO(LogFields(), "Handed %zu games and %zu connections over in %.2f ms", games, fds.size() - 1, elapsed_ms);
+        Logger::instance().flush();
+        _exit(0);  // no destructors, connections must stay open for the new process
+    }
+    // client threads are gone, the new process restores the games from the snapshot and players reconnect
+    LOG_ERROR(LogFields(), "Hot restart handoff failed: %s", strerror(errno));
+    write_snapshot();
+    Logger::instance().flush();
+    _exit(1);
+}
+
+bool QuoridorServer::resume_handoff(const std::string& state, const std::vector<int>& fds) {
+    const char* cursor = state.data();
+    const char* end = state.data() + state.size();
+    size_t next_fd = 1;
+    auto take_transport = [&]() -> std::shared_ptr<Transport> {
+        if (next_fd >= fds.size()) return nullptr;
+        return std::make_shared<SocketTransport>(fds[next_fd++]);
+    };
+    std::vector<std::pair<Player*, std::shared_ptr<Transport>>> resumed;
+    bool valid = true;
+
+    uint32_t version = 0, counter = 0, games = 0, waiting = 0;
+    {
+        std::lock_guard<std::mutex> lock(server_mutex);
+        if (!get(cursor, end, version) || version != HANDOFF_VERSION || !get(cursor, end, counter) ||
+            !get(cursor, end, games)) {
+            valid = false;
+            games = 0;
+        }
+        game_id_counter = std::max<size_t>(game_id_counter, counter);
+        for (uint32_t i = 0; valid && i < games; ++i) {
+            GameSnapshot snapshot;
+            size_t used = snapshot.deserialize(cursor, end - cursor);
+            uint8_t connected[2] = {0, 0};
+            cursor += used;
+            if (used == 0 || !get(cursor, end, connected[0]) || !get(cursor, end, connected[1])) {
+                valid = false;
+                break;
+            }
+            std::shared_ptr<Transport> transports[2];
+            for (size_t j = 0; j < 2; ++j) {
+                if (connected[j]) transports[j] = take_transport();
+            }
+            QuoridorGame* game = restore_game(snapshot, transports);
+            if (!game) continue;
+            for (size_t j = 0; j < 2; ++j) {
+                if (transports[j]) resumed.emplace_back(game->get_players()[j], transports[j]);
+            }
+        }
+
+        if (valid && !get(cursor, end, waiting)) valid = false;
+        for (uint32_t i = 0; valid && i < waiting; ++i) {
+            uint8_t variant = 0, length = 0;
+            if (!get(cursor, end, variant) || !get(cursor, end, length) || end - cursor < length) {
+                valid = false;
+                break;
+            }
+            auto transport = take_transport();
+            if (!transport) continue;
+            Player* player = new Player(transport);
+            player->set_name(std::string(cursor, length));
+            player->variant = static_cast<Variant>(variant);
+            player->update_heartbeat();
+            cursor += length;
+            waiting_players.push_back(player);
+            resumed.emplace_back(player, transport);
+        }
+        publish_lobby_view();
+        Metrics::instance().active_games.set(active_games.size());
+    }
+
+    // descriptors that do not belong to a resumed player (malformed state) would otherwise leak
+    for (size_t i = next_fd; i < fds.size(); ++i) {
+        close(fds[i]);
+    }
+    for (auto& client : resumed) {
+        open_connections.fetch_add(1);
+        std::thread(&QuoridorServer::handle_client, this, client.second, client.first).detach();
+    }
+    return valid;
+}
+
+void QuoridorServer::remove_game(QuoridorGame* game) {
     std::lock_guard<std::mutex> lock(server_mutex);
-    std::vector<size_t> games_to_remove;
-    
-    // First, collect all finished games
-    for (const auto& game_pair : active_games) {
-        if (game_pair.second->get_state() != GameState::IN_PROGRESS) {
-            games_to_remove.push_back(game_pair.first);
+    size_t game_id = game->get_lobby_id();
+    auto game_it = active_games.find(game_id);
+    if (game_it == active_games.end() || game_it->second != game) return;
+    active_games.erase(game_it);
+    if (front_end_channel >= 0) report_to_front_end({"ended", std::to_string(game_id)});
+    publish_lobby_view();
+    Metrics::instance().active_games.set(active_games.size());
+}
+
+void QuoridorServer::setup_admin_server(int port) {
+    admin_server = std::make_unique<AdminServer>("/tmp/quoridor_admin_" + std::to_string(port) + ".sock");
+    admin_server->add_command("stats", [](const std::string&) {
+        return Metrics::instance().snapshot();
+    });
+    admin_server->add_command("trace", [](const std::string&) {
+#ifdef QUORIDOR_PROFILING
+        return Profiler::instance().dump_chrome_trace();
+#else
+        return std::string("profiling is disabled, rebuild with -DQUORIDOR_ENABLE_PROFILING=ON\n");
+#endif
+    });
+    admin_server->add_command("games", [this](const std::string&) {
+        return list_games();
+    });
+    admin_server->add_command("waiting", [this](const std::string&) {
+        return list_waiting_players();
+    });
+    admin_server->add_command("connections", [this](const std::string&) {
+        return list_connections();
+    });
+    admin_server->add_command("end", [this](const std::string& args) {
+        return end_game(args);
+    });
+    if (worker_pool) {
+        admin_server->add_command("workers", [this](const std::string&) {
+            return worker_pool->describe();
+        });
+        admin_server->add_command("worker_stats", [this](const std::string& args) {
+            try {
+                return worker_pool->worker_stats(std::stoul(args));
+            } catch (const std::exception&) {
+                return std::string("usage: worker_stats <worker>\n");
+            }
+        });
+    }
+    // server keeps running without the admin socket, it is only for operators
+    admin_server->start();
+}
+
+void QuoridorServer::update_view(const std::function<void(ServerView&)>& change) {
+    std::lock_guard<std::mutex> lock(view_mutex);
+    auto next = std::make_shared<ServerView>(*std::atomic_load(&view));
+    change(*next);
+    std::atomic_store(&view, std::shared_ptr<const ServerView>(std::move(next)));
+}
+
+void QuoridorServer::publish_lobby_view() {
+    update_view([this](ServerView& next) {
+        next.games.clear();
+        for (const auto& game_pair : active_games) {
+            next.games.push_back({game_pair.first, game_pair.second->get_snapshot_slot()});
+        }
+        // players that were already waiting keep their start time
+        std::vector<ServerView::Waiting> waiting;
+        for (Player* player : waiting_players) {
+            auto it = std::find_if(next.waiting.begin(), next.waiting.end(), [player](const ServerView::Waiting& entry) {
+                return entry.name == player->name;
+            });
+            waiting.push_back({player->name, it != next.waiting.end() ? it->since : Clock::now()});
         }
+        next.waiting = std::move(waiting);
+    });
+}
+
+void QuoridorServer::describe_connection(const Transport* transport, const std::string& name,
+                                         std::shared_ptr<Spectator> spectator) {
+    update_view([&](ServerView& next) {
+        for (auto& connection : next.connections) {
+            if (connection.transport.get() == transport) {
+                connection.name = name;
+                connection.spectator = spectator;
+            }
+        }
+    });
+}
+
+std::string QuoridorServer::list_games() const {
+    auto current = std::atomic_load(&view);
+    std::ostringstream out;
+    for (const auto& game : current->games) {
+        auto snapshot = game.snapshot->load();
+        if (!snapshot) {
+            out << "game " << game.lobby_id << " state=starting\n";
+            continue;
+        }
+        const auto& players = snapshot->players;
+        out << "game " << game.lobby_id << " variant=" << variant_info(static_cast<Variant>(snapshot->variant)).name
+            << " state=" << (snapshot->in_progress ? "in_progress" : "ended")
+            << " turn=" << snapshot->turn << " to_move=" << players[snapshot->current_player].name
+            << " players=" << players[0].name << "," << players[1].name
+            << " walls_left=" << int(players[0].walls_left) << "," << int(players[1].walls_left) << "\n";
     }
-    
-    // Then remove them
-    for (size_t game_id : games_to_remove) {
-        delete active_games[game_id];
-        active_games.erase(game_id);
+    if (current->games.empty()) out << "no games\n";
+    return out.str();
+}
+
+std::string QuoridorServer::list_waiting_players() const {
+    auto current = std::atomic_load(&view);
+    auto now = Clock::now();
+    std::ostringstream out;
+    for (const auto& waiting : current->waiting) {
+        out << waiting.name << " waiting_seconds="
+            << std::chrono::duration_cast<std::chrono::seconds>(now - waiting.since).count() << "\n";
     }
+    if (current->waiting.empty()) out << "no waiting players\n";
+    return out.str();
 }
 
-void QuoridorServer::handle_client(int client_socket) {
-    Player* player = initialize_player(client_socket);
+std::string QuoridorServer::list_connections() const {
+    auto current = std::atomic_load(&view);
+    auto now = Clock::now();
+    std::ostringstream out;
+    for (const auto& connection : current->connections) {
+        const Transport& transport = *connection.transport;
+        const char* role = connection.spectator ? "spectator" : (connection.name.empty() ? "setup" : "player");
+        out << "fd=" << transport.get_fd() << " name=" << (connection.name.empty() ? "-" : connection.name)
+            << " role=" << role
+            << " connected_seconds=" << std::chrono::duration_cast<std::chrono::seconds>(now - connection.connected_at).count()
+            << " heartbeat_age_ms="
+            << std::chrono::duration_cast<std::chrono::milliseconds>(now - transport.last_receive_time()).count()
+            << " outq_bytes=" << transport.outbound_queue();
+        if (connection.spectator) {
+            out << " queued_updates=" << connection.spectator->queue_depth();
+        }
+        out << "\n";
+    }
+    if (current->connections.empty()) out << "no connections\n";
+    return out.str();
+}
+
+std::string QuoridorServer::end_game(const std::string& args) {
+    size_t lobby_id = 0;
+    try {
+        lobby_id = std::stoul(args);
+    } catch (const std::exception&) {
+        return "usage: end <lobby_id>\n";
+    }
+    // the only command that changes the server, it goes through the lock like any other game change
+    std::lock_guard<std::mutex> lock(server_mutex);
+    auto game_it = active_games.find(lobby_id);
+    if (game_it == active_games.end() || !game_it->second->force_end()) {
+        return "game " + std::to_string(lobby_id) + " is not in progress\n";
+    }
+    LOG_INFO(LogFields(lobby_id, ""), "Game ended by operator");
+    return "game " + std::to_string(lobby_id) + " ended\n";
+}
+
+void QuoridorServer::handle_client(std::shared_ptr<Transport> transport, Player* resumed_player) {
+    // whatever the connection allocates outside the protocol and game code is charged to the network
+    MemoryScope memory(MemoryTag::NETWORK);
+    Metrics::instance().open_connections.add(1);
+    {
+        std::lock_guard<std::mutex> lock(connections_mutex);
+        client_connections[transport.get()] = false;
+    }
+    update_view([&](ServerView& next) {
+        next.connections.push_back({transport, resumed_player ? resumed_player->name : "", nullptr, Clock::now()});
+    });
+    if (resumed_player) {
+        setup_socket_timeout(*transport);
+        run_client(resumed_player, *transport);
+    } else {
+        serve_client(transport);
+    }
+    update_view([&](ServerView& next) {
+        auto& connections = next.connections;
+        connections.erase(std::remove_if(connections.begin(), connections.end(), [&](const ServerView::Connection& connection) {
+            return connection.transport == transport;
+        }), connections.end());
+    });
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    client_connections.erase(transport.get());
+    open_connections.fetch_sub(1);
+    Metrics::instance().open_connections.add(-1);
+}
+
+void QuoridorServer::serve_client(std::shared_ptr<Transport> transport) {
+    Player* player = initialize_player(transport);
     if (!player) {
         return;
     }
 
-    setup_socket_timeout(client_socket);
+    setup_socket_timeout(*transport);
 
-    if (!handle_player_name_setup(player)) {
-        std::cout << "Player name setup failed for player " << player->name << std::endl;
+    size_t spectate_lobby_id = 0;
+    if (!handle_player_name_setup(player, spectate_lobby_id)) {
+        LOG_INFO(LogFields(-1, player->name), "Player name setup failed");
         player->is_connected = false; // hard disconnect
         cleanup_player(player);
         return;
     }
+    if (spectate_lobby_id != 0) {
+        serve_spectator(player, spectate_lobby_id);
+        return;
+    }
+    describe_connection(transport.get(), player->name, nullptr);
+    if (worker_pool) {
+        serve_front_end_client(player);
+        return;
+    }
 
     auto disconnected_player = find_disconnected_player(player->name);
     bool skip_matchmaking = false;
@@ -129,7 +817,7 @@ void QuoridorServer::handle_client(int client_socket) {
 
     if (!skip_matchmaking) {
         if (!handle_matchmaking(player)) {
-            std::cout << "Matchmaking failed for player " << player->name << std::endl;
+            LOG_INFO(LogFields(-1, player->name), "Matchmaking failed");
             player->is_connected = false;
             cleanup_player(player);
             return;
@@ -138,13 +826,148 @@ void QuoridorServer::handle_client(int client_socket) {
         player = disconnected_player;
     }
 
-    main_client_loop(player);
-    std::cout << "Client loop ended for player " << player->name << std::endl;
+    run_client(player, *transport);
+}
+
+void QuoridorServer::run_client(Player* player, Transport& transport) {
+    main_client_loop(player, transport);
+    if (is_superseded(transport)) {
+        // a reconnection handed this player to a newer connection thread, which now owns its cleanup
+        return;
+    }
+    if (draining) {
+        return;  // connection and player are handed over to the new process as they are
+    }
+    LOG_INFO(LogFields(player->get_game_id(), player->name), "Client loop ended");
+    cleanup_player(player);
+}
+
+void QuoridorServer::serve_spectator(Player* player, size_t lobby_id) {
+    auto transport = player->get_transport();
+    auto spectator = std::make_shared<Spectator>(transport);
+    bool joined = false;
+    std::shared_ptr<SnapshotSlot> snapshot_slot; // for analysis requests, stays valid after the game is deleted
+    {
+        std::lock_guard<std::mutex> lock(server_mutex);
+        auto game_it = active_games.find(lobby_id);
+        joined = game_it != active_games.end() && game_it->second->add_spectator(spectator);
+        if (joined) snapshot_slot = game_it->second->get_snapshot_slot();
+    }
+    if (!joined) {
+        player->send_message(Message::create_error("Game not found"));
+        player->is_connected = false;
+        cleanup_player(player);
+        return;
+    }
+    LOG_INFO(LogFields(lobby_id, player->name), "Spectator joined");
+    describe_connection(transport.get(), player->name, spectator);
+
+    // replies of every spectator are the same bytes, serialize them once
+    static const WireBuffer heartbeat = Message::create_heartbeat().to_wire();
+    static const WireBuffer ack = Message::create_ack().to_wire();
+    std::thread sender(&Spectator::run_sender, spectator);
+    const auto heartbeat_interval = std::chrono::seconds(Player::HEARTBEAT_INTERVAL);
+    auto last_heartbeat_sent = Clock::now();
+    char buffer[1024];
+    while (!draining && spectator->is_open()) {
+        if (Clock::now() - player->last_heartbeat > std::chrono::seconds(Player::NORMAL_HEARTBEAT_TIMEOUT)) {
+            break;
+        }
+        auto now = Clock::now();
+        if (now - transport->last_receive_time() >= heartbeat_interval && now - last_heartbeat_sent >= heartbeat_interval) {
+            spectator->publish(heartbeat, MessageType::HEARTBEAT);
+            Metrics::instance().heartbeats_sent.add();
+            last_heartbeat_sent = now;
+        }
+        ssize_t bytes_read = transport->receive(buffer, sizeof(buffer) - 1);
+        if (bytes_read == 0 || (bytes_read < 0 && errno != EWOULDBLOCK && errno != EAGAIN)) {
+            break;
+        }
+        if (bytes_read < 0) continue;
+
+        player->update_heartbeat();
+        buffer[bytes_read] = '\0';
+        thread_local std::string line;  // reused like the line buffer of handle_client_message
+        size_t length = strlen(buffer);
+        size_t start = 0;
+        bool abandoned = false;
+        size_t dropped = 0;
+        while (start < length) {
+            const char* line_end = static_cast<const char*>(memchr(buffer + start, '\n', length - start));
+            size_t end = line_end ? static_cast<size_t>(line_end - buffer) : length;
+            size_t line_start = start;
+            start = end + 1;
+            if (end == line_start) continue;
+            if (!player->inbound_limit.try_take(Clock::now())) {
+                dropped++;  // same limit as players, a spectator must not fill the analysis queue for them
+                continue;
+            }
+            // spectators are read-only, everything except heartbeats, analysis requests and leaving is ignored
+            line.assign(buffer + line_start, end - line_start);
+            MessageType type = Message(line).get_type();
+            if (type == MessageType::ANALYZE) {
+                request_analysis(*snapshot_slot, [spectator](const WireBuffer& wire) {
+                    spectator->publish(wire, MessageType::ANALYSIS);
+                });
+            } else if (type == MessageType::HEARTBEAT) {
+                if (Clock::now() - transport->last_send_time() < heartbeat_interval) {
+                    Metrics::instance().acks_suppressed.add();
+                } else {
+                    spectator->publish(ack, MessageType::ACK);
+                }
+            } else if (type == MessageType::ABANDON) {
+                abandoned = true;
+            }
+        }
+        if (abandoned) break;
+        if (dropped > 0) {
+            Metrics::instance().messages_rate_limited.add(dropped);
+            player->dropped_messages += dropped;
+            if (player->dropped_messages > Player::MAX_DROPPED_MESSAGES) {
+                LOG_WARNING(LogFields(lobby_id, player->name), "Spectator exceeded the message rate, disconnecting");
+                break;
+            }
+            Clock::sleep_for(player->inbound_limit.time_until_available(Clock::now()));
+        }
+    }
+
+    // shutdown wakes the sender if it is blocked on a slow spectator, the socket is closed after it stopped
+    spectator->close();
+    transport->shutdown_transport();
+    sender.join();
+    LOG_INFO(LogFields(lobby_id, player->name), "Spectator left");
+    player->is_connected = false;
     cleanup_player(player);
 }
 
-Player* QuoridorServer::initialize_player(int client_socket) {
-    Player* player = new Player(client_socket);
+void QuoridorServer::request_analysis(const SnapshotSlot& slot, std::function<void(const WireBuffer&)> reply) {
+    auto snapshot = slot.load();
+    if (!snapshot || !snapshot->in_progress) {
+        reply(Message::create_error("Game not found").to_wire());
+        return;
+    }
+    size_t lobby_id = snapshot->lobby_id;
+    uint32_t turn = snapshot->turn;
+    auto answer = [reply, lobby_id, turn](const Analysis& analysis) {
+        reply(Message::create_analysis(lobby_id, turn, analysis).to_wire());
+    };
+    if (!AnalysisService::instance().submit(position_from_snapshot(*snapshot), snapshot->current_player, answer)) {
+        reply(Message::create_error("Analysis busy").to_wire());
+    }
+}
+
+void QuoridorServer::load_analysis_files() {
+    // without the files races and openings are analysed like any other position
+    if (AnalysisService::instance().load_tablebase(TABLEBASE_FILE)) {
+        LOG_INFO(LogFields(), "Loaded race tablebase %s", TABLEBASE_FILE);
+    }
+    if (AnalysisService::instance().load_book(BOOK_FILE)) {
+        LOG_INFO(LogFields(), "Loaded opening book %s", BOOK_FILE);
+    }
+}
+
+Player* QuoridorServer::initialize_player(std::shared_ptr<Transport> transport) {
+    Player* player = new Player(std::move(transport));
     player->update_heartbeat();
     player->is_connected = true;
     player->is_reconnecting = false;
@@ -154,15 +977,17 @@ Player* QuoridorServer::initialize_player(int client_socket) {
     return player;
 }
 
-bool QuoridorServer::handle_player_name_setup(Player* player) {
+bool QuoridorServer::handle_player_name_setup(Player* player, size_t& spectate_lobby_id) {
     char buffer[1024];
     std::string message_buffer;
     while (true) {
-        if (std::chrono::steady_clock::now() - player->last_heartbeat > std::chrono::seconds(Player::NORMAL_HEARTBEAT_TIMEOUT)) {
-            return false;
+        if (draining || Clock::now() - player->last_heartbeat > std::chrono::seconds(Player::NORMAL_HEARTBEAT_TIMEOUT)) {
+            return false;  // a client without a name is not handed over, it simply connects again
+        }
+        if (player->heartbeat_due()) {
+            player->send_heartbeat();
         }
-        player->send_message(Message::create_heartbeat());
-        int bytes_read = recv(player->socket, buffer, sizeof(buffer), 0);
+        int bytes_read = player->get_transport()->receive(buffer, sizeof(buffer) - 1);
         if (bytes_read < 0) {
             if (!handle_receive_error(player)) {
                 return false;
@@ -176,13 +1001,20 @@ bool QuoridorServer::handle_player_name_setup(Player* player) {
         
         buffer[bytes_read] = '\0';
         message_buffer += buffer;
-        std::stringstream ss(message_buffer);
-        std::string message;
-        while (std::getline(ss, message, '\n')) {
+        // complete lines are parsed (and charged to the rate limit) once, a partial line waits for the next read
+        size_t line_start = 0;
+        for (size_t line_end; (line_end = message_buffer.find('\n', line_start)) != std::string::npos;
+             line_start = line_end + 1) {
+            std::string message = message_buffer.substr(line_start, line_end - line_start);
             if (message.empty()) continue;
+            if (!player->inbound_limit.try_take(Clock::now())) {
+                Metrics::instance().messages_rate_limited.add();
+                if (++player->dropped_messages > Player::MAX_DROPPED_MESSAGES) return false;
+                continue;
+            }
             Message msg(message);
             // when message is incorrect we print WRONG_MESSAGE, so we dont need to worry about printing out dangerous data. 
-            std::cout << "Received message: " << msg.to_string() << std::endl;
+            LOG_DEBUG(LogFields(-1, player->name, msg.get_type()), "Received message: %s", msg.to_string().c_str());
             if (msg.get_type() == MessageType::NAME_RESPONSE) {
                 // validate first (name is required)
                 if (!msg.get_data("name").has_value()) {
@@ -190,54 +1022,100 @@ bool QuoridorServer::handle_player_name_setup(Player* player) {
                     return false;
                 }
                 player->set_name(msg.get_data("name").value());
+                // optional lobby variant, a reconnecting player keeps the variant of its game
+                auto variant = msg.get_data("variant");
+                if (variant.has_value() && !parse_variant(*variant, player->variant)) {
+                    player->send_message(Message::create_error("Unknown variant"));
+                    return false;
+                }
                 
                 // Check for disconnected player first
                 auto disconnected_player = find_disconnected_player(player->name);
-                if (!disconnected_player && active_games.size() >= MAX_GAMES) {
+                bool full;
+                {
+                    std::lock_guard<std::mutex> lock(server_mutex);
+                    full = active_games.size() >= MAX_GAMES;
+                }
+                if (!disconnected_player && full) {
                     // Only reject if not reconnecting and server is full
                     player->send_message(Message::create_error("Server is full"));
                     return false;
                 }
                 return true;
+            } else if (msg.get_type() == MessageType::SPECTATE) {
+                try {
+                    spectate_lobby_id = std::stoul(msg.get_data("lobby_id").value_or(""));
+                } catch (const std::exception&) {
+                    spectate_lobby_id = 0;
+                }
+                if (spectate_lobby_id == 0) {
+                    player->send_message(Message::create_error("Invalid lobby id"));
+                    return false;
+                }
+                player->set_name("spectator");
+                return true;
             } else if (msg.get_type() == MessageType::ACK) {
+                player->handle_ack(msg);
                 continue;
             } else if (msg.get_type() == MessageType::ABANDON) {
                 player->is_connected = false;
                 return false;
             } else if (msg.get_type() == MessageType::HEARTBEAT) {
-                player->send_message(Message::create_ack());
+                player->acknowledge_heartbeat();
                 continue;
             }
             
             player->send_message(Message::create_error("Wrong message (expected name response)"));
             return false;
         }
-        message_buffer = ss.str();
+        message_buffer.erase(0, line_start);
+        if (message_buffer.size() > MAX_SETUP_LINE) {
+            // a line that never ends is not charged to the rate limit, so its length is limited instead
+            LOG_WARNING(LogFields(-1, player->name), "Line too long during name setup, disconnecting");
+            return false;
+        }
     }
 }
 
 bool QuoridorServer::handle_matchmaking(Player* player) {
     std::lock_guard<std::mutex> lock(server_mutex);
-    
-    if (waiting_players.empty()) {
+
+    // the most recent waiting player of the same variant is the opponent
+    auto waiting = std::find_if(waiting_players.rbegin(), waiting_players.rend(), [player](const Player* candidate) {
+        return candidate->variant == player->variant;
+    });
+    if (waiting == waiting_players.rend()) {
         waiting_players.push_back(player);
+        publish_lobby_view();
         player->send_message(Message::create_waiting());
         return true;
     }
 
-    Player* opponent = waiting_players.back();
-    waiting_players.pop_back();
+    if (active_games.size() >= MAX_GAMES) {
+        // the check during name setup is only a hint, games may have been created since
+        player->send_message(Message::create_error("Server is full"));
+        return false;
+    }
+    Player* opponent = *waiting;
+    waiting_players.erase(std::next(waiting).base());
+    if (worker_pool) {
+        return dispatch_match(opponent, player);
+    }
 
-    QuoridorGame* game = create_game(opponent, player);
+    QuoridorGame* game = create_game(opponent, player, ++game_id_counter);
+    publish_lobby_view();
     return game != nullptr;
 }
 
-QuoridorGame* QuoridorServer::create_game(Player* player1, Player* player2) {
-    QuoridorGame* game = new QuoridorGame();
-    int game_id = ++game_id_counter;
+QuoridorGame* QuoridorServer::create_game(Player* player1, Player* player2, size_t game_id) {
+    MemoryScope memory(MemoryTag::GAME);
+    QuoridorGame* game = new QuoridorGame(player2->variant);
+    game->set_reclaimer(reclaimer.get());
     
     active_games[game_id] = game;
     game->set_lobby_id(game_id);
+    Metrics::instance().active_games.set(active_games.size());
+    Metrics::instance().games_started.add();
     
     player1->set_game_id(game_id);
     player2->set_game_id(game_id);
@@ -248,35 +1126,157 @@ QuoridorGame* QuoridorServer::create_game(Player* player1, Player* player2) {
     return game;
 }
 
+void QuoridorServer::serve_front_end_client(Player* player) {
+    // a name of a running game belongs to a reconnecting player, its worker takes the connection over
+    if (worker_pool->route_reconnection(player->name, player->get_transport()->get_fd())) {
+        release_to_worker(player);
+        return;
+    }
+    if (!handle_matchmaking(player)) {
+        LOG_INFO(LogFields(-1, player->name), "Matchmaking failed");
+        player->is_connected = false;
+        cleanup_player(player);
+        return;
+    }
+    if (player->get_game_id() != -1) {
+        release_to_worker(player);
+        return;
+    }
+    wait_for_match(player);
+}
+
+bool QuoridorServer::dispatch_match(Player* opponent, Player* player) {
+    size_t lobby_id = ++game_id_counter;
+    const std::string names[2] = {opponent->name, player->name};
+    const int fds[2] = {opponent->get_transport()->get_fd(), player->get_transport()->get_fd()};
+    {
+        // the waiting opponent's thread does not read between the handoff and seeing the game id, then lets go
+        std::lock_guard<std::mutex> handoff(opponent->handoff_mutex);
+        if (!worker_pool->dispatch_match(lobby_id, variant_info(player->variant).name, names, fds)) {
+            waiting_players.push_back(opponent);
+            player->send_message(Message::create_error("Server is full"));
+            return false;
+        }
+        opponent->set_game_id(lobby_id);
+    }
+    player->set_game_id(lobby_id);
+    publish_lobby_view();
+    return true;
+}
+
+void QuoridorServer::wait_for_match(Player* player) {
+    auto transport = player->get_transport();
+    char buffer[1024];
+    bool leave = false;
+    while (!leave) {
+        pollfd descriptor{transport->get_fd(), POLLIN, 0};
+        bool readable = poll(&descriptor, 1, 1000) > 0;
+        ssize_t bytes_read;
+        int receive_error;
+        {
+            // a match hands the connection to a worker under handoff_mutex, after that this thread must not read it
+            std::lock_guard<std::mutex> handoff(player->handoff_mutex);
+            if (player->get_game_id() != -1) break;
+            if (!readable) continue;
+            bytes_read = transport->receive(buffer, sizeof(buffer) - 1);
+            receive_error = errno;
+        }
+        if (bytes_read < 0 && (receive_error == EWOULDBLOCK || receive_error == EAGAIN)) continue;
+        if (bytes_read <= 0) break;
+
+        player->update_heartbeat();
+        buffer[bytes_read] = '\0';
+        thread_local std::string line;  // reused like the line buffer of handle_client_message
+        size_t length = strlen(buffer);
+        size_t start = 0;
+        while (!leave && start < length) {
+            const char* line_end = static_cast<const char*>(memchr(buffer + start, '\n', length - start));
+            size_t end = line_end ? static_cast<size_t>(line_end - buffer) : length;
+            size_t line_start = start;
+            start = end + 1;
+            if (end == line_start) continue;
+            if (!player->inbound_limit.try_take(Clock::now())) {
+                Metrics::instance().messages_rate_limited.add();
+                leave = ++player->dropped_messages > Player::MAX_DROPPED_MESSAGES;
+                continue;
+            }
+            // nothing but heartbeats is expected before the game starts, anything else leaves the queue
+            line.assign(buffer + line_start, end - line_start);
+            Message msg(line);
+            if (msg.get_type() == MessageType::HEARTBEAT) {
+                player->acknowledge_heartbeat();
+            } else if (msg.get_type() == MessageType::ACK) {
+                player->handle_ack(msg);
+            } else {
+                leave = true;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(server_mutex);
+        if (player->get_game_id() == -1) {
+            auto it = std::find(waiting_players.begin(), waiting_players.end(), player);
+            if (it != waiting_players.end()) waiting_players.erase(it);
+            publish_lobby_view();
+        }
+    }
+    if (player->get_game_id() != -1) {
+        release_to_worker(player);  // matched while leaving, the worker sees the closed connection
+        return;
+    }
+    LOG_INFO(LogFields(-1, player->name), "Client disconnected");
+    transport->close_transport();
+    delete player;
+}
+
+void QuoridorServer::release_to_worker(Player* player) {
+    // the worker has its own descriptor for the connection, closing this one does not end it
+    LOG_INFO(LogFields(player->get_game_id(), player->name), "Connection passed to a game worker");
+    player->get_transport()->close_transport();
+    delete player;
+}
+
 void QuoridorServer::start_heartbeat_thread(Player* player) {
     std::thread([player]() {
         while (player->is_connected) {
             player->send_message(Message::create_heartbeat());
-            std::this_thread::sleep_for(std::chrono::seconds(Player::HEARTBEAT_INTERVAL));
+            Clock::sleep_for(std::chrono::seconds(Player::HEARTBEAT_INTERVAL));
         }
     }).detach();
 }
 
-void QuoridorServer::setup_socket_timeout(int client_socket) {
-    struct timeval tv{1, 0};  // 1 second timeout
-    if (setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
-        std::cerr << "Failed to set socket timeout" << std::endl;
-    }
+void QuoridorServer::setup_socket_timeout(Transport& transport) {
+    transport.set_receive_timeout(1);  // 1 second timeout
 }
 
-void QuoridorServer::main_client_loop(Player* player) {
-    while (player->is_connected) {
-        if (!handle_client_message(player)) {
-            handle_disconnection(player);
+void QuoridorServer::main_client_loop(Player* player, Transport& transport) {
+    QuoridorGame* game = nullptr;  // held until the loop ends, an ended game is deleted once nobody holds it
+    while (!draining && !is_superseded(transport) && player->is_connected) {
+        if (!handle_client_message(player, transport, game)) {
+            if (is_superseded(transport)) break;
+            handle_disconnection(player, game);
             break;
         }
     }
+    if (game) game->release();
+}
+
+QuoridorGame* QuoridorServer::acquire_game(Player* player) {
+    std::lock_guard<std::mutex> lock(server_mutex);
+    auto game_it = active_games.find(player->get_game_id());
+    if (game_it == active_games.end() || game_it->second->get_state() != GameState::IN_PROGRESS) return nullptr;
+    game_it->second->acquire();
+    return game_it->second;
 }
 
-bool QuoridorServer::handle_client_message(Player* player) {
+bool QuoridorServer::handle_client_message(Player* player, Transport& transport, QuoridorGame*& game) {
     char buffer[1024];
-    std::string message_buffer;
-    int bytes_read = recv(player->socket, buffer, sizeof(buffer), 0);
+    int bytes_read = transport.receive(buffer, sizeof(buffer) - 1);
+    if (is_superseded(transport)) {
+        return false;  // player was reconnected on another transport while we were blocked
+    }
+
     
     if (bytes_read < 0) {
         return handle_receive_error(player);
@@ -286,75 +1286,113 @@ bool QuoridorServer::handle_client_message(Player* player) {
     }
     
     buffer[bytes_read] = '\0';
-    message_buffer += buffer;
-
-    std::stringstream ss(message_buffer);
-    std::string message;
-    while (std::getline(ss, message, '\n')) {
-        if (message.empty()) continue;
+    // line buffer is reused by this client thread, so splitting messages does not allocate in steady state
+    thread_local std::string message;
+    size_t length = strlen(buffer);
+    size_t start = 0;
+    size_t dropped = 0;
+    while (start < length) {
+        const char* line_end = static_cast<const char*>(memchr(buffer + start, '\n', length - start));
+        size_t end = line_end ? static_cast<size_t>(line_end - buffer) : length;
+        size_t line_start = start;
+        start = end + 1;
+        if (end == line_start) continue;
+        if (!player->inbound_limit.try_take(Clock::now())) {
+            dropped++;  // over the rate limit, dropped before parsing and without a reply
+            continue;
+        }
+        message.assign(buffer + line_start, end - line_start);
 
         Message msg(message);
         player->update_heartbeat();
         
         if (msg.get_type() == MessageType::ACK) {
+            player->handle_ack(msg);
             continue;
         }
 
         if (msg.get_type() == MessageType::HEARTBEAT) {
-            player->send_message(Message::create_ack());
+            // several heartbeats in one read get a single ACK, the first one counts as recent traffic
+            player->acknowledge_heartbeat();
             continue;
         }
         // when message is incorrect we print WRONG_MESSAGE, so we dont need to worry about printing out dangerous data.
         // printing is here to avoid clustering print statements.
-        std::cout << "Received message: " << msg.to_string() << std::endl;
+        LOG_DEBUG(LogFields(player->get_game_id(), player->name, msg.get_type()), "Received message: %s", msg.to_string().c_str());
         
         if (msg.get_type() == MessageType::ABANDON) {
             player->is_connected = false;
             return false;
         }
 
-        auto game_it = active_games.find(player->get_game_id());
-        if (game_it == active_games.end()) {
-            std::cout << "Game not found for player " << player->name << std::endl;
+        // the game is looked up once, later messages go to the held game until it ends
+        if (!game) game = acquire_game(player);
+        if (!game || game->get_state() != GameState::IN_PROGRESS) {
+            LOG_WARNING(LogFields(player->get_game_id(), player->name), "Game not found for player");
             player->is_connected = false;
             return false;
         }
+
+        if (msg.get_type() == MessageType::ANALYZE) {
+            // answered by the analysis threads from the published snapshot, the game itself is not touched
+            request_analysis(*game->get_snapshot_slot(), [connection = player->get_transport()](const WireBuffer& wire) {
+                if (connection) connection->send_bytes(wire->c_str(), wire->size() + 1);
+            });
+            continue;
+        }
         
-        if (!handle_game_message(game_it->second, player, message.c_str())) {
+        if (!handle_game_message(game, player, msg)) {
             return false;
         }
     }
-    message_buffer = ss.str();
+    if (dropped > 0) {
+        Metrics::instance().messages_rate_limited.add(dropped);
+        player->dropped_messages += dropped;
+        if (player->dropped_messages > Player::MAX_DROPPED_MESSAGES) {
+            LOG_WARNING(LogFields(player->get_game_id(), player->name), "Client exceeded the message rate, disconnecting");
+            player->send_message(Message::create_error("Too many messages"));
+            player->is_connected = false;
+            return false;
+        }
+        // stop reading until the bucket refills, the kernel buffers fill up and TCP slows the client down
+        Clock::sleep_for(player->inbound_limit.time_until_available(Clock::now()));
+    }
     return true;
 }
 
+bool QuoridorServer::is_superseded(const Transport& transport) {
+    std::lock_guard<std::mutex> lock(connections_mutex);
+    auto it = client_connections.find(&transport);
+    return it != client_connections.end() && it->second;
+}
+
 bool QuoridorServer::handle_receive_error(Player* player) {
     if (errno == EWOULDBLOCK || errno == EAGAIN) {
         return true;  // Timeout occurred, continue the loop
     }
     
-    std::cout << "Socket error: " << strerror(errno) << std::endl;
+    LOG_WARNING(LogFields(player->get_game_id(), player->name), "Socket error: %s", strerror(errno));
     // error so we wont try to reconnect (fuck this guy)
     player->is_connected = false;
     return false;
 }
 
-void QuoridorServer::handle_disconnection(Player* player) {
-    auto game_it = active_games.find(player->get_game_id());
+void QuoridorServer::handle_disconnection(Player* player, QuoridorGame*& game) {
+    if (!game) game = acquire_game(player);
 
-    if (game_it == active_games.end()) {
+    if (!game) {
         player->is_connected = false; // hard disconnect not in game == (most likely left waiting for players or simillar situation)
     }
     // player is hard disconnected = because of errors or tried to send invalid messages (not allowed)
     // if player is disconected because of network issues, we wont do anything, because checker inside game will handle it
-    if (game_it != active_games.end() && !player->is_connected) {
-        game_it->second->handle_player_disconnection(player);
+    if (game && !player->is_connected) {
+        game->handle_player_disconnection(player);
     }
 }
 
 void QuoridorServer::cleanup_player(Player* player) {
-    std::cout << "Client disconnected" << std::endl;
-    close(player->socket);
+    LOG_INFO(LogFields(player->get_game_id(), player->name), "Client disconnected");
+    player->get_transport()->close_transport();
     
     // Remove from waiting queue if present
     {
@@ -362,6 +1400,7 @@ void QuoridorServer::cleanup_player(Player* player) {
         auto it = std::find(waiting_players.begin(), waiting_players.end(), player);
         if (it != waiting_players.end()) {
             waiting_players.erase(it);
+            publish_lobby_view();
             delete player;
             return;
         }
@@ -373,12 +1412,11 @@ void QuoridorServer::cleanup_player(Player* player) {
     }
 }
 
-bool QuoridorServer::validate_client_message(QuoridorGame* game, Player* player, const char* message_string, Message& message) {
+bool QuoridorServer::validate_client_message(QuoridorGame* game, Player* player, const Message& message, const Move& move) {
     if (game == nullptr) {
         player->send_message(Message::create_error("Game not found"));
         return false;
     }
-    message = Message(message_string);
     if (!message.validate()) {
         player->send_message(Message::create_error("Invalid message"));
         return false;
@@ -386,13 +1424,14 @@ bool QuoridorServer::validate_client_message(QuoridorGame* game, Player* player,
     if (message.get_type() == MessageType::ACK) {
         return true;
     }
-    Move move(message);
     if (!move.is_valid_structure) {
+        Metrics::instance().invalid_moves.add();
         player->send_message(Message::create_error("Invalid move structure"));
         return false;
     }
     try {
         if (move.get_player_id() + 1 != std::stoi(player->get_id())) {
+            Metrics::instance().invalid_moves.add();
             player->send_message(Message::create_error("Not your turn"));
             return false;
         }
@@ -403,26 +1442,35 @@ bool QuoridorServer::validate_client_message(QuoridorGame* game, Player* player,
     return true;
 }
 
-bool QuoridorServer::handle_game_message(QuoridorGame* game, Player* player, const char* message_string) {
-    Message message;
-    if (!validate_client_message(game, player, message_string, message)
-    || (message.get_type() != MessageType::MOVE && message.get_type() != MessageType::ACK)) {
+bool QuoridorServer::handle_game_message(QuoridorGame* game, Player* player, const Message& message) {
+    // message is already parsed by the client loop, move is decoded once and reused for validation
+    MemoryScope memory(MemoryTag::GAME);
+    thread_local Move move(false, {}, 0);
+    move.decode(message);
+    MessageType type = message.get_type();
+    if (!validate_client_message(game, player, message, move)
+    || (type != MessageType::MOVE && type != MessageType::PREMOVE && type != MessageType::ACK)) {
         player->is_connected = false;
         return false;
     }
 
-    Move move(message);
-    game->handle_move(move);
+    if (type == MessageType::PREMOVE) {
+        game->handle_premove(move);
+    } else {
+        game->handle_move(move);
+    }
     return true;
 }
 
 QuoridorServer::~QuoridorServer() {
     running = false;
-    std::this_thread::sleep_for(std::chrono::seconds(1)); // Give cleaner thread time to finish
+    reclaimer.reset();  // stops removing games before the remaining ones are deleted here
+    std::this_thread::sleep_for(std::chrono::seconds(1)); // Give the other server threads time to finish
     close(server_socket);
-    std::cout << "Server closed" << std::endl;
+    LOG_INFO(LogFields(), "Server closed");
+    Logger::instance().flush();
     for (auto player : waiting_players) {
-        close(player->socket);
+        player->get_transport()->close_transport();
         delete player;
     }
     
@@ -437,8 +1485,7 @@ Player* QuoridorServer::find_disconnected_player(const std::string& name) {
     // Check in active games
     for (const auto& game_pair : active_games) {
         if (game_pair.second->get_state() != GameState::IN_PROGRESS) {
-            // maybe delete game? TODO: figure out how and when delete finished games
-            continue;
+            continue;  // ended, the reclaimer is about to remove it
         }
         for (Player* player : game_pair.second->get_players()) {
             if (player->name == name) {
@@ -454,16 +1501,29 @@ bool QuoridorServer::handle_player_reconnection(Player* new_player, Player* exis
     if (existing_player == nullptr) {
         return false;
     }
-    // Transfer the socket and update connection status
-    existing_player->socket = new_player->socket;
-    existing_player->update_heartbeat();
-    
-    // Send current game state
-    auto game = active_games[existing_player->get_game_id()];
-    if (!game || game->get_state() != GameState::IN_PROGRESS) {
-        return false;
+    {
+        // the game may have ended and been removed since the player was found, the player is handed to the new
+        // connection under the same lock, so the reclaimer knows whether it still has to delete it
+        std::lock_guard<std::mutex> lock(server_mutex);
+        auto game_it = active_games.find(existing_player->get_game_id());
+        if (game_it == active_games.end() || game_it->second->get_state() != GameState::IN_PROGRESS) {
+            return false;
+        }
+
+        // Transfer the connection and update connection status, the thread of the old connection stops using the player
+        {
+            std::lock_guard<std::mutex> lock(connections_mutex);
+            auto it = client_connections.find(existing_player->get_transport().get());
+            if (it != client_connections.end()) {
+                it->second = true;
+            }
+        }
+        existing_player->set_transport(new_player->get_transport());
+        existing_player->link.reset(Clock::now());  // the new connection has its own round trip time
+        existing_player->update_heartbeat();
+        existing_player->is_reconnecting = true;
+        game_it->second->set_unconnected(existing_player, false);  // its connection thread deletes it from now on
     }
-    existing_player->is_reconnecting = true;
     
     delete new_player;  // Clean up the temporary player object
     return true;
@@ -0,0 +1,48 @@
+#include "rate_limiter.h"
+#include <algorithm>
+
+TokenBucket::TokenBucket(double rate, double burst, Clock::time_point now)
+    : rate(rate), burst(burst), tokens(burst), last_refill(now) {}
+
+void TokenBucket::refill(Clock::time_point now) {
+    if (now <= last_refill) return;
+    double elapsed = std::chrono::duration<double>(now - last_refill).count();
+    tokens = std::min(burst, tokens + elapsed * rate);
+    last_refill = now;
+}
+
+bool TokenBucket::try_take(Clock::time_point now, double count) {
+    refill(now);
+    if (tokens < count) return false;
+    tokens -= count;
+    return true;
+}
+
+Clock::duration TokenBucket::time_until_available(Clock::time_point now, double count) {
+    refill(now);
+    if (tokens >= count) return Clock::duration::zero();
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>((count - tokens) / rate));
+}
+
+bool TokenBucket::is_full(Clock::time_point now) {
+    refill(now);
+    return tokens >= burst;
+}
+
+AddressRateLimiter::AddressRateLimiter(double rate, double burst, size_t max_addresses)
+    : rate(rate), burst(burst), max_addresses(max_addresses) {}
+
+bool AddressRateLimiter::try_acquire(uint32_t address, Clock::time_point now) {
+    std::lock_guard<std::mutex> lock(limiter_mutex);
+    auto it = buckets.find(address);
+    if (it == buckets.end()) {
+        if (buckets.size() >= max_addresses) {
+            for (auto bucket = buckets.begin(); bucket != buckets.end();) {
+                bucket = bucket->second.is_full(now) ? buckets.erase(bucket) : std::next(bucket);
+            }
+            if (buckets.size() >= max_addresses) return false;  // too many active addresses, flood from many sources
+        }
+        it = buckets.emplace(address, TokenBucket(rate, burst, now)).first;
+    }
+    return it->second.try_take(now);
+}
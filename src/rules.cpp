@@ -0,0 +1,35 @@
+#include "rules.h"
+
+// not hosted yet (messages, clocks and snapshots are for two players), compiled so the engine stays correct
+template class Rules<9, 4>;
+
+namespace {
+const VariantInfo VARIANTS[] = {
+    {"standard", Rules<9, 2>::SIZE, Rules<9, 2>::WALLS_PER_PLAYER, 5 * 60 * 1000, 5 * 1000},
+    {"blitz", Rules<5, 2>::SIZE, Rules<5, 2>::WALLS_PER_PLAYER, 1 * 60 * 1000, 2 * 1000},
+    {"large", Rules<11, 2>::SIZE, Rules<11, 2>::WALLS_PER_PLAYER, 10 * 60 * 1000, 5 * 1000},
+};
+}
+
+const VariantInfo& variant_info(Variant variant) {
+    size_t index = static_cast<size_t>(variant);
+    return VARIANTS[index < sizeof(VARIANTS) / sizeof(VARIANTS[0]) ? index : 0];
+}
+
+bool parse_variant(const std::string& name, Variant& variant) {
+    for (size_t i = 0; i < sizeof(VARIANTS) / sizeof(VARIANTS[0]); ++i) {
+        if (name == VARIANTS[i].name) {
+            variant = static_cast<Variant>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+VariantPosition initial_position(Variant variant) {
+    switch (variant) {
+        case Variant::BLITZ: return Rules<5, 2>::initial();
+        case Variant::LARGE: return Rules<11, 2>::initial();
+        default: return Rules<9, 2>::initial();
+    }
+}
@@ -0,0 +1,100 @@
+#include "spectator.h"
+#include <algorithm>
+#include "memory_accounting.h"
+#include "metrics.h"
+
+Spectator::Spectator(std::shared_ptr<Transport> transport) : transport(std::move(transport)) {
+    Metrics::instance().spectators.add(1);
+}
+
+Spectator::~Spectator() {
+    Metrics::instance().spectators.add(-1);
+}
+
+bool Spectator::is_conflatable(MessageType type) {
+    return type == MessageType::NEXT_TURN || type == MessageType::HEARTBEAT || type == MessageType::ACK ||
+           type == MessageType::ANALYSIS;
+}
+
+void Spectator::publish(const WireBuffer& update, MessageType type) {
+    MemoryScope memory(MemoryTag::NETWORK);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (closed || finishing) return;
+        if (is_conflatable(type)) {
+            auto it = std::find_if(pending.begin(), pending.end(), [type](const Update& queued) {
+                return queued.type == type;
+            });
+            if (it != pending.end()) {
+                it->wire = update;
+                Metrics::instance().spectator_conflated.add();
+                return;
+            }
+        }
+        if (pending.size() >= MAX_PENDING_UPDATES) {
+            // the spectator is so far behind that even conflation does not help, players must not wait for it
+            closed = true;
+            pending.clear();
+            Metrics::instance().spectators_dropped.add();
+        } else {
+            pending.push_back({update, type});
+        }
+    }
+    queue_condition.notify_one();
+}
+
+void Spectator::finish() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        finishing = true;
+    }
+    queue_condition.notify_one();
+}
+
+void Spectator::close() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (closed) return;
+        closed = true;
+        pending.clear();
+    }
+    queue_condition.notify_one();
+}
+
+bool Spectator::is_open() const {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return !closed;
+}
+
+size_t Spectator::queue_depth() const {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return pending.size();
+}
+
+void Spectator::run_sender() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (true) {
+        queue_condition.wait(lock, [this]() { return closed || finishing || !pending.empty(); });
+        if (closed) break;
+        if (pending.empty()) {
+            closed = true;  // finishing and everything is sent
+            break;
+        }
+        WireBuffer wire = std::move(pending.front().wire);
+        pending.pop_front();
+        lock.unlock();
+        // a slow spectator only blocks this thread, the game keeps queueing (and conflating) meanwhile
+        ssize_t sent = transport->send_bytes(wire->c_str(), wire->size() + 1);
+        lock.lock();
+        if (sent < 0) {
+            closed = true;
+            pending.clear();
+            break;
+        }
+        Metrics::instance().spectator_updates.add();
+    }
+}
+
+std::shared_ptr<Transport> Spectator::get_transport() const {
+    return transport;
+}
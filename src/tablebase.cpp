@@ -0,0 +1,220 @@
+#include "tablebase.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+
+namespace {
+// Value encoding: result in the top two bits, plies in the rest
+constexpr uint16_t RESULT_SHIFT = 14;
+constexpr uint16_t PLIES_MASK = (1 << RESULT_SHIFT) - 1;
+
+uint16_t encode(Tablebase::Result result, int plies) {
+    return static_cast<uint16_t>(static_cast<uint16_t>(result) << RESULT_SHIFT | std::min<int>(plies, PLIES_MASK));
+}
+
+Tablebase::Result result_of(uint16_t value) {
+    return static_cast<Tablebase::Result>(value >> RESULT_SHIFT);
+}
+
+int plies_of(uint16_t value) {
+    return value & PLIES_MASK;
+}
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t table_count;
+};
+
+// Table header, the wall words follow it
+struct TableHeader {
+    uint8_t variant;
+    uint8_t reserved[7];
+};
+
+template <typename Engine>
+size_t value_index(int to_move, int pawn0, int pawn1) {
+    return (static_cast<size_t>(to_move) * Engine::CELLS + pawn0) * Engine::CELLS + pawn1;
+}
+
+template <typename Position>
+std::vector<uint16_t> solve_layout(const Position& layout) {
+    using Engine = typename Position::Engine;
+    constexpr int CELLS = Engine::CELLS;
+    const size_t states = 2 * static_cast<size_t>(CELLS) * CELLS;
+    std::vector<uint16_t> values(states, encode(Tablebase::Result::DRAW, 0));
+    std::vector<bool> decided(states, false);
+    std::vector<std::array<uint32_t, 4>> successors(states);
+    std::vector<uint8_t> successor_count(states, 0);
+
+    // placements where the player that just moved stands on its goal are lost, everything else gets its moves
+    for (int to_move = 0; to_move < 2; ++to_move) {
+        for (int pawn0 = 0; pawn0 < CELLS; ++pawn0) {
+            for (int pawn1 = 0; pawn1 < CELLS; ++pawn1) {
+                if (pawn0 == pawn1) continue;
+                size_t state = value_index<Engine>(to_move, pawn0, pawn1);
+                Position position = layout;
+                position.pawns[0] = static_cast<uint8_t>(pawn0);
+                position.pawns[1] = static_cast<uint8_t>(pawn1);
+                if (Engine::has_won(position, 1 - to_move)) {
+                    values[state] = encode(Tablebase::Result::LOSS, 0);
+                    decided[state] = true;
+                    continue;
+                }
+                if (Engine::has_won(position, to_move)) continue;  // the game ended before this turn
+                int row = position.pawns[to_move] / Engine::SIZE;
+                int col = position.pawns[to_move] % Engine::SIZE;
+                const std::pair<int, int> steps[] = {{row - 1, col}, {row + 1, col}, {row, col - 1}, {row, col + 1}};
+                for (const auto& step : steps) {
+                    if (!Engine::is_valid_step(position, to_move, step.first, step.second)) continue;
+                    Position next = position;
+                    Engine::move_pawn(next, to_move, step.first, step.second);
+                    successors[state][successor_count[state]++] =
+                        static_cast<uint32_t>(value_index<Engine>(1 - to_move, next.pawns[0], next.pawns[1]));
+                }
+            }
+        }
+    }
+
+    // one sweep per ply: a position is won in p plies if a move leads to a loss in p - 1, lost in p plies if every
+    // move leads to a win and the slowest of them ends in p - 1 (it would have been found in an earlier sweep otherwise)
+    std::vector<std::pair<size_t, uint16_t>> found;
+    for (int plies = 1;; ++plies) {
+        found.clear();
+        for (size_t state = 0; state < states; ++state) {
+            if (decided[state] || successor_count[state] == 0) continue;
+            bool wins = false;
+            bool all_lost = true;
+            for (uint8_t i = 0; i < successor_count[state]; ++i) {
+                size_t next = successors[state][i];
+                if (!decided[next]) {
+                    all_lost = false;
+                    continue;
+                }
+                if (result_of(values[next]) == Tablebase::Result::LOSS) wins = true;
+                if (result_of(values[next]) != Tablebase::Result::WIN) all_lost = false;
+            }
+            if (wins) found.emplace_back(state, encode(Tablebase::Result::WIN, plies));
+            else if (all_lost) found.emplace_back(state, encode(Tablebase::Result::LOSS, plies));
+        }
+        if (found.empty()) break;
+        for (const auto& entry : found) {
+            values[entry.first] = entry.second;
+            decided[entry.first] = true;
+        }
+    }
+    return values;
+}
+
+// Wall words of a position as stored in a table
+template <typename Position>
+void append_walls(std::string& out, const Position& position) {
+    out.append(reinterpret_cast<const char*>(position.wall_down.words), sizeof(position.wall_down.words));
+    out.append(reinterpret_cast<const char*>(position.wall_right.words), sizeof(position.wall_right.words));
+}
+}
+
+Tablebase::Table Tablebase::solve(const VariantPosition& layout) {
+    Table table;
+    table.layout = layout;
+    table.values = std::visit([](const auto& position) { return solve_layout(position); }, layout);
+    return table;
+}
+
+uint64_t Tablebase::layout_key(const VariantPosition& position) {
+    return std::visit([&position](auto walls) {
+        using Engine = typename decltype(walls)::Engine;
+        for (int player = 0; player < Engine::PLAYERS; ++player) {
+            walls.pawns[player] = 0;
+            walls.walls_left[player] = 0;
+        }
+        return Engine::hash(walls) ^ (position.index() * 0x9e3779b97f4a7c15ull);
+    }, position);
+}
+
+bool Tablebase::write(const std::string& path, std::vector<Table>& tables) {
+    std::sort(tables.begin(), tables.end(), [](const Table& a, const Table& b) {
+        return layout_key(a.layout) < layout_key(b.layout);
+    });
+    tables.erase(std::unique(tables.begin(), tables.end(), [](const Table& a, const Table& b) {
+        return layout_key(a.layout) == layout_key(b.layout);
+    }), tables.end());
+
+    FileHeader header{};
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = FORMAT_VERSION;
+    header.table_count = static_cast<uint32_t>(tables.size());
+    std::vector<IndexEntry> entries;
+    std::string body;
+    uint64_t offset = sizeof(FileHeader) + tables.size() * sizeof(IndexEntry);
+    for (const Table& table : tables) {
+        entries.push_back({layout_key(table.layout), offset + body.size()});
+        TableHeader table_header{};
+        table_header.variant = static_cast<uint8_t>(table.layout.index());
+        body.append(reinterpret_cast<const char*>(&table_header), sizeof(table_header));
+        std::visit([&body](const auto& position) { append_walls(body, position); }, table.layout);
+        body.append(reinterpret_cast<const char*>(table.values.data()), table.values.size() * sizeof(uint16_t));
+        body.resize((body.size() + 7) & ~size_t(7));  // keep the next table aligned
+    }
+
+    std::string temporary = path + ".tmp";
+    FILE* out = fopen(temporary.c_str(), "wb");
+    if (!out) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+        fwrite(entries.data(), sizeof(IndexEntry), entries.size(), out) == entries.size() &&
+        fwrite(body.data(), 1, body.size(), out) == body.size();
+    // data has to be on disk before the rename, the server maps the file on its next start
+    ok = ok && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    ok = (fclose(out) == 0) && ok;
+    return ok && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool Tablebase::open(const std::string& path) {
+    index = nullptr;
+    count = 0;
+    if (!file.map(path, false)) return false;
+    FileHeader header;
+    if (file.size < sizeof(header)) return false;
+    memcpy(&header, file.data, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != FORMAT_VERSION ||
+        file.size < sizeof(header) + header.table_count * sizeof(IndexEntry)) {
+        file.unmap();
+        return false;
+    }
+    index = reinterpret_cast<const IndexEntry*>(file.data + sizeof(header));
+    count = header.table_count;
+    return true;
+}
+
+bool Tablebase::probe(const VariantPosition& variant_position, int to_move, Value& value) const {
+    if (count == 0) return false;
+    uint64_t key = layout_key(variant_position);
+    const IndexEntry* end = index + count;
+    const IndexEntry* entry = std::lower_bound(index, end, key, [](const IndexEntry& candidate, uint64_t wanted) {
+        return candidate.key < wanted;
+    });
+    if (entry == end || entry->key != key) return false;
+    return std::visit([this, entry, &variant_position, to_move, &value](const auto& position) {
+        using Engine = typename std::decay_t<decltype(position)>::Engine;
+        if (position.walls_left[0] != 0 || position.walls_left[1] != 0) return false;
+        constexpr size_t WALL_BYTES = sizeof(position.wall_down.words);
+        size_t table_size = sizeof(TableHeader) + 2 * WALL_BYTES + 2 * Engine::CELLS * Engine::CELLS * sizeof(uint16_t);
+        if (entry->offset + table_size > file.size) return false;
+        // the key could be shared by another layout, the table repeats the walls
+        const char* table = file.data + entry->offset;
+        const char* walls = table + sizeof(TableHeader);
+        if (static_cast<size_t>(table[0]) != variant_position.index() ||
+            memcmp(walls, position.wall_down.words, WALL_BYTES) != 0 ||
+            memcmp(walls + WALL_BYTES, position.wall_right.words, WALL_BYTES) != 0) {
+            return false;
+        }
+        uint16_t raw;
+        memcpy(&raw, walls + 2 * WALL_BYTES +
+            value_index<Engine>(to_move, position.pawns[0], position.pawns[1]) * sizeof(uint16_t), sizeof(raw));
+        value.result = result_of(raw);
+        value.plies = plies_of(raw);
+        return true;
+    }, variant_position);
+}
@@ -0,0 +1,94 @@
+#include "timer_service.h"
+#include <algorithm>
+#include <thread>
+
+TimerService& TimerService::instance() {
+    // never destroyed, callbacks may still run while detached threads exit
+    static TimerService* service = new TimerService();
+    return *service;
+}
+
+TimerService::TimerService() {
+    Clock::add_waiter(&timer_mutex, &timer_condition);
+    std::thread(&TimerService::run, this).detach();
+}
+
+TimerService::TimerId TimerService::schedule(Clock::time_point deadline, const void* owner,
+                                             std::function<void()> callback) {
+    TimerId id;
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(timer_mutex);
+        id = next_id++;
+        compact();
+        earliest = heap.empty() || deadline < heap.front().deadline;
+        heap.push_back({deadline, id, owner, std::move(callback)});
+        std::push_heap(heap.begin(), heap.end(), std::greater<Entry>());
+        active.emplace(id, owner);
+    }
+    if (earliest) timer_condition.notify_all();
+    return id;
+}
+
+bool TimerService::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(timer_mutex);
+    return active.erase(id) > 0;
+}
+
+void TimerService::cancel_all(const void* owner) {
+    std::unique_lock<std::mutex> lock(timer_mutex);
+    for (auto it = active.begin(); it != active.end();) {
+        it = (it->second == owner) ? active.erase(it) : std::next(it);
+    }
+    if (std::this_thread::get_id() == timer_thread) return;
+    timer_condition.wait(lock, [&]() { return running_owner != owner; });
+}
+
+TimerService::Entry TimerService::pop_earliest() {
+    std::pop_heap(heap.begin(), heap.end(), std::greater<Entry>());
+    Entry entry = std::move(heap.back());
+    heap.pop_back();
+    return entry;
+}
+
+void TimerService::compact() {
+    if (heap.size() < 64 || heap.size() < 2 * active.size()) return;
+    heap.erase(std::remove_if(heap.begin(), heap.end(), [this](const Entry& entry) {
+        return !active.count(entry.id);
+    }), heap.end());
+    std::make_heap(heap.begin(), heap.end(), std::greater<Entry>());
+}
+
+size_t TimerService::pending() const {
+    std::lock_guard<std::mutex> lock(timer_mutex);
+    return heap.size();
+}
+
+void TimerService::run() {
+    std::unique_lock<std::mutex> lock(timer_mutex);
+    timer_thread = std::this_thread::get_id();
+    while (true) {
+        while (!heap.empty() && !active.count(heap.front().id)) {
+            pop_earliest();  // cancelled
+        }
+        if (heap.empty()) {
+            timer_condition.wait(lock);
+            continue;
+        }
+        Clock::time_point deadline = heap.front().deadline;
+        if (Clock::now() < deadline) {
+            Clock::wait_until(lock, timer_condition, deadline, [&]() {
+                return heap.empty() || heap.front().deadline < deadline || Clock::now() >= deadline;
+            });
+            continue;
+        }
+        Entry entry = pop_earliest();
+        active.erase(entry.id);
+        running_owner = entry.owner;
+        lock.unlock();
+        entry.callback();
+        lock.lock();
+        running_owner = nullptr;
+        timer_condition.notify_all();
+    }
+}
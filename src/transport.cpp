@@ -0,0 +1,201 @@
+#include "transport.h"
+#include "clock.h"
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/sockios.h>
+#include <cerrno>
+#include <cstring>
+
+Transport::Transport()
+    : last_receive(Clock::now().time_since_epoch().count()), last_send(Clock::now().time_since_epoch().count()) {}
+
+Clock::time_point Transport::last_receive_time() const {
+    return Clock::time_point(Clock::duration(last_receive.load(std::memory_order_relaxed)));
+}
+
+Clock::time_point Transport::last_send_time() const {
+    return Clock::time_point(Clock::duration(last_send.load(std::memory_order_relaxed)));
+}
+
+void Transport::mark_received() {
+    last_receive.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+void Transport::mark_sent() {
+    last_send.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+}
+
+SocketTransport::SocketTransport(int fd) : fd(fd) {}
+
+SocketTransport::~SocketTransport() {
+    close_transport();
+}
+
+ssize_t SocketTransport::send_bytes(const char* data, size_t length) {
+    std::shared_lock<std::shared_timed_mutex> lock(fd_mutex);
+    if (fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    ssize_t sent = send(fd, data, length, MSG_NOSIGNAL);
+    if (sent > 0) mark_sent();
+    return sent;
+}
+
+ssize_t SocketTransport::receive(char* buffer, size_t length) {
+    std::shared_lock<std::shared_timed_mutex> lock(fd_mutex);
+    if (fd < 0) {
+        errno = EBADF;
+        return -1;
+    }
+    ssize_t received = recv(fd, buffer, length, 0);
+    if (received > 0) mark_received();
+    return received;
+}
+
+void SocketTransport::set_receive_timeout(int seconds) {
+    struct timeval tv{seconds, 0};
+    std::shared_lock<std::shared_timed_mutex> lock(fd_mutex);
+    if (fd < 0) return;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+void SocketTransport::close_transport() {
+    std::unique_lock<std::shared_timed_mutex> lock(fd_mutex, std::defer_lock);
+    if (!lock.try_lock_for(CLOSE_WAIT)) {
+        // a send blocked on a slow client holds the shared lock, shutdown makes it return
+        shutdown_transport();
+        lock.lock();
+    }
+    if (fd >= 0) {
+        close(fd);
+        fd = -1;
+    }
+}
+
+void SocketTransport::shutdown_transport() {
+    std::shared_lock<std::shared_timed_mutex> lock(fd_mutex);
+    if (fd >= 0) {
+        shutdown(fd, SHUT_RDWR);
+    }
+}
+
+int SocketTransport::get_fd() const {
+    std::shared_lock<std::shared_timed_mutex> lock(fd_mutex);
+    return fd;
+}
+
+size_t SocketTransport::outbound_queue() const {
+    std::shared_lock<std::shared_timed_mutex> lock(fd_mutex);
+    int queued = 0;
+    if (fd < 0 || ioctl(fd, SIOCOUTQ, &queued) < 0) return 0;
+    return static_cast<size_t>(queued);
+}
+
+InMemoryTransport::InMemoryTransport() {
+    Clock::add_waiter(&inbox_mutex, &inbox_condition);
+}
+
+InMemoryTransport::~InMemoryTransport() {
+    Clock::remove_waiter(&inbox_mutex, &inbox_condition);
+}
+
+std::pair<std::shared_ptr<InMemoryTransport>, std::shared_ptr<InMemoryTransport>> InMemoryTransport::create_pair() {
+    std::shared_ptr<InMemoryTransport> first(new InMemoryTransport());
+    std::shared_ptr<InMemoryTransport> second(new InMemoryTransport());
+    first->peer = second;
+    second->peer = first;
+    return {first, second};
+}
+
+ssize_t InMemoryTransport::send_bytes(const char* data, size_t length) {
+    auto other = peer.lock();
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex);
+        if (closed) {
+            errno = EPIPE;
+            return -1;
+        }
+    }
+    if (!other || !other->deliver(data, length)) {
+        errno = EPIPE;
+        return -1;
+    }
+    mark_sent();
+    return static_cast<ssize_t>(length);
+}
+
+bool InMemoryTransport::deliver(const char* data, size_t length) {
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex);
+        if (closed) return false;
+        inbox.append(data, length);
+    }
+    inbox_condition.notify_one();
+    return true;
+}
+
+ssize_t InMemoryTransport::read_inbox(char* buffer, size_t length) {
+    size_t count = std::min(length, inbox.size());
+    memcpy(buffer, inbox.data(), count);
+    inbox.erase(0, count);
+    return static_cast<ssize_t>(count);
+}
+
+ssize_t InMemoryTransport::receive(char* buffer, size_t length) {
+    std::unique_lock<std::mutex> lock(inbox_mutex);
+    auto ready = [this]() { return !inbox.empty() || closed; };
+    if (receive_timeout > 0) {
+        if (!Clock::wait_until(lock, inbox_condition, Clock::now() + std::chrono::seconds(receive_timeout), ready)) {
+            errno = EAGAIN;
+            return -1;
+        }
+    } else {
+        inbox_condition.wait(lock, ready);
+    }
+    if (inbox.empty()) return 0; // closed
+    mark_received();
+    return read_inbox(buffer, length);
+}
+
+ssize_t InMemoryTransport::try_receive(char* buffer, size_t length) {
+    std::lock_guard<std::mutex> lock(inbox_mutex);
+    if (inbox.empty()) {
+        if (closed) return 0;
+        errno = EAGAIN;
+        return -1;
+    }
+    mark_received();
+    return read_inbox(buffer, length);
+}
+
+size_t InMemoryTransport::outbound_queue() const {
+    auto other = peer.lock();
+    return other ? other->pending() : 0;
+}
+
+size_t InMemoryTransport::pending() const {
+    std::lock_guard<std::mutex> lock(inbox_mutex);
+    return inbox.size();
+}
+
+void InMemoryTransport::set_receive_timeout(int seconds) {
+    std::lock_guard<std::mutex> lock(inbox_mutex);
+    receive_timeout = seconds;
+}
+
+void InMemoryTransport::close_transport() {
+    mark_closed();
+    if (auto other = peer.lock()) {
+        other->mark_closed();
+    }
+}
+
+void InMemoryTransport::mark_closed() {
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex);
+        closed = true;
+    }
+    inbox_condition.notify_all();
+}
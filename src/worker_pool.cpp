@@ -0,0 +1,208 @@
+#include "worker_pool.h"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <limits.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include "fd_channel.h"
+#include "logger.h"
+#include "metrics.h"
+
+WorkerPool::WorkerPool(size_t count, size_t max_games) : max_games(max_games), workers(count) {
+    char path[PATH_MAX];
+    ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length <= 0) {
+        throw std::runtime_error("Could not find the server executable for the workers");
+    }
+    executable.assign(path, length);
+}
+
+void WorkerPool::start() {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (!spawn(i)) {
+            throw std::runtime_error("Could not start game worker " + std::to_string(i));
+        }
+    }
+}
+
+bool WorkerPool::spawn(size_t index) {
+    int sockets[2];
+    // close-on-exec keeps the channels of the other workers out of this one, the child clears it for its own end
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) < 0) {
+        LOG_ERROR(LogFields(), "Failed to create worker channel: %s", strerror(errno));
+        return false;
+    }
+    timeval timeout{SEND_TIMEOUT_SECONDS, 0};
+    setsockopt(sockets[0], SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    // only async-signal-safe calls between fork and exec, the arguments are built before
+    std::string index_arg = std::to_string(index);
+    std::string channel_arg = std::to_string(sockets[1]);
+    char* argv[] = {&executable[0], const_cast<char*>("--worker"), &index_arg[0], &channel_arg[0], nullptr};
+    pid_t pid = fork();
+    if (pid < 0) {
+        LOG_ERROR(LogFields(), "Failed to start worker %zu: %s", index, strerror(errno));
+        close(sockets[0]);
+        close(sockets[1]);
+        return false;
+    }
+    if (pid == 0) {
+        fcntl(sockets[1], F_SETFD, 0);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(sockets[1]);
+
+    Worker& worker = workers[index];
+    worker.pid = pid;
+    worker.channel = sockets[0];
+    LOG_INFO(LogFields(), "Started game worker %zu (pid %d)", index, pid);
+    std::thread(&WorkerPool::read_reports, this, index, sockets[0]).detach();
+    return true;
+}
+
+bool WorkerPool::send_record(size_t index, const std::vector<std::string>& fields, const std::vector<int>& fds) {
+    Worker& worker = workers[index];
+    if (worker.channel < 0) return false;
+    if (FdChannel::send(worker.channel, encode(fields), fds)) return true;
+    // a partly written record leaves the channel unusable, the reader restarts the worker
+    LOG_ERROR(LogFields(), "Worker %zu does not take records (%s), restarting it", index, strerror(errno));
+    kill(worker.pid, SIGKILL);
+    shutdown(worker.channel, SHUT_RDWR);
+    worker.channel = -1;
+    return false;
+}
+
+bool WorkerPool::dispatch_match(size_t lobby_id, const std::string& variant, const std::string names[2],
+                                const int fds[2]) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    size_t chosen = workers.size();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (workers[i].channel < 0 || workers[i].games >= max_games) continue;
+        if (chosen == workers.size() || workers[i].games < workers[chosen].games) chosen = i;
+    }
+    if (chosen == workers.size()) return false;
+    if (!send_record(chosen, {"match", std::to_string(lobby_id), names[0], names[1], variant}, {fds[0], fds[1]})) return false;
+    workers[chosen].games++;
+    routes[names[0]] = {chosen, lobby_id};
+    routes[names[1]] = {chosen, lobby_id};
+    return true;
+}
+
+bool WorkerPool::route_reconnection(const std::string& name, int fd) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    auto route = routes.find(name);
+    if (route == routes.end()) return false;
+    return send_record(route->second.worker, {"reconnect", name}, {fd});
+}
+
+void WorkerPool::read_reports(size_t index, int channel) {
+    std::string record;
+    std::vector<int> fds;
+    while (FdChannel::receive(channel, record, fds)) {
+        for (int fd : fds) close(fd);  // workers do not send descriptors
+        std::string type = record.substr(0, record.find('\n'));
+        std::vector<std::string> fields = decode(record, type == "status" ? 3 : SIZE_MAX);
+        if (fields.empty()) continue;
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        try {
+            if (fields[0] == "ended" && fields.size() == 2) {
+                size_t lobby_id = std::stoul(fields[1]);
+                for (auto route = routes.begin(); route != routes.end();) {
+                    bool ended = route->second.worker == index && route->second.lobby_id == lobby_id;
+                    route = ended ? routes.erase(route) : std::next(route);
+                }
+            } else if (fields[0] == "forget" && fields.size() == 2) {
+                auto route = routes.find(fields[1]);
+                if (route != routes.end() && route->second.worker == index) routes.erase(route);
+            } else if (fields[0] == "players" && fields.size() % 2 == 1) {
+                for (size_t i = 1; i + 1 < fields.size(); i += 2) {
+                    routes[fields[i + 1]] = {index, std::stoul(fields[i])};
+                }
+            } else if (fields[0] == "status" && fields.size() == 3) {
+                workers[index].games = std::stoul(fields[1]);
+                workers[index].stats = fields[2];
+            }
+        } catch (const std::exception&) {
+            // a bad number in a report must not end the front-end, the next report of the worker corrects it
+            LOG_ERROR(LogFields(), "Malformed report from game worker %zu (%s), dropped", index, fields[0].c_str());
+        }
+    }
+
+    pid_t pid;
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        pid = workers[index].pid;
+        workers[index].channel = -1;
+    }
+    close(channel);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (WIFSIGNALED(status)) {
+        LOG_ERROR(LogFields(), "Game worker %zu (pid %d) was killed by signal %d", index, pid, WTERMSIG(status));
+    } else {
+        LOG_ERROR(LogFields(), "Game worker %zu (pid %d) exited with status %d", index, pid, WEXITSTATUS(status));
+    }
+    Metrics::instance().worker_restarts.add();
+
+    // routes stay, the new worker restores the games of its snapshot and their players reconnect to it
+    std::this_thread::sleep_for(std::chrono::seconds(RESTART_DELAY_SECONDS));
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    workers[index].restarts++;
+    workers[index].games = 0;
+    workers[index].stats.clear();
+    if (!spawn(index)) {
+        LOG_ERROR(LogFields(), "Game worker %zu stays down", index);
+    }
+}
+
+std::string WorkerPool::describe() const {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    std::ostringstream out;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        const Worker& worker = workers[i];
+        size_t players = 0;
+        for (const auto& route : routes) {
+            if (route.second.worker == i) players++;
+        }
+        out << "worker " << i << " pid=" << worker.pid << " state=" << (worker.channel >= 0 ? "running" : "down")
+            << " games=" << worker.games << " routed_players=" << players << " restarts=" << worker.restarts << "\n";
+    }
+    return out.str();
+}
+
+std::string WorkerPool::worker_stats(size_t index) const {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (index >= workers.size()) return "no worker " + std::to_string(index) + "\n";
+    if (workers[index].stats.empty()) return "worker " + std::to_string(index) + " has not reported yet\n";
+    return workers[index].stats;
+}
+
+std::string WorkerPool::encode(const std::vector<std::string>& fields) {
+    std::string record;
+    for (size_t i = 0; i < fields.size(); ++i) {
+        if (i > 0) record += '\n';
+        record += fields[i];
+    }
+    return record;
+}
+
+std::vector<std::string> WorkerPool::decode(const std::string& record, size_t max_fields) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (fields.size() + 1 < max_fields) {
+        size_t end = record.find('\n', start);
+        if (end == std::string::npos) break;
+        fields.push_back(record.substr(start, end - start));
+        start = end + 1;
+    }
+    fields.push_back(record.substr(start));
+    return fields;
+}
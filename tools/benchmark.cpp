@@ -0,0 +1,400 @@
+// Microbenchmarks for the protocol and rules engine hot paths.
+// Every benchmark runs on three positions (empty board, midgame, wall-saturated) and reports ns/op and
+// heap allocations/op. Allocations are taken from the memory accounting of the core library (or counted by
+// replacing the global operator new of this executable when it is built without), so pooled objects only show
+// up when they fall back to the heap.
+//
+// Usage: quoridor_bench [options]
+//   --filter NAME     only run benchmarks whose name contains NAME
+//   --min-time MS     minimum measured time per benchmark and position in milliseconds (default 200)
+// After the table a steady-state check sends pawn moves back and forth through the move path of the server (parse,
+// decode, QuoridorGame::handle_move, snapshot, NEXT_TURN to both players over in-memory connections) and reports the
+// heap allocations per move. It fails with exit code 1 unless that path allocates nothing and the number of live
+// pooled players and games stays the same.
+// Numbers are only meaningful for optimized builds (-DCMAKE_BUILD_TYPE=Release).
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+#include "analysis.h"
+#include "memory_accounting.h"
+#include "message.h"
+#include "move.h"
+#include "player.h"
+#include "quoridor_game.h"
+
+#ifdef QUORIDOR_MEMORY_ACCOUNTING
+namespace {
+uint64_t allocation_count() {
+    return MemoryAccounting::instance().total().allocations;
+}
+}
+#else
+namespace {
+std::atomic<uint64_t> allocations{0};
+
+uint64_t allocation_count() {
+    return allocations.load(std::memory_order_relaxed);
+}
+
+void* counted_allocate(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+}
+
+void* operator new(std::size_t size) { return counted_allocate(size); }
+void* operator new[](std::size_t size) { return counted_allocate(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+#endif
+
+/**
+ * @brief GameBenchmark builds a game position without server, sockets or heartbeat threads
+ * and exposes the private rule checks of QuoridorGame to the benchmarks.
+ */
+class GameBenchmark {
+public:
+    enum class Setup { EMPTY, MIDGAME, SATURATED };
+
+    // connected players get in-memory connections, the bench reads the client ends (see drain_clients)
+    explicit GameBenchmark(Setup setup, bool connected = false) : game(new QuoridorGame()) {
+        for (int i = 0; i < 2; ++i) {
+            std::shared_ptr<InMemoryTransport> server_end;
+            if (connected) {
+                auto connection = InMemoryTransport::create_pair();
+                server_end = connection.first;
+                clients.push_back(connection.second);
+            }
+            players.push_back(new Player(server_end));
+        }
+        players[0]->set_name("alice");
+        players[1]->set_name("bob");
+        game->set_players(players);
+        game->set_lobby_id(1);
+        game->initialize_players();
+        game->initialize_board();
+        game->state = GameState::IN_PROGRESS;
+        game->turn_started = Clock::now();
+
+        if (setup == Setup::MIDGAME) {
+            step(7, 4);
+            step(1, 4);
+            step(6, 4);
+            step(2, 4);
+            place_walls(6);
+        } else if (setup == Setup::SATURATED) {
+            // both players keep one wall, so wall validation still runs the full path check
+            place_walls(18);
+        }
+        probe = find_valid_wall();
+    }
+
+    ~GameBenchmark() {
+        delete game;
+        for (Player* player : players) delete player;
+    }
+
+    QuoridorGame& get_game() { return *game; }
+
+    // A wall the current player is allowed to place in this position
+    const Move& get_probe_wall() const { return probe; }
+
+    // Same check as QuoridorGame::can_move, without the metrics timer
+    bool check_wall(const Move& move) {
+        return game->is_valid_wall_move(move);
+    }
+
+    // A move message as a connection thread handles it: parse the line, decode into the reused Move and play it
+    // through QuoridorGame::handle_move. False if the move was rejected.
+    bool play_line(const std::string& line) {
+        uint32_t turn = game->turn;
+        Message message(line);
+        decoded.decode(message);
+        game->handle_move(decoded);
+        return game->turn == turn + 1;
+    }
+
+    // Read everything the server sent to the clients
+    void drain_clients() {
+        char buffer[4096];
+        for (const auto& client : clients) {
+            while (client->try_receive(buffer, sizeof(buffer)) > 0) {}
+        }
+    }
+
+    // NEXT_TURN as the move path writes it and as built from the message fields (clocks stopped while comparing)
+    std::pair<std::string, std::string> next_turn_texts() {
+        GameState running = game->state;
+        game->state = GameState::ENDED;
+        std::pair<std::string, std::string> texts(*Message::create_next_turn_wire(game),
+                                                   *Message::create_next_turn(game).to_wire());
+        game->state = running;
+        return texts;
+    }
+
+    // Moves that take both pawns one row forward and back again, in turn order (empty board)
+    std::vector<Move> shuttle_moves() const {
+        std::vector<Move> moves;
+        for (int back = 0; back < 2; ++back) {
+            for (int i = 0; i < 2; ++i) {
+                int player = (game->current_player + i) % 2;
+                std::pair<int, int> start = std::visit([&](const auto& position) {
+                    return std::pair<int, int>(std::decay_t<decltype(position)>::Engine::start(player));
+                }, game->rules_position);
+                int forward = (players[player]->get_goal_row() < start.first) ? -1 : 1;
+                moves.emplace_back(false, std::vector<std::pair<int, int>>{
+                    {back ? start.first : start.first + forward, start.second}}, player);
+            }
+        }
+        return moves;
+    }
+
+    bool path_exists() {
+        return std::visit([](const auto& position) {
+            return std::decay_t<decltype(position)>::Engine::has_path(position, 0);
+        }, game->rules_position);
+    }
+
+    // Path lengths, routes and hint as answered to an analysis request (cache miss)
+    Analysis analyze() {
+        return analyze_position(game->rules_position, game->current_player);
+    }
+
+private:
+    QuoridorGame* game;
+    std::vector<Player*> players;
+    std::vector<std::shared_ptr<InMemoryTransport>> clients; // client ends of the player connections (if connected)
+    Move probe{false, {}, 0};
+    Move decoded{false, {}, 0}; // reused by play_line like the Move of a connection thread
+
+    // Wall candidates spread over the board, horizontal and vertical mixed
+    static std::vector<Move> wall_candidates(int player_id) {
+        static const int rows[] = {1, 6, 3, 4, 2, 5, 0, 7};
+        std::vector<Move> candidates;
+        for (int row : rows) {
+            for (int col = 0; col < 8; col += 2) {
+                bool horizontal = ((row + col / 2) % 2) == 0;
+                if (horizontal) {
+                    candidates.emplace_back(true, std::vector<std::pair<int, int>>{{row, col}, {row, col + 1}}, player_id);
+                } else {
+                    candidates.emplace_back(false, std::vector<std::pair<int, int>>{{row, col}, {row + 1, col}}, player_id);
+                }
+            }
+        }
+        return candidates;
+    }
+
+    void step(int row, int col) {
+        game->apply_move(Move(false, {{row, col}}, game->current_player));
+    }
+
+    void place_walls(int count) {
+        int placed = 0;
+        while (placed < count) {
+            bool found = false;
+            for (const Move& candidate : wall_candidates(game->current_player)) {
+                if (check_wall(candidate)) {
+                    game->apply_move(candidate);
+                    found = true;
+                    break;
+                }
+            }
+            if (!found) break;
+            ++placed;
+        }
+    }
+
+    Move find_valid_wall() {
+        for (const Move& candidate : wall_candidates(game->current_player)) {
+            if (check_wall(candidate)) return candidate;
+        }
+        return Move(false, {}, game->current_player);
+    }
+};
+
+namespace {
+
+struct Options {
+    std::string filter;
+    int min_time_ms = 200;
+};
+
+struct Result {
+    double ns_per_op;
+    double allocs_per_op;
+    uint64_t iterations;
+};
+
+// Keeps the compiler from optimizing away a benchmarked result
+template <typename T>
+void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+Result measure(const std::function<void()>& operation, std::chrono::milliseconds min_time) {
+    // warm up thread local buffers and caches before counting
+    for (int i = 0; i < 100; ++i) operation();
+
+    uint64_t iterations = 1000;
+    while (true) {
+        uint64_t allocations_before = allocation_count();
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < iterations; ++i) operation();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        uint64_t allocations = allocation_count() - allocations_before;
+
+        if (elapsed >= min_time || iterations >= (1ull << 32)) {
+            double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+            return {ns / iterations, double(allocations) / iterations, iterations};
+        }
+        iterations *= (elapsed < min_time / 10) ? 10 : 2;
+    }
+}
+
+// Client move message as it arrives on the wire
+std::string move_wire_text(const Move& move) {
+    Message message;
+    message.set_type(MessageType::MOVE);
+    message.set_data("is_horizontal", move.get_is_horizontal() ? "true" : "false");
+    message.set_data("player_id", std::to_string(move.get_player_id()));
+    std::string position;
+    for (const auto& cell : move.get_position()) {
+        if (!position.empty()) position += ",";
+        position += "[" + std::to_string(cell.first) + "," + std::to_string(cell.second) + "]";
+    }
+    message.set_data("position", position);
+    return message.to_string();
+}
+
+void run_position(const char* position_name, GameBenchmark::Setup setup, const Options& options) {
+    GameBenchmark bench(setup);
+    QuoridorGame& game = bench.get_game();
+    const Move& wall = bench.get_probe_wall();
+    const std::string wire_text = move_wire_text(wall);
+    const Message parsed(wire_text);
+    const Message next_turn = Message::create_next_turn(&game);
+    // 1000 watchers without a sender thread, so every update after the first is conflated like for a slow spectator
+    std::vector<std::shared_ptr<Spectator>> spectators;
+    for (int i = 0; i < 1000; ++i) {
+        spectators.push_back(std::make_shared<Spectator>(InMemoryTransport::create_pair().first));
+    }
+
+    std::vector<std::pair<const char*, std::function<void()>>> benchmarks = {
+        {"message_parse", [&] { Message message(wire_text); keep(message); }},
+        {"message_to_string", [&] { std::string text = next_turn.to_string(); keep(text); }},
+        {"move_decode", [&] { Move move(parsed); keep(move); }},
+        {"create_next_turn", [&] { Message message = Message::create_next_turn(&game); keep(message); }},
+        {"next_turn_wire", [&] { WireBuffer wire = Message::create_next_turn_wire(&game); keep(wire); }},
+        {"is_valid_wall_move", [&] { bool valid = bench.check_wall(wall); keep(valid); }},
+        {"has_path", [&] { bool reachable = bench.path_exists(); keep(reachable); }},
+        {"analyze_position", [&] { Analysis analysis = bench.analyze(); keep(analysis); }},
+        {"get_board_string", [&] { std::string board = game.get_board_string(); keep(board); }},
+        {"spectator_fanout", [&] {
+            WireBuffer wire = next_turn.to_wire();
+            for (const auto& spectator : spectators) spectator->publish(wire, MessageType::NEXT_TURN);
+        }},
+    };
+
+    for (const auto& benchmark : benchmarks) {
+        if (!options.filter.empty() && std::string(benchmark.first).find(options.filter) == std::string::npos) continue;
+        Result result = measure(benchmark.second, std::chrono::milliseconds(options.min_time_ms));
+        printf("%-20s %-10s %12.1f %12.2f %14llu\n", benchmark.first, position_name, result.ns_per_op,
+            result.allocs_per_op, (unsigned long long)result.iterations);
+    }
+}
+
+// The move path of a connection thread must not touch the general heap once it is warmed up: parsing and decoding
+// the move, validation, clock and flag-fall timer, snapshot and NEXT_TURN to both players. Pawns shuttle back and
+// forth on an empty board, so the game never ends (wall moves grow the wall lists and are not steady state).
+// Prints the allocations per move and returns false if there are any.
+bool check_steady_state() {
+    GameBenchmark bench(GameBenchmark::Setup::EMPTY, true);
+    std::vector<std::string> lines;
+    for (const Move& move : bench.shuttle_moves()) lines.push_back(move_wire_text(move));
+
+    auto texts = bench.next_turn_texts();
+    if (texts.first != texts.second) {
+        printf("steady-state check FAILED: create_next_turn_wire differs from create_next_turn\n%s%s",
+            texts.first.c_str(), texts.second.c_str());
+        return false;
+    }
+
+    auto play_round = [&]() {
+        for (const std::string& line : lines) {
+            if (!bench.play_line(line)) return false;
+            bench.drain_clients();
+        }
+        return true;
+    };
+
+    // warm up metrics, thread local buffers and the pools before counting
+    for (int i = 0; i < 100; ++i) {
+        if (!play_round()) {
+            printf("steady-state check FAILED: a shuttle move was rejected\n");
+            return false;
+        }
+    }
+
+    const int rounds = 10000;
+    const uint64_t moves = uint64_t(rounds) * lines.size();
+    size_t players_before = Player::live_count();
+    size_t games_before = QuoridorGame::live_count();
+    uint64_t allocations_before = allocation_count();
+    bool played = true;
+    for (int i = 0; i < rounds && played; ++i) played = play_round();
+    uint64_t allocations = allocation_count() - allocations_before;
+
+    if (!played) {
+        printf("steady-state check FAILED: a shuttle move was rejected\n");
+        return false;
+    }
+    printf("steady-state move path: %llu heap allocations in %llu moves (%.3f per move), live players %zu -> %zu, "
+        "live games %zu -> %zu\n", (unsigned long long)allocations, (unsigned long long)moves,
+        double(allocations) / moves, players_before, Player::live_count(), games_before, QuoridorGame::live_count());
+    if (allocations != 0 || Player::live_count() != players_before || QuoridorGame::live_count() != games_before) {
+        printf("steady-state check FAILED\n");
+        return false;
+    }
+    printf("steady-state check passed\n");
+    return true;
+}
+
+void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--filter NAME] [--min-time MS]\n", program);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        if (flag == "--filter") options.filter = argv[i + 1];
+        else if (flag == "--min-time") options.min_time_ms = std::max(1, atoi(argv[i + 1]));
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-20s %-10s %12s %12s %14s\n", "benchmark", "position", "ns/op", "allocs/op", "iterations");
+    run_position("empty", GameBenchmark::Setup::EMPTY, options);
+    run_position("midgame", GameBenchmark::Setup::MIDGAME, options);
+    run_position("saturated", GameBenchmark::Setup::SATURATED, options);
+    return check_steady_state() ? 0 : 1;
+}
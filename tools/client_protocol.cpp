@@ -0,0 +1,144 @@
+#include "client_protocol.h"
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <queue>
+
+std::string get_field(const std::string& message, const std::string& key) {
+    size_t start = message.find(key + "=");
+    if (start == std::string::npos) return "";
+    start += key.size() + 1;
+    size_t end = message.find(';', start);
+    return message.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+std::vector<std::pair<int, int>> parse_pairs(const std::string& value) {
+    std::vector<std::pair<int, int>> pairs;
+    size_t open = value.find('[');
+    while (open != std::string::npos) {
+        size_t close = value.find(']', open);
+        if (close == std::string::npos) break;
+        std::string inner = value.substr(open + 1, close - open - 1);
+        size_t comma = inner.find(',');
+        if (comma != std::string::npos) {
+            pairs.emplace_back(atoi(inner.c_str()), atoi(inner.c_str() + comma + 1));
+        }
+        open = value.find('[', close);
+    }
+    return pairs;
+}
+
+bool parse_position(const std::string& message, const std::string& name, Position& position) {
+    position.current_player_id = get_field(message, "current_player_id");
+    position.horizontal_walls = parse_pairs(get_field(message, "horizontal_walls"));
+    position.vertical_walls = parse_pairs(get_field(message, "vertical_walls"));
+
+    // players=[id:1,row:8,col:4,name:alice,board_char:1,walls_left:10],[...]
+    std::string players = get_field(message, "players");
+    size_t open = players.find('[');
+    while (open != std::string::npos) {
+        size_t close = players.find(']', open);
+        if (close == std::string::npos) break;
+        std::string entry = players.substr(open + 1, close - open - 1);
+        std::map<std::string, std::string> fields;
+        size_t start = 0;
+        while (start < entry.size()) {
+            size_t comma = entry.find(',', start);
+            if (comma == std::string::npos) comma = entry.size();
+            std::string field = entry.substr(start, comma - start);
+            size_t colon = field.find(':');
+            if (colon != std::string::npos) fields[field.substr(0, colon)] = field.substr(colon + 1);
+            start = comma + 1;
+        }
+        if (fields["name"] == name) {
+            position.my_id = fields["id"];
+            position.my_row = atoi(fields["row"].c_str());
+            position.my_col = atoi(fields["col"].c_str());
+            position.walls_left = atoi(fields["walls_left"].c_str());
+            position.goal_row = (position.my_id == "1") ? 0 : BOARD_SIZE - 1;
+            return true;
+        }
+        open = players.find('[', close);
+    }
+    return false;
+}
+
+bool contains(const std::vector<std::pair<int, int>>& walls, int row, int col) {
+    return std::find(walls.begin(), walls.end(), std::make_pair(row, col)) != walls.end();
+}
+
+bool is_wall_between(const Position& position, int row1, int col1, int row2, int col2) {
+    if (row1 == row2 && contains(position.vertical_walls, row1, std::min(col1, col2))) return true;
+    if (col1 == col2 && contains(position.horizontal_walls, std::min(row1, row2), col1)) return true;
+    return false;
+}
+
+std::vector<std::pair<int, int>> legal_steps(const Position& position, int row, int col) {
+    static const int dr[] = {-1, 0, 1, 0};
+    static const int dc[] = {0, 1, 0, -1};
+    std::vector<std::pair<int, int>> steps;
+    for (int i = 0; i < 4; ++i) {
+        int r = row + dr[i], c = col + dc[i];
+        if (r < 0 || r >= BOARD_SIZE || c < 0 || c >= BOARD_SIZE) continue;
+        if (is_wall_between(position, row, col, r, c)) continue;
+        steps.emplace_back(r, c);
+    }
+    return steps;
+}
+
+std::pair<int, int> shortest_path_step(const Position& position) {
+    int parent[BOARD_SIZE][BOARD_SIZE];
+    bool visited[BOARD_SIZE][BOARD_SIZE] = {};
+    std::queue<std::pair<int, int>> queue;
+    queue.push({position.my_row, position.my_col});
+    visited[position.my_row][position.my_col] = true;
+    while (!queue.empty()) {
+        auto current = queue.front();
+        queue.pop();
+        if (current.first == position.goal_row) {
+            // walk back to the cell next to the start
+            while (parent[current.first][current.second] != position.my_row * BOARD_SIZE + position.my_col) {
+                int p = parent[current.first][current.second];
+                current = {p / BOARD_SIZE, p % BOARD_SIZE};
+            }
+            return current;
+        }
+        for (auto next : legal_steps(position, current.first, current.second)) {
+            if (visited[next.first][next.second]) continue;
+            visited[next.first][next.second] = true;
+            parent[next.first][next.second] = current.first * BOARD_SIZE + current.second;
+            queue.push(next);
+        }
+    }
+    auto steps = legal_steps(position, position.my_row, position.my_col);
+    return steps.empty() ? std::make_pair(position.my_row, position.my_col) : steps.front();
+}
+
+std::string make_move(const Position& position, int player_index, bool scripted, bool allow_wall, std::mt19937& rng) {
+    std::string prefix = "type:move|data:is_horizontal=";
+    std::string player = ";player_id=" + std::to_string(player_index) + ";position=";
+
+    if (!scripted && allow_wall && position.walls_left > 0 && rng() % 8 == 0) {
+        // random wall, the server rejects illegal ones and we answer the error with a pawn move
+        bool horizontal = rng() % 2 == 0;
+        int row = rng() % (BOARD_SIZE - 1);
+        int col = rng() % (BOARD_SIZE - 1);
+        std::string cells = horizontal
+            ? "[" + std::to_string(row) + "," + std::to_string(col) + "],[" + std::to_string(row) + "," + std::to_string(col + 1) + "]"
+            : "[" + std::to_string(row) + "," + std::to_string(col) + "],[" + std::to_string(row + 1) + "," + std::to_string(col) + "]";
+        return prefix + (horizontal ? "true" : "false") + player + cells + ";\n";
+    }
+
+    std::pair<int, int> target;
+    auto steps = legal_steps(position, position.my_row, position.my_col);
+    if (scripted && position.my_id == "1" && position.my_row == BOARD_SIZE - 1 && position.my_col > BOARD_SIZE / 2 - 2) {
+        // players start in the same column and send each other home when they collide,
+        // in scripted games the first player walks up a different column so every game ends
+        target = {position.my_row, position.my_col - 1};
+    } else if (scripted || steps.empty() || rng() % 10 < 7) {
+        target = shortest_path_step(position);
+    } else {
+        target = steps[rng() % steps.size()];
+    }
+    return prefix + "false" + player + "[" + std::to_string(target.first) + "," + std::to_string(target.second) + "];\n";
+}
@@ -0,0 +1,37 @@
+#pragma once
+// Client side of the text protocol shared by the load generator and the simulation harness:
+// parsing next_turn updates and choosing legal moves for the pawn.
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+constexpr int BOARD_SIZE = 9;
+
+// Game position as seen by a client (parsed from next_turn)
+struct Position {
+    std::string my_id;
+    std::string current_player_id;
+    int my_row = 0, my_col = 0;
+    int goal_row = 0;
+    int walls_left = 0;
+    std::vector<std::pair<int, int>> horizontal_walls;
+    std::vector<std::pair<int, int>> vertical_walls;
+};
+
+// Value of key in a protocol message ("" if missing)
+std::string get_field(const std::string& message, const std::string& key);
+// Parse "[r,c],[r,c],..." into pairs
+std::vector<std::pair<int, int>> parse_pairs(const std::string& value);
+// Parse next_turn/game_started for the player with the given name
+bool parse_position(const std::string& message, const std::string& name, Position& position);
+// Check if the wall list contains the cell
+bool contains(const std::vector<std::pair<int, int>>& walls, int row, int col);
+// Same wall semantics as QuoridorGame::is_wall_between
+bool is_wall_between(const Position& position, int row1, int col1, int row2, int col2);
+// Pawn steps from the cell that stay on the board and do not cross a wall
+std::vector<std::pair<int, int>> legal_steps(const Position& position, int row, int col);
+// First step of a shortest path to the goal row (bfs), falls back to any legal step
+std::pair<int, int> shortest_path_step(const Position& position);
+// Build the move message for our turn (scripted = shortest path only, allow_wall = random walls in random mode)
+std::string make_move(const Position& position, int player_index, bool scripted, bool allow_wall, std::mt19937& rng);
@@ -0,0 +1,121 @@
+#include "journal_reader.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+namespace {
+// Collect the events of one mapped segment, stops at the first torn or corrupted record
+void index_segment(const Segment& segment, uint32_t segment_number, std::vector<EventRef>& out) {
+    const char* data = segment.file.data;
+    size_t size = segment.file.size;
+    if (size < Journal::SEGMENT_HEADER_SIZE || memcmp(data, Journal::SEGMENT_MAGIC, sizeof(Journal::SEGMENT_MAGIC)) != 0) {
+        fprintf(stderr, "%s: not a journal segment\n", segment.path.c_str());
+        return;
+    }
+    size_t offset = Journal::SEGMENT_HEADER_SIZE;
+    JournalEvent event;
+    while (offset < size) {
+        size_t record_size = Journal::decode(data + offset, size - offset, event);
+        if (record_size == 0) {
+            fprintf(stderr, "%s: torn or corrupted record at offset %zu, rest of the segment skipped\n",
+                segment.path.c_str(), offset);
+            break;
+        }
+        out.push_back({event.game_id, segment_number, static_cast<uint32_t>(offset), event.sequence});
+        offset += record_size;
+    }
+}
+}
+
+std::vector<Segment> list_segments(const std::string& directory) {
+    std::vector<std::pair<unsigned, std::string>> names;
+    if (DIR* dir = opendir(directory.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            unsigned index = 0;
+            if (sscanf(entry->d_name, "journal_%u.qj", &index) == 1) {
+                names.emplace_back(index, entry->d_name);
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(names.begin(), names.end());
+
+    std::vector<Segment> segments(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        segments[i].path = directory + "/" + names[i].second;
+        struct stat info{};
+        if (stat(segments[i].path.c_str(), &info) == 0) segments[i].size = info.st_size;
+    }
+    return segments;
+}
+
+uint64_t total_size(const std::vector<Segment>& segments) {
+    uint64_t total = 0;
+    for (const auto& segment : segments) total += segment.size;
+    return total;
+}
+
+std::vector<EventRef> build_index(std::vector<Segment>& segments, int thread_count) {
+    std::vector<std::vector<EventRef>> partial(segments.size());
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < thread_count; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < segments.size(); i = next++) {
+                if (!segments[i].file.map(segments[i].path, true)) continue;
+                partial[i].reserve(segments[i].file.size / 24);
+                index_segment(segments[i], static_cast<uint32_t>(i), partial[i]);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    size_t total = 0;
+    for (const auto& events : partial) total += events.size();
+    std::vector<EventRef> index;
+    index.reserve(total);
+    for (auto& events : partial) {
+        index.insert(index.end(), events.begin(), events.end());
+        std::vector<EventRef>().swap(events);
+    }
+    std::sort(index.begin(), index.end());
+    return index;
+}
+
+std::vector<std::pair<size_t, size_t>> split_games(const std::vector<EventRef>& index) {
+    std::vector<std::pair<size_t, size_t>> games;
+    size_t begin = 0;
+    for (size_t i = 1; i <= index.size(); ++i) {
+        if (i == index.size() || index[i].game_id != index[begin].game_id || index[i].sequence == 0) {
+            if (i > begin) games.emplace_back(begin, i);
+            begin = i;
+        }
+    }
+    return games;
+}
+
+void load_game_events(const std::vector<Segment>& segments, const EventRef* begin, const EventRef* end,
+                      std::vector<JournalEvent>& events) {
+    events.clear();
+    for (const EventRef* ref = begin; ref != end; ++ref) {
+        const MappedFile& file = segments[ref->segment].file;
+        JournalEvent event;
+        if (Journal::decode(file.data + ref->offset, file.size - ref->offset, event)) {
+            events.push_back(event);
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const JournalEvent& a, const JournalEvent& b) {
+        return a.sequence < b.sequence;
+    });
+}
+
+Variant game_variant(const std::vector<JournalEvent>& events) {
+    for (const JournalEvent& event : events) {
+        if (event.type == JournalEventType::GAME_START) return static_cast<Variant>(event.flags);
+    }
+    return Variant::STANDARD;
+}
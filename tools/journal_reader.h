@@ -0,0 +1,45 @@
+#pragma once
+// Journal segment reading shared by the offline tools (replay and analytics, tablebase and opening book builders):
+// segments are memory mapped and indexed in parallel, events are grouped into games by game id.
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "journal.h"
+#include "mapped_file.h"
+#include "rules.h"
+
+struct Segment {
+    std::string path;
+    uint64_t size = 0;
+    MappedFile file;
+};
+
+// Location of one journaled event, the replay index file is a sorted array of these
+struct EventRef {
+    uint32_t game_id;
+    uint32_t segment; // position of the segment in the sorted segment list
+    uint32_t offset; // record offset inside the segment
+    uint32_t sequence; // event sequence within its game
+
+    bool operator<(const EventRef& other) const {
+        if (game_id != other.game_id) return game_id < other.game_id;
+        if (segment != other.segment) return segment < other.segment;
+        return offset < other.offset;
+    }
+};
+
+// Segments of a journal directory in write order (not mapped yet)
+std::vector<Segment> list_segments(const std::string& directory);
+// Total size of the segments in bytes
+uint64_t total_size(const std::vector<Segment>& segments);
+// Map all segments and build the sorted event index, one segment per task on all threads
+std::vector<EventRef> build_index(std::vector<Segment>& segments, int thread_count);
+// Split the index into games: consecutive events of one id, a new game starts at sequence 0
+// (ids are reused after a server restart, the restarted server writes into later segments)
+std::vector<std::pair<size_t, size_t>> split_games(const std::vector<EventRef>& index);
+// Decode the events of one game from the mapped segments, ordered by sequence
+void load_game_events(const std::vector<Segment>& segments, const EventRef* begin, const EventRef* end,
+                      std::vector<JournalEvent>& events);
+// Variant of a game from its start event (older journals have 0, the standard board)
+Variant game_variant(const std::vector<JournalEvent>& events);
@@ -0,0 +1,428 @@
+// Replay and analytics reader for game journals.
+// Segments are memory mapped and indexed in parallel (one segment per task), events are grouped into games by
+// game id and every game is re-simulated through the QuoridorGame rules on all cores. The scan reports opening
+// frequencies, game length, wall usage, win rate of the first mover and the scan throughput in games/sec.
+//
+// A game can also be fetched by id. The index (game id, segment, offset of every event) is stored sorted in
+// <journal dir>/journal.idx, so a lookup is a binary search in the mapped index plus one read per event.
+// The index file is rebuilt whenever the segments changed since it was written.
+//
+// Usage: quoridor_replay scan <journal dir> [--threads N] [--openings N]
+//        quoridor_replay game <journal dir> <game id>
+//        quoridor_replay index <journal dir>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "journal.h"
+#include "journal_reader.h"
+#include "mapped_file.h"
+#include "move.h"
+#include "player.h"
+#include "quoridor_game.h"
+
+namespace {
+
+constexpr char INDEX_MAGIC[8] = {'Q', 'J', 'I', 'N', 'D', 'E', 'X', '1'};
+constexpr const char* INDEX_FILE = "journal.idx";
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t segment_count; // segments covered by the index
+    uint32_t reserved;
+    uint64_t segment_bytes; // total size of the covered segments (detects appended data)
+    uint64_t entry_count;
+};
+
+// Aggregated results of replayed games, every worker fills its own copy
+struct ScanStats {
+    uint64_t games = 0;
+    uint64_t complete = 0; // games with a recorded end
+    uint64_t events = 0;
+    uint64_t moves = 0; // moves of complete games
+    uint64_t walls[2] = {0, 0}; // walls placed in complete games, per player
+    uint64_t decided_by_goal = 0;
+    uint64_t first_mover_wins = 0; // goal wins of the player that moved first
+    uint64_t ended_by_disconnect = 0;
+    uint64_t ended_by_operator = 0;
+    uint64_t ended_by_timeout = 0;
+    uint64_t disconnects = 0;
+    uint64_t reconnects = 0;
+    uint64_t illegal_moves = 0; // journaled moves the rules engine rejects
+    uint64_t winner_mismatches = 0; // recorded winner differs from the replayed result
+    std::unordered_map<std::string, uint64_t> openings;
+
+    void merge(const ScanStats& other) {
+        games += other.games;
+        complete += other.complete;
+        events += other.events;
+        moves += other.moves;
+        walls[0] += other.walls[0];
+        walls[1] += other.walls[1];
+        decided_by_goal += other.decided_by_goal;
+        first_mover_wins += other.first_mover_wins;
+        ended_by_disconnect += other.ended_by_disconnect;
+        ended_by_operator += other.ended_by_operator;
+        ended_by_timeout += other.ended_by_timeout;
+        disconnects += other.disconnects;
+        reconnects += other.reconnects;
+        illegal_moves += other.illegal_moves;
+        winner_mismatches += other.winner_mismatches;
+        for (const auto& opening : other.openings) openings[opening.first] += opening.second;
+    }
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string describe_move(const JournalEvent& event) {
+    char text[32];
+    if (event.flags & JOURNAL_MOVE_WALL) {
+        snprintf(text, sizeof(text), "%c%u,%u-%u,%u", (event.flags & JOURNAL_MOVE_HORIZONTAL) ? 'H' : 'V',
+            event.cells[0], event.cells[1], event.cells[2], event.cells[3]);
+    } else {
+        snprintf(text, sizeof(text), "P%u,%u", event.cells[0], event.cells[1]);
+    }
+    return text;
+}
+
+Move to_move(const JournalEvent& event) {
+    std::vector<std::pair<int, int>> cells{{event.cells[0], event.cells[1]}};
+    if (event.flags & JOURNAL_MOVE_WALL) cells.emplace_back(event.cells[2], event.cells[3]);
+    return Move((event.flags & JOURNAL_MOVE_HORIZONTAL) != 0, cells, event.player);
+}
+
+/**
+ * @brief Re-simulates journaled games through the rules engine (one instance per worker thread).
+ */
+class GameReplayer {
+public:
+    GameReplayer() : players{new Player(nullptr), new Player(nullptr)} {}
+    ~GameReplayer() {
+        delete players[0];
+        delete players[1];
+    }
+
+    // Decode the events of one game (ordered by sequence) from the mapped segments
+    void load(const std::vector<Segment>& segments, const EventRef* begin, const EventRef* end) {
+        load_game_events(segments, begin, end, events);
+    }
+
+    // Replay the loaded game and add it to stats, print_events writes every event to stdout
+    void replay(ScanStats& stats, int opening_plies, bool print_events) {
+        QuoridorGame game(game_variant(events));
+        game.start_replay(players[0], players[1]);
+        bool complete = false;
+        int recorded_winner = -1;
+        uint8_t end_reason = JOURNAL_END_GOAL;
+        uint64_t moves = 0;
+        uint64_t walls[2] = {0, 0};
+        std::string opening;
+
+        stats.games++;
+        stats.events += events.size();
+        for (const JournalEvent& event : events) {
+            if (print_events) print_event(event);
+            switch (event.type) {
+                case JournalEventType::MOVE: {
+                    if (!game.replay_move(to_move(event))) {
+                        stats.illegal_moves++;
+                        if (print_events) printf("    ^ rejected by the rules engine\n");
+                        break;
+                    }
+                    if (static_cast<int>(moves) < opening_plies) {
+                        if (!opening.empty()) opening += ' ';
+                        opening += describe_move(event);
+                    }
+                    moves++;
+                    if ((event.flags & JOURNAL_MOVE_WALL) && event.player < 2) walls[event.player]++;
+                    break;
+                }
+                case JournalEventType::DISCONNECT:
+                    stats.disconnects++;
+                    break;
+                case JournalEventType::RECONNECT:
+                    stats.reconnects++;
+                    break;
+                case JournalEventType::GAME_END:
+                    complete = true;
+                    recorded_winner = event.player;
+                    end_reason = event.flags;
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (!complete) return;
+
+        stats.complete++;
+        stats.moves += moves;
+        stats.walls[0] += walls[0];
+        stats.walls[1] += walls[1];
+        if (static_cast<int>(moves) >= opening_plies && opening_plies > 0) stats.openings[opening]++;
+        if (end_reason == JOURNAL_END_DISCONNECT) {
+            stats.ended_by_disconnect++;
+            return;
+        }
+        if (end_reason == JOURNAL_END_OPERATOR) {
+            stats.ended_by_operator++;
+            return;
+        }
+        if (end_reason == JOURNAL_END_TIMEOUT) {
+            stats.ended_by_timeout++;
+            return;
+        }
+        stats.decided_by_goal++;
+        // the player that made the last move won, player 0 always moves first
+        int replayed_winner = (game.get_state() == GameState::ENDED) ? 1 - game.get_current_player() : -1;
+        if (replayed_winner != recorded_winner) stats.winner_mismatches++;
+        if (recorded_winner == 0) stats.first_mover_wins++;
+    }
+
+private:
+    Player* players[2];
+    std::vector<JournalEvent> events;
+
+    static void print_event(const JournalEvent& event) {
+        static const char* type_names[] = {"?", "start", "move", "disconnect", "reconnect", "end"};
+        uint8_t type = static_cast<uint8_t>(event.type);
+        printf("  #%-4u %lld.%06lld %-10s", event.sequence, (long long)(event.timestamp_us / 1000000),
+            (long long)(event.timestamp_us % 1000000), type_names[type <= 5 ? type : 0]);
+        switch (event.type) {
+            case JournalEventType::GAME_START:
+                printf(" %s vs %s (%s)\n", event.names[0], event.names[1],
+                    variant_info(static_cast<Variant>(event.flags)).name);
+                break;
+            case JournalEventType::MOVE:
+                printf(" player %u %s\n", event.player + 1, describe_move(event).c_str());
+                break;
+            case JournalEventType::DISCONNECT:
+                printf(" player %u%s\n", event.player + 1, (event.flags & JOURNAL_DISCONNECT_PERMANENT) ? " (permanent)" : "");
+                break;
+            case JournalEventType::RECONNECT:
+                printf(" player %u\n", event.player + 1);
+                break;
+            case JournalEventType::GAME_END:
+                if (event.flags == JOURNAL_END_OPERATOR) {
+                    printf(" ended by operator\n");
+                } else {
+                    const char* reason = event.flags == JOURNAL_END_DISCONNECT ? "disconnect"
+                                       : event.flags == JOURNAL_END_TIMEOUT ? "time" : "goal";
+                    printf(" winner player %u (%s)\n", event.player + 1, reason);
+                }
+                break;
+        }
+    }
+};
+
+int run_scan(const std::string& directory, int thread_count, int opening_plies) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Segment> segments = list_segments(directory);
+    if (segments.empty()) {
+        fprintf(stderr, "No journal segments in %s\n", directory.c_str());
+        return 1;
+    }
+    std::vector<EventRef> index = build_index(segments, thread_count);
+    std::vector<std::pair<size_t, size_t>> games = split_games(index);
+    double index_seconds = seconds_since(start);
+
+    auto replay_start = std::chrono::steady_clock::now();
+    std::vector<ScanStats> partial(thread_count);
+    std::atomic<size_t> next{0};
+    constexpr size_t CHUNK = 256; // games taken by a worker at once
+    std::vector<std::thread> workers;
+    for (int t = 0; t < thread_count; ++t) {
+        workers.emplace_back([&, t]() {
+            GameReplayer replayer;
+            for (size_t first = next.fetch_add(CHUNK); first < games.size(); first = next.fetch_add(CHUNK)) {
+                size_t last = std::min(first + CHUNK, games.size());
+                for (size_t g = first; g < last; ++g) {
+                    replayer.load(segments, index.data() + games[g].first, index.data() + games[g].second);
+                    replayer.replay(partial[t], opening_plies, false);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double replay_seconds = seconds_since(replay_start);
+    double scan_seconds = seconds_since(start);
+
+    ScanStats stats;
+    for (const auto& part : partial) stats.merge(part);
+
+    double megabytes = total_size(segments) / (1024.0 * 1024.0);
+    printf("Replayed %llu games (%llu complete) from %zu segments, %llu events, %.1f MB, %d threads\n",
+        (unsigned long long)stats.games, (unsigned long long)stats.complete, segments.size(),
+        (unsigned long long)stats.events, megabytes, thread_count);
+    printf("  scan time           %.3f s (index %.3f s, replay %.3f s)\n", scan_seconds, index_seconds, replay_seconds);
+    printf("  throughput          %.0f games/sec, %.0f events/sec, %.1f MB/sec\n", stats.games / scan_seconds,
+        stats.events / scan_seconds, megabytes / scan_seconds);
+    if (stats.complete > 0) {
+        printf("  average length      %.1f moves\n", double(stats.moves) / stats.complete);
+        printf("  walls per game      %.2f (player 1 %.2f, player 2 %.2f)\n",
+            double(stats.walls[0] + stats.walls[1]) / stats.complete, double(stats.walls[0]) / stats.complete,
+            double(stats.walls[1]) / stats.complete);
+    }
+    if (stats.decided_by_goal > 0) {
+        printf("  first mover wins    %.1f%% of %llu games decided on the board\n",
+            100.0 * stats.first_mover_wins / stats.decided_by_goal, (unsigned long long)stats.decided_by_goal);
+    }
+    printf("  ended by disconnect %llu\n", (unsigned long long)stats.ended_by_disconnect);
+    printf("  ended by operator   %llu\n", (unsigned long long)stats.ended_by_operator);
+    printf("  lost on time        %llu\n", (unsigned long long)stats.ended_by_timeout);
+    printf("  disconnects         %llu (reconnects %llu)\n", (unsigned long long)stats.disconnects,
+        (unsigned long long)stats.reconnects);
+    printf("  replay mismatches   %llu illegal moves, %llu winner mismatches\n",
+        (unsigned long long)stats.illegal_moves, (unsigned long long)stats.winner_mismatches);
+
+    if (opening_plies > 0 && !stats.openings.empty()) {
+        std::vector<std::pair<uint64_t, std::string>> openings;
+        for (const auto& opening : stats.openings) openings.emplace_back(opening.second, opening.first);
+        std::sort(openings.begin(), openings.end(), [](const auto& a, const auto& b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        });
+        printf("Top openings (first %d moves):\n", opening_plies);
+        for (size_t i = 0; i < openings.size() && i < 10; ++i) {
+            printf("  %8llu  %s\n", (unsigned long long)openings[i].first, openings[i].second.c_str());
+        }
+    }
+    return 0;
+}
+
+// Write the index atomically (temporary file and rename)
+bool write_index(const std::string& directory, const std::vector<Segment>& segments, const std::vector<EventRef>& index) {
+    IndexHeader header{};
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.segment_count = static_cast<uint32_t>(segments.size());
+    header.segment_bytes = total_size(segments);
+    header.entry_count = index.size();
+
+    std::string path = directory + "/" + INDEX_FILE;
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(index.data(), sizeof(EventRef), index.size(), file) == index.size();
+    ok = (fclose(file) == 0) && ok;
+    return ok && rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+bool index_is_current(const MappedFile& file, const std::vector<Segment>& segments) {
+    if (file.size < sizeof(IndexHeader)) return false;
+    IndexHeader header;
+    memcpy(&header, file.data, sizeof(header));
+    return memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+        header.segment_count == segments.size() && header.segment_bytes == total_size(segments) &&
+        file.size == sizeof(IndexHeader) + header.entry_count * sizeof(EventRef);
+}
+
+int run_index(const std::string& directory, int thread_count) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Segment> segments = list_segments(directory);
+    std::vector<EventRef> index = build_index(segments, thread_count);
+    if (!write_index(directory, segments, index)) {
+        fprintf(stderr, "Cannot write %s/%s\n", directory.c_str(), INDEX_FILE);
+        return 1;
+    }
+    printf("Indexed %zu events of %zu segments in %.3f s\n", index.size(), segments.size(), seconds_since(start));
+    return 0;
+}
+
+int run_game(const std::string& directory, uint32_t game_id, int thread_count) {
+    std::vector<Segment> segments = list_segments(directory);
+    std::string index_path = directory + "/" + INDEX_FILE;
+    MappedFile index_file;
+    if (!index_file.map(index_path, false) || !index_is_current(index_file, segments)) {
+        index_file.unmap();
+        if (run_index(directory, thread_count) != 0 || !index_file.map(index_path, false)) return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    IndexHeader header;
+    memcpy(&header, index_file.data, sizeof(header));
+    const EventRef* entries = reinterpret_cast<const EventRef*>(index_file.data + sizeof(IndexHeader));
+    const EventRef* end = entries + header.entry_count;
+    const EventRef key{game_id, 0, 0, 0};
+    const EventRef* first = std::lower_bound(entries, end, key);
+    const EventRef* last = first;
+    while (last != end && last->game_id == game_id) ++last;
+    if (first == last) {
+        printf("Game %u not found (%llu indexed events)\n", game_id, (unsigned long long)header.entry_count);
+        return 1;
+    }
+    for (const EventRef* ref = first; ref != last; ++ref) {
+        Segment& segment = segments[ref->segment];
+        if (!segment.file.data && !segment.file.map(segment.path, false)) {
+            fprintf(stderr, "Cannot map %s\n", segment.path.c_str());
+            return 1;
+        }
+    }
+    double lookup_us = seconds_since(start) * 1e6;
+
+    // a reused id (server restart) shows up as several games
+    GameReplayer replayer;
+    ScanStats stats;
+    for (const EventRef* begin = first; begin != last;) {
+        const EventRef* game_end = begin + 1;
+        while (game_end != last && game_end->sequence != 0) ++game_end;
+        replayer.load(segments, begin, game_end);
+        printf("Game %u (%zu events)\n", game_id, static_cast<size_t>(game_end - begin));
+        replayer.replay(stats, 0, true);
+        begin = game_end;
+    }
+    printf("Lookup %.1f us, replay: %llu illegal moves, %llu winner mismatches\n", lookup_us,
+        (unsigned long long)stats.illegal_moves, (unsigned long long)stats.winner_mismatches);
+    return 0;
+}
+
+void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s scan <journal dir> [--threads N] [--openings N]\n", program);
+    fprintf(stderr, "       %s game <journal dir> <game id>\n", program);
+    fprintf(stderr, "       %s index <journal dir>\n", program);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    std::string command = argv[1];
+    std::string directory = argv[2];
+    int thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    if (command == "scan") {
+        int opening_plies = 4;
+        for (int i = 3; i + 1 < argc; i += 2) {
+            std::string flag = argv[i];
+            if (flag == "--threads") thread_count = std::max(1, atoi(argv[i + 1]));
+            else if (flag == "--openings") opening_plies = std::max(0, atoi(argv[i + 1]));
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+        if (argc % 2 == 0) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return run_scan(directory, thread_count, opening_plies);
+    }
+    if (command == "index" && argc == 3) {
+        return run_index(directory, thread_count);
+    }
+    if (command == "game" && argc == 4) {
+        return run_game(directory, static_cast<uint32_t>(strtoul(argv[3], nullptr, 10)), thread_count);
+    }
+    print_usage(argv[0]);
+    return 1;
+}
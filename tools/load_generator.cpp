@@ -0,0 +1,344 @@
+// Protocol level load generator for the Quoridor server.
+// Opens many client connections, plays complete games over the text protocol and reports
+// connections/sec, moves/sec and move -> next_turn latency percentiles.
+//
+// Usage: quoridor_loadgen <address> <port> [options]
+//   --connections N   number of concurrent clients (default 1000)
+//   --threads N       number of client threads (default 4)
+//   --duration S      test duration in seconds (default 30)
+//   --mode M          random (biased random walk with occasional walls) or scripted (shortest path) (default random)
+//   --seed N          random seed (default 1)
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "client_protocol.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr int HEARTBEAT_INTERVAL = 5; // seconds, same as the server
+constexpr int RETRY_DELAY_MS = 200; // delay before a failed client reconnects
+
+struct Options {
+    std::string address;
+    int port = 0;
+    int connections = 1000;
+    int threads = 4;
+    int duration = 30;
+    bool scripted = false;
+    unsigned seed = 1;
+};
+
+// Counters shared by all client threads
+struct Stats {
+    std::atomic<uint64_t> connections{0}; // completed handshakes (name request answered)
+    std::atomic<uint64_t> failed_connections{0}; // connect errors and unexpected closes
+    std::atomic<uint64_t> games_started{0};
+    std::atomic<uint64_t> games_finished{0};
+    std::atomic<uint64_t> moves{0}; // moves answered by next_turn / game_ended
+    std::atomic<uint64_t> errors{0}; // error messages from the server
+    std::mutex latency_mutex;
+    std::vector<uint32_t> latencies_us; // move -> next_turn latencies of all threads
+};
+
+enum class ClientState { CONNECTING, HANDSHAKE, WAITING, PLAYING, DONE };
+
+struct Client {
+    int socket = -1;
+    ClientState state = ClientState::CONNECTING;
+    std::string name;
+    std::string inbound; // received bytes not yet split into messages
+    std::string my_id; // "1" or "2" once the game started
+    bool move_pending = false; // we sent a move and wait for the next update
+    Position last_position; // position from the last next_turn (used to answer a rejected wall)
+    Clock::time_point move_sent;
+    Clock::time_point last_sent;
+    Clock::time_point retry_at; // when a failed client reconnects (socket is -1 until then)
+};
+
+
+class ClientThread {
+public:
+    ClientThread(const Options& options, Stats& stats, int thread_index, int clients)
+        : options(options), stats(stats), thread_index(thread_index), clients(clients),
+          rng(options.seed * 7919 + thread_index) {}
+
+    void run(Clock::time_point end_time) {
+        std::vector<Client> pool(clients);
+        for (auto& client : pool) open_client(client);
+
+        std::vector<pollfd> fds(pool.size());
+        while (Clock::now() < end_time) {
+            for (size_t i = 0; i < pool.size(); ++i) {
+                fds[i].fd = pool[i].socket;
+                fds[i].events = (pool[i].state == ClientState::CONNECTING) ? POLLOUT : POLLIN;
+                fds[i].revents = 0;
+            }
+            poll(fds.data(), fds.size(), 100);
+
+            auto now = Clock::now();
+            for (size_t i = 0; i < pool.size(); ++i) {
+                Client& client = pool[i];
+                if (client.socket < 0) {
+                    if (now >= client.retry_at) open_client(client);
+                    continue;
+                }
+                if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                    fail_client(client);
+                    continue;
+                }
+                if (client.state == ClientState::CONNECTING && (fds[i].revents & POLLOUT)) {
+                    client.state = ClientState::HANDSHAKE;
+                } else if (fds[i].revents & POLLIN) {
+                    if (!read_client(client)) {
+                        if (client.state == ClientState::DONE) {
+                            restart_client(client);
+                        } else {
+                            fail_client(client);
+                        }
+                        continue;
+                    }
+                }
+                if (client.state == ClientState::DONE) {
+                    restart_client(client);
+                    continue;
+                }
+                // keep idle connections alive (clients waiting for an opponent)
+                if (client.state != ClientState::CONNECTING && now - client.last_sent > std::chrono::seconds(HEARTBEAT_INTERVAL)) {
+                    send_line(client, "type:heartbeat|data:;\n");
+                }
+            }
+        }
+        for (auto& client : pool) {
+            if (client.socket >= 0) close(client.socket);
+        }
+
+        std::lock_guard<std::mutex> lock(stats.latency_mutex);
+        stats.latencies_us.insert(stats.latencies_us.end(), latencies_us.begin(), latencies_us.end());
+    }
+
+private:
+    const Options& options;
+    Stats& stats;
+    int thread_index;
+    int clients;
+    int next_name = 0;
+    std::mt19937 rng;
+    std::vector<uint32_t> latencies_us; // local samples, merged at the end
+
+    void open_client(Client& client) {
+        client = Client();
+        client.name = "lg" + std::to_string(getpid()) + "_" + std::to_string(thread_index) + "_" + std::to_string(next_name++);
+        client.last_sent = Clock::now();
+        client.socket = socket(AF_INET, SOCK_STREAM, 0);
+        int flag = 1;
+        setsockopt(client.socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+        fcntl(client.socket, F_SETFL, fcntl(client.socket, F_GETFL, 0) | O_NONBLOCK);
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(options.port);
+        inet_pton(AF_INET, options.address.c_str(), &addr.sin_addr);
+        if (connect(client.socket, (sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+            stats.failed_connections++;
+        }
+    }
+
+    void restart_client(Client& client) {
+        close(client.socket);
+        open_client(client);
+    }
+
+    // Rejected or broken connection (e.g. server full), retry later instead of hammering the server
+    void fail_client(Client& client) {
+        stats.failed_connections++;
+        close(client.socket);
+        client.socket = -1;
+        client.retry_at = Clock::now() + std::chrono::milliseconds(RETRY_DELAY_MS);
+    }
+
+    void send_line(Client& client, const std::string& line) {
+        // messages are tiny, a short write only happens when the server stopped reading
+        send(client.socket, line.data(), line.size(), MSG_NOSIGNAL);
+        client.last_sent = Clock::now();
+    }
+
+    bool read_client(Client& client) {
+        char buffer[4096];
+        ssize_t bytes_read = recv(client.socket, buffer, sizeof(buffer), 0);
+        if (bytes_read <= 0) {
+            return bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+        }
+        client.inbound.append(buffer, bytes_read);
+
+        // server messages end with "\n\0"
+        size_t start = 0, end;
+        while ((end = client.inbound.find('\n', start)) != std::string::npos) {
+            std::string message = client.inbound.substr(start, end - start);
+            start = end + 1;
+            if (!message.empty() && message[0] == '\0') message.erase(0, 1);
+            if (!message.empty()) handle_message(client, message);
+        }
+        client.inbound.erase(0, start);
+        return true;
+    }
+
+    void handle_message(Client& client, const std::string& message) {
+        size_t type_end = message.find('|');
+        std::string type = message.substr(5, type_end == std::string::npos ? std::string::npos : type_end - 5);
+
+        if (type == "name_request") {
+            send_line(client, "type:name_response|data:name=" + client.name + ";\n");
+            stats.connections++;
+        } else if (type == "heartbeat") {
+            send_line(client, "type:ack|data:;\n");
+        } else if (type == "waiting") {
+            client.state = ClientState::WAITING;
+        } else if (type == "game_started") {
+            // next_turn follows right after, only count the game once (from the first player)
+            client.state = ClientState::PLAYING;
+            Position position;
+            if (parse_position(message, client.name, position) && position.my_id == "1") stats.games_started++;
+        } else if (type == "next_turn") {
+            client.state = ClientState::PLAYING;
+            play_turn(client, message, true);
+        } else if (type == "error") {
+            stats.errors++;
+            // rejected wall: answer with a pawn move instead
+            if (client.move_pending) {
+                client.move_pending = false;
+                play_turn_after_error(client);
+            }
+        } else if (type == "game_ended") {
+            if (client.move_pending) record_latency(client);
+            if (client.my_id == "1") stats.games_finished++;
+            client.state = ClientState::DONE;
+        } else if (type == "player_disconnected" || type == "player_reconnected" || type == "ack") {
+            // nothing to do, opponents of the load generator do not disconnect on purpose
+        }
+    }
+
+    void record_latency(Client& client) {
+        auto latency = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - client.move_sent).count();
+        latencies_us.push_back(static_cast<uint32_t>(latency));
+        stats.moves++;
+        client.move_pending = false;
+    }
+
+    void play_turn(Client& client, const std::string& message, bool allow_wall) {
+        if (client.move_pending) record_latency(client);
+        Position position;
+        if (!parse_position(message, client.name, position)) return;
+        client.my_id = position.my_id;
+        client.last_position = position;
+        if (position.current_player_id != position.my_id) return;
+
+        int player_index = atoi(position.my_id.c_str()) - 1;
+        send_line(client, make_move(position, player_index, options.scripted, allow_wall, rng));
+        client.move_pending = true;
+        client.move_sent = Clock::now();
+    }
+
+    void play_turn_after_error(Client& client) {
+        if (client.last_position.my_id.empty()) return;
+        int player_index = atoi(client.last_position.my_id.c_str()) - 1;
+        send_line(client, make_move(client.last_position, player_index, true, false, rng));
+        client.move_pending = true;
+        client.move_sent = Clock::now();
+    }
+};
+
+uint32_t percentile(const std::vector<uint32_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(p * (sorted.size() - 1));
+    return sorted[index];
+}
+
+void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s <address> <port> [--connections N] [--threads N] [--duration S] [--mode random|scripted] [--seed N]\n", program);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    Options options;
+    options.address = argv[1];
+    options.port = atoi(argv[2]);
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        std::string value = argv[i + 1];
+        if (flag == "--connections") options.connections = std::max(2, atoi(value.c_str()));
+        else if (flag == "--threads") options.threads = std::max(1, atoi(value.c_str()));
+        else if (flag == "--duration") options.duration = std::max(1, atoi(value.c_str()));
+        else if (flag == "--mode") options.scripted = (value == "scripted");
+        else if (flag == "--seed") options.seed = static_cast<unsigned>(strtoul(value.c_str(), nullptr, 10));
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+    printf("Load test: %d connections, %d threads, %d s, %s mode against %s:%d\n", options.connections, options.threads,
+        options.duration, options.scripted ? "scripted" : "random", options.address.c_str(), options.port);
+
+    Stats stats;
+    auto start_time = Clock::now();
+    auto end_time = start_time + std::chrono::seconds(options.duration);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < options.threads; ++t) {
+        int clients = options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+        threads.emplace_back([&, t, clients]() {
+            ClientThread(options, stats, t, clients).run(end_time);
+        });
+    }
+
+    // progress once per second
+    uint64_t last_moves = 0, last_connections = 0;
+    while (Clock::now() < end_time) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        uint64_t moves = stats.moves, connections = stats.connections;
+        printf("  connections/s %6llu  moves/s %8llu  games finished %llu  errors %llu\n",
+            (unsigned long long)(connections - last_connections), (unsigned long long)(moves - last_moves),
+            (unsigned long long)stats.games_finished.load(), (unsigned long long)stats.errors.load());
+        fflush(stdout);
+        last_moves = moves;
+        last_connections = connections;
+    }
+    for (auto& thread : threads) thread.join();
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - start_time).count();
+    std::vector<uint32_t>& latencies = stats.latencies_us;
+    std::sort(latencies.begin(), latencies.end());
+
+    printf("\nResults over %.1f s\n", elapsed);
+    printf("  connections         %llu (%.1f/s), failed %llu\n", (unsigned long long)stats.connections.load(),
+        stats.connections / elapsed, (unsigned long long)stats.failed_connections.load());
+    printf("  games started       %llu, finished %llu\n", (unsigned long long)stats.games_started.load(),
+        (unsigned long long)stats.games_finished.load());
+    printf("  moves               %llu (%.1f/s), server errors %llu\n", (unsigned long long)stats.moves.load(),
+        stats.moves / elapsed, (unsigned long long)stats.errors.load());
+    printf("  move latency (us)   p50 %u  p99 %u  p999 %u  max %u\n", percentile(latencies, 0.50),
+        percentile(latencies, 0.99), percentile(latencies, 0.999), latencies.empty() ? 0 : latencies.back());
+    return 0;
+}
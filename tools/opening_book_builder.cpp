@@ -0,0 +1,287 @@
+// Opening book builder.
+// The first plies of every finished game of the journal are replayed through the rules engine and every position
+// reached is counted together with the move played in it and whether the player who played it won. Positions that
+// enough games reached become book entries: the recorded move with the best score if it was played often enough
+// and won at least half of its games, otherwise the move of the engine analysis (run here once instead of on every
+// request). The book is written to one sorted file that the server maps for its analysis requests (openings.qbk in
+// its working directory).
+//
+// Usage: quoridor_book <journal dir> <output file> [--plies N] [--min-games N] [--threads N]
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "analysis.h"
+#include "journal.h"
+#include "journal_reader.h"
+#include "opening_book.h"
+#include "rules.h"
+
+namespace {
+
+constexpr int DEFAULT_PLIES = 12; // book depth, later positions rarely repeat
+constexpr uint32_t DEFAULT_MIN_GAMES = 2; // games a position (and a recorded move) needs to be used
+
+struct MoveStats {
+    uint8_t flags = 0;
+    uint8_t cells[4] = {0, 0, 0, 0};
+    uint32_t games = 0;
+    uint32_t wins = 0; // games the player who played the move won
+};
+
+struct PositionStats {
+    VariantPosition position;
+    int to_move = 0;
+    uint32_t games = 0;
+    std::vector<MoveStats> moves;
+};
+
+using PositionMap = std::unordered_map<uint64_t, PositionStats>;
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Winner recorded for a game, -1 if it did not finish
+int recorded_winner(const std::vector<JournalEvent>& events) {
+    for (const JournalEvent& event : events) {
+        if (event.type == JournalEventType::GAME_END) return event.player;
+    }
+    return -1;
+}
+
+bool same_move(const MoveStats& a, const MoveStats& b) {
+    return a.flags == b.flags && memcmp(a.cells, b.cells, sizeof(a.cells)) == 0;
+}
+
+// Move of a journal event, a pawn step only has its first cell
+MoveStats move_of(const JournalEvent& event) {
+    MoveStats move;
+    move.flags = event.flags;
+    memcpy(move.cells, event.cells, (event.flags & JOURNAL_MOVE_WALL) ? 4 : 2);
+    return move;
+}
+
+void count_move(PositionStats& stats, const MoveStats& played, bool won) {
+    auto found = std::find_if(stats.moves.begin(), stats.moves.end(), [&played](const MoveStats& move) {
+        return same_move(move, played);
+    });
+    if (found == stats.moves.end()) found = stats.moves.insert(stats.moves.end(), played);
+    found->games++;
+    if (won) found->wins++;
+}
+
+// Count the positions of the first plies of a finished game
+void collect_game(const std::vector<JournalEvent>& events, int plies, PositionMap& positions) {
+    int winner = recorded_winner(events);
+    if (winner < 0) return;  // unfinished games tell nothing about their moves
+    VariantPosition position = initial_position(game_variant(events));
+    int played = 0;
+    for (const JournalEvent& event : events) {
+        if (played == plies) break;
+        if (event.type != JournalEventType::MOVE || event.player > 1) continue;
+        PositionStats& stats = positions[OpeningBook::position_key(position, event.player)];
+        if (stats.games == 0) {
+            stats.position = position;
+            stats.to_move = event.player;
+        }
+        stats.games++;
+        count_move(stats, move_of(event), event.player == winner);
+
+        bool legal = std::visit([&event](auto& current) {
+            using Engine = typename std::decay_t<decltype(current)>::Engine;
+            if (event.flags & JOURNAL_MOVE_WALL) {
+                bool horizontal = (event.flags & JOURNAL_MOVE_HORIZONTAL) != 0;
+                std::pair<int, int> first{event.cells[0], event.cells[1]};
+                std::pair<int, int> second{event.cells[2], event.cells[3]};
+                if (!Engine::is_valid_wall(current, event.player, horizontal, first, second)) return false;
+                Engine::place_wall(current, event.player, horizontal, first, second);
+                return true;
+            }
+            if (!Engine::is_valid_step(current, event.player, event.cells[0], event.cells[1])) return false;
+            Engine::move_pawn(current, event.player, event.cells[0], event.cells[1]);
+            return true;
+        }, position);
+        if (!legal) return;  // the rest of the game cannot be followed
+        played++;
+    }
+}
+
+// Recorded move of a position that the book can take, nullptr if none was played often and successfully enough
+const MoveStats* best_recorded_move(const PositionStats& stats, uint32_t min_games) {
+    const MoveStats* best = nullptr;
+    for (const MoveStats& move : stats.moves) {
+        if (move.games < min_games || 2 * move.wins < move.games) continue;
+        // score with one won and one lost game added, so a move with few games does not look perfect
+        auto better = [](const MoveStats& a, const MoveStats& b) {
+            return uint64_t(a.wins + 1) * (b.games + 2) > uint64_t(b.wins + 1) * (a.games + 2);
+        };
+        if (!best || better(move, *best)) best = &move;
+    }
+    return best;
+}
+
+OpeningBook::Entry make_entry(uint64_t key, const PositionStats& stats, uint32_t min_games) {
+    OpeningBook::Entry entry{};
+    entry.key = key;
+    entry.games = stats.games;
+    if (const MoveStats* move = best_recorded_move(stats, min_games)) {
+        entry.source = static_cast<uint8_t>(OpeningBook::Source::GAMES);
+        entry.flags = move->flags;
+        memcpy(entry.cells, move->cells, sizeof(entry.cells));
+        entry.wins = move->wins;
+        return entry;
+    }
+    entry.source = static_cast<uint8_t>(OpeningBook::Source::ENGINE);
+    Analysis analysis = analyze_position(stats.position, stats.to_move);
+    if (analysis.hint.empty()) {
+        entry.games = 0;  // no move, dropped by the caller
+        return entry;
+    }
+    entry.flags = analysis.hint.size() == 2
+        ? static_cast<uint8_t>(JOURNAL_MOVE_WALL | (analysis.hint_is_horizontal ? JOURNAL_MOVE_HORIZONTAL : 0)) : 0;
+    for (size_t i = 0; i < analysis.hint.size(); ++i) {
+        entry.cells[2 * i] = static_cast<uint8_t>(analysis.hint[i].first);
+        entry.cells[2 * i + 1] = static_cast<uint8_t>(analysis.hint[i].second);
+    }
+    for (const MoveStats& move : stats.moves) {
+        if (move.flags == entry.flags && memcmp(move.cells, entry.cells, sizeof(entry.cells)) == 0) {
+            entry.wins = move.wins;
+        }
+    }
+    return entry;
+}
+
+int run(const std::string& directory, const std::string& output, int plies, uint32_t min_games, int thread_count) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Segment> segments = list_segments(directory);
+    if (segments.empty()) {
+        fprintf(stderr, "No journal segments in %s\n", directory.c_str());
+        return 1;
+    }
+    std::vector<EventRef> index = build_index(segments, thread_count);
+    std::vector<std::pair<size_t, size_t>> games = split_games(index);
+
+    // positions per worker, merged afterwards
+    std::vector<PositionMap> partial(thread_count);
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < thread_count; ++t) {
+        workers.emplace_back([&, t]() {
+            std::vector<JournalEvent> events;
+            for (size_t g = next++; g < games.size(); g = next++) {
+                load_game_events(segments, index.data() + games[g].first, index.data() + games[g].second, events);
+                collect_game(events, plies, partial[t]);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+
+    PositionMap positions = std::move(partial[0]);
+    for (int t = 1; t < thread_count; ++t) {
+        for (auto& part : partial[t]) {
+            PositionStats& stats = positions[part.first];
+            if (stats.games == 0) {
+                stats = std::move(part.second);
+                continue;
+            }
+            stats.games += part.second.games;
+            for (const MoveStats& move : part.second.moves) {
+                auto found = std::find_if(stats.moves.begin(), stats.moves.end(), [&move](const MoveStats& known) {
+                    return same_move(known, move);
+                });
+                if (found == stats.moves.end()) {
+                    stats.moves.push_back(move);
+                } else {
+                    found->games += move.games;
+                    found->wins += move.wins;
+                }
+            }
+        }
+        PositionMap().swap(partial[t]);
+    }
+    double scan_seconds = seconds_since(start);
+
+    // the engine analysis of the chosen positions runs on all threads
+    auto choose_start = std::chrono::steady_clock::now();
+    std::vector<std::pair<uint64_t, const PositionStats*>> chosen;
+    for (const auto& position : positions) {
+        if (position.second.games >= min_games) chosen.emplace_back(position.first, &position.second);
+    }
+    std::vector<OpeningBook::Entry> book(chosen.size());
+    next = 0;
+    for (int t = 0; t < thread_count; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < chosen.size(); i = next++) {
+                book[i] = make_entry(chosen[i].first, *chosen[i].second, min_games);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    book.erase(std::remove_if(book.begin(), book.end(), [](const OpeningBook::Entry& entry) {
+        return entry.games == 0;
+    }), book.end());
+    double choose_seconds = seconds_since(choose_start);
+
+    size_t from_engine = std::count_if(book.begin(), book.end(), [](const OpeningBook::Entry& entry) {
+        return entry.source == static_cast<uint8_t>(OpeningBook::Source::ENGINE);
+    });
+    if (!OpeningBook::write(output, book)) {
+        fprintf(stderr, "Cannot write %s\n", output.c_str());
+        return 1;
+    }
+    OpeningBook check;
+    if (!check.open(output)) {
+        fprintf(stderr, "%s was written but cannot be read back\n", output.c_str());
+        return 1;
+    }
+    printf("Book of %zu positions from %zu games (%zu positions in the first %d plies), %d threads\n", book.size(),
+        games.size(), positions.size(), plies, thread_count);
+    printf("  moves               %zu from games, %zu from engine analysis\n", book.size() - from_engine, from_engine);
+    printf("  scan time           %.3f s\n", scan_seconds);
+    printf("  choose time         %.3f s\n", choose_seconds);
+    struct stat info{};
+    stat(output.c_str(), &info);
+    printf("  file                %s, %.1f KB\n", output.c_str(), info.st_size / 1024.0);
+    return 0;
+}
+
+void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s <journal dir> <output file> [--plies N] [--min-games N] [--threads N]\n", program);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc % 2 == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    int plies = DEFAULT_PLIES;
+    uint32_t min_games = DEFAULT_MIN_GAMES;
+    int thread_count = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 3; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        int value = std::max(1, atoi(argv[i + 1]));
+        if (option == "--plies") {
+            plies = value;
+        } else if (option == "--min-games") {
+            min_games = static_cast<uint32_t>(value);
+        } else if (option == "--threads") {
+            thread_count = value;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    return run(argv[1], argv[2], plies, min_games, thread_count);
+}
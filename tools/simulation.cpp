@@ -0,0 +1,382 @@
+// Deterministic in-process simulation of the Quoridor server.
+// Runs the real QuoridorServer/QuoridorGame code with scripted clients connected through InMemoryTransport
+// and drives time with the virtual Clock: handshake, matchmaking, moves, heartbeat timeouts and reconnection
+// all happen in one process without a network. Virtual time only advances when the server is idle, so
+// a run depends on the seed and the scripts, not on machine speed.
+//
+// Usage: quoridor_sim [options]
+//   --clients N          number of scripted clients (default 200)
+//   --games N            games each client plays before leaving (default 1)
+//   --silent-percent P   percentage of clients that go silent once in the middle of a game (default 5)
+//   --silence S          seconds of virtual time a silent client stays away before reconnecting (default 30)
+//   --seed N             random seed (default 1)
+//   --max-time S         stop after S seconds of virtual time (default 3600)
+//   --journal DIR        record the simulated games into a game journal in DIR
+#include <time.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "client_protocol.h"
+#include "clock.h"
+#include "journal.h"
+#include "logger.h"
+#include "quoridor_server.h"
+#include "transport.h"
+
+namespace {
+
+constexpr auto TIME_STEP = std::chrono::milliseconds(100); // virtual time added whenever the server is idle
+constexpr int RETRY_DELAY_SECONDS = 5; // rejected clients (server full) retry after this virtual delay
+
+struct Options {
+    int clients = 200;
+    int games = 1;
+    int silent_percent = 5;
+    int silence = 30;
+    unsigned seed = 1;
+    int max_time = 3600;
+    std::string journal; // journal directory (empty = no journal)
+};
+
+struct SimStats {
+    uint64_t connections = 0;
+    uint64_t rejected = 0; // connections refused by the server (e.g. server full)
+    uint64_t games_finished = 0;
+    uint64_t moves = 0; // our moves answered by the next update
+    uint64_t errors = 0; // error messages received during a game
+    uint64_t disconnect_notices = 0; // player_disconnected seen by opponents
+    uint64_t reconnect_notices = 0; // player_reconnected seen by clients
+};
+
+enum class ClientState { OFFLINE, CONNECTED, PLAYING, SILENT, DONE };
+
+struct SimClient {
+    int index = 0;
+    std::string name;
+    ClientState state = ClientState::OFFLINE;
+    std::shared_ptr<InMemoryTransport> endpoint; // client side of the connection
+    std::string inbound; // bytes not yet split into messages
+    Position last_position; // last next_turn seen
+    bool move_pending = false;
+    bool in_game = false;
+    int games_left = 0;
+    int moves_made = 0; // moves in the current game
+    int silent_at_move = -1; // go silent before this move of the current game (-1 = never)
+    Clock::time_point wake_at; // end of silence or retry delay
+    std::mt19937 rng;
+};
+
+class Simulation {
+public:
+    Simulation(const Options& options) : options(options) {}
+
+    void run() {
+        Clock::enable_virtual_time();
+        server.start_in_process();
+
+        std::mt19937 setup_rng(options.seed);
+        clients.resize(options.clients);
+        for (int i = 0; i < options.clients; ++i) {
+            SimClient& client = clients[i];
+            client.index = i;
+            client.games_left = options.games;
+            client.rng.seed(options.seed * 1000003u + i);
+            client.wake_at = Clock::now();
+        }
+
+        auto start_virtual = Clock::now();
+        auto end_virtual = start_virtual + std::chrono::seconds(options.max_time);
+        timespec cpu_start{}, harness_start{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &harness_start);
+        auto real_start = std::chrono::steady_clock::now();
+
+        while (Clock::now() < end_virtual && !all_done()) {
+            if (pump()) continue;
+            if (!wait_for_idle()) continue;
+            Clock::advance(TIME_STEP);
+        }
+
+        timespec cpu_end{}, harness_end{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &harness_end);
+        double real_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - real_start).count();
+        double virtual_seconds = std::chrono::duration<double>(Clock::now() - start_virtual).count();
+        double server_cpu = seconds(cpu_end) - seconds(cpu_start) - (seconds(harness_end) - seconds(harness_start));
+
+        int unfinished = 0;
+        for (const auto& client : clients) {
+            if (client.state != ClientState::DONE) ++unfinished;
+        }
+        printf("Simulation: %d clients, seed %u\n", options.clients, options.seed);
+        printf("  virtual time        %.1f s (real %.2f s)\n", virtual_seconds, real_seconds);
+        printf("  connections         %llu, rejected %llu\n", (unsigned long long)stats.connections, (unsigned long long)stats.rejected);
+        printf("  games finished      %llu, clients unfinished %d\n", (unsigned long long)stats.games_finished, unfinished);
+        printf("  moves               %llu, server errors %llu\n", (unsigned long long)stats.moves, (unsigned long long)stats.errors);
+        printf("  disconnect notices  %llu, reconnect notices %llu\n", (unsigned long long)stats.disconnect_notices,
+            (unsigned long long)stats.reconnect_notices);
+        printf("  server cpu          %.3f s, %.2f us/move\n", server_cpu, stats.moves ? server_cpu * 1e6 / stats.moves : 0.0);
+    }
+
+private:
+    const Options& options;
+    QuoridorServer server;
+    std::vector<SimClient> clients;
+    std::vector<std::shared_ptr<InMemoryTransport>> server_endpoints; // used to check that the server consumed its input
+    SimStats stats;
+
+    static double seconds(const timespec& time) {
+        return time.tv_sec + time.tv_nsec / 1e9;
+    }
+
+    bool all_done() const {
+        for (const auto& client : clients) {
+            if (client.state != ClientState::DONE) return false;
+        }
+        return true;
+    }
+
+    // Server threads are idle when all of them wait through Clock and none of them has unread input.
+    // The condition has to hold twice in a row, so threads that were just created get a chance to register.
+    void settle() {
+        for (int stable = 0; stable < 2;) {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            bool inputs_consumed = std::all_of(server_endpoints.begin(), server_endpoints.end(),
+                [](const std::shared_ptr<InMemoryTransport>& endpoint) { return endpoint->pending() == 0; });
+            stable = (inputs_consumed && Clock::is_idle()) ? stable + 1 : 0;
+        }
+    }
+
+    // Returns false if clients got new input while the server was settling
+    bool wait_for_idle() {
+        settle();
+        if (has_client_input()) return false;
+        // endpoints nobody reads anymore can be forgotten
+        server_endpoints.erase(std::remove_if(server_endpoints.begin(), server_endpoints.end(),
+            [](const std::shared_ptr<InMemoryTransport>& endpoint) { return endpoint.use_count() == 1; }),
+            server_endpoints.end());
+        return true;
+    }
+
+    bool has_client_input() const {
+        for (const auto& client : clients) {
+            if (client.endpoint && client.state != ClientState::SILENT && client.endpoint->pending() > 0) return true;
+        }
+        return false;
+    }
+
+    // One pass over all clients, returns true if anything happened.
+    // The server settles after every client that acted, so concurrent server threads never race on input order.
+    bool pump() {
+        bool progress = false;
+        auto now = Clock::now();
+        for (auto& client : clients) {
+            if (client.state == ClientState::DONE) continue;
+            if (client.state == ClientState::OFFLINE || client.state == ClientState::SILENT) {
+                if (now >= client.wake_at) {
+                    connect(client);
+                    settle();
+                    progress = true;
+                }
+                continue;
+            }
+            if (read(client)) {
+                settle();
+                progress = true;
+            }
+        }
+        return progress;
+    }
+
+    void connect(SimClient& client) {
+        // a silent client comes back under the same name, so the server treats it as a reconnection
+        if (client.state != ClientState::SILENT) {
+            client.name = "sim" + std::to_string(client.index) + "_" + std::to_string(options.games - client.games_left);
+        }
+        auto endpoints = InMemoryTransport::create_pair();
+        client.endpoint = endpoints.first;
+        client.inbound.clear();
+        client.move_pending = false;
+        client.state = ClientState::CONNECTED;
+        server_endpoints.push_back(endpoints.second);
+        server.accept_transport(endpoints.second);
+        stats.connections++;
+    }
+
+    void send(SimClient& client, const std::string& line) {
+        client.endpoint->send_bytes(line.data(), line.size());
+    }
+
+    bool read(SimClient& client) {
+        char buffer[4096];
+        bool progress = false;
+        bool closed = false;
+        while (true) {
+            ssize_t bytes_read = client.endpoint->try_receive(buffer, sizeof(buffer));
+            if (bytes_read <= 0) {
+                closed = (bytes_read == 0);
+                break;
+            }
+            client.inbound.append(buffer, bytes_read);
+            progress = true;
+        }
+
+        // messages sent before the server closed the connection are handled first
+        size_t start = 0, end;
+        while ((end = client.inbound.find('\n', start)) != std::string::npos) {
+            std::string message = client.inbound.substr(start, end - start);
+            start = end + 1;
+            if (!message.empty() && message[0] == '\0') message.erase(0, 1);
+            if (!message.empty()) handle_message(client, message);
+            if (client.state != ClientState::CONNECTED && client.state != ClientState::PLAYING) {
+                client.inbound.clear();
+                return true;
+            }
+        }
+        client.inbound.erase(0, start);
+        if (closed) {
+            handle_close(client);
+            return true;
+        }
+        return progress;
+    }
+
+    // Server closed the connection
+    void handle_close(SimClient& client) {
+        client.endpoint.reset();
+        if (client.in_game) {
+            // connection closed in the middle of a game, the game is gone
+            client.in_game = false;
+            finish_game(client);
+            return;
+        }
+        stats.rejected++;
+        client.state = ClientState::OFFLINE;
+        client.wake_at = Clock::now() + std::chrono::seconds(RETRY_DELAY_SECONDS);
+    }
+
+    void finish_game(SimClient& client) {
+        if (client.endpoint) client.endpoint->close_transport();
+        client.endpoint.reset();
+        client.in_game = false;
+        client.games_left--;
+        client.moves_made = 0;
+        client.last_position = Position();
+        client.state = client.games_left > 0 ? ClientState::OFFLINE : ClientState::DONE;
+        client.wake_at = Clock::now();
+    }
+
+    void handle_message(SimClient& client, const std::string& message) {
+        size_t type_end = message.find('|');
+        std::string type = message.substr(5, type_end == std::string::npos ? std::string::npos : type_end - 5);
+
+        if (type == "name_request") {
+            send(client, "type:name_response|data:name=" + client.name + ";\n");
+        } else if (type == "heartbeat") {
+            // echo seq and ts so the server can measure the round trip time
+            send(client, "type:ack|" + (type_end == std::string::npos ? std::string("data:;") : message.substr(type_end + 1)) + "\n");
+        } else if (type == "game_started") {
+            client.state = ClientState::PLAYING;
+            client.in_game = true;
+            client.moves_made = 0;
+            // decide now whether (and when) this client drops out during the game
+            client.silent_at_move = (int(client.rng() % 100) < options.silent_percent) ? int(client.rng() % 6) + 1 : -1;
+        } else if (type == "next_turn") {
+            client.state = ClientState::PLAYING;
+            client.in_game = true;
+            play_turn(client, message);
+        } else if (type == "error") {
+            if (client.in_game) stats.errors++;
+            if (client.move_pending && !client.last_position.my_id.empty()) {
+                // rejected wall, play a pawn move instead
+                int player_index = atoi(client.last_position.my_id.c_str()) - 1;
+                send(client, make_move(client.last_position, player_index, true, false, client.rng));
+            }
+        } else if (type == "game_ended") {
+            if (client.move_pending) stats.moves++;
+            if (client.last_position.my_id == "1") stats.games_finished++;
+            finish_game(client);
+        } else if (type == "player_disconnected") {
+            stats.disconnect_notices++;
+        } else if (type == "player_reconnected") {
+            stats.reconnect_notices++;
+        }
+    }
+
+    void play_turn(SimClient& client, const std::string& message) {
+        if (client.move_pending) {
+            stats.moves++;
+            client.move_pending = false;
+        }
+        Position position;
+        if (!parse_position(message, client.name, position)) return;
+        client.last_position = position;
+        if (position.current_player_id != position.my_id) return;
+
+        if (client.moves_made == client.silent_at_move) {
+            // stop answering, the old connection is abandoned without closing it (like a dead network)
+            client.silent_at_move = -1;
+            client.state = ClientState::SILENT;
+            client.wake_at = Clock::now() + std::chrono::seconds(options.silence);
+            return;
+        }
+        int player_index = atoi(position.my_id.c_str()) - 1;
+        send(client, make_move(position, player_index, false, true, client.rng));
+        client.move_pending = true;
+        client.moves_made++;
+    }
+};
+
+void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--clients N] [--games N] [--silent-percent P] [--silence S] [--seed N] [--max-time S] [--journal DIR]\n", program);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string flag = argv[i];
+        int value = atoi(argv[i + 1]);
+        if (flag == "--journal") {
+            options.journal = argv[i + 1];
+            continue;
+        }
+        if (flag == "--clients") options.clients = std::max(2, value);
+        else if (flag == "--games") options.games = std::max(1, value);
+        else if (flag == "--silent-percent") options.silent_percent = std::clamp(value, 0, 100);
+        else if (flag == "--silence") options.silence = std::max(1, value);
+        else if (flag == "--seed") options.seed = static_cast<unsigned>(value);
+        else if (flag == "--max-time") options.max_time = std::max(1, value);
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (argc % 2 == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    // only warnings and errors, so the report stays readable
+    Logger::instance().set_min_level(LogLevel::WARNING);
+    if (!options.journal.empty() && !Journal::instance().open(options.journal)) {
+        Logger::instance().flush();
+        fprintf(stderr, "Cannot open journal in %s\n", options.journal.c_str());
+        return 1;
+    }
+
+    Simulation simulation(options);
+    simulation.run();
+    Journal::instance().flush();
+    Logger::instance().flush();
+    // server threads are detached and still waiting on the virtual clock, leave without tearing them down
+    fflush(stdout);
+    _Exit(0);
+}
@@ -0,0 +1,146 @@
+// Race tablebase generator.
+// Games of the journal are replayed through the rules engine and the wall layout of every game in which both
+// players ran out of walls is collected. From then on only pawns move, so each distinct layout is solved for every
+// placement of the two pawns by retrograde analysis, one layout per task on all cores. The tables are written to
+// one file that the server maps for its analysis requests (races.qtb in its working directory).
+//
+// Usage: quoridor_tablebase <journal dir> <output file> [--threads N]
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "journal.h"
+#include "journal_reader.h"
+#include "rules.h"
+#include "tablebase.h"
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Replay the moves of a game until neither player has a wall left, returns false if that never happens
+bool find_race(const std::vector<JournalEvent>& events, VariantPosition& position) {
+    position = initial_position(game_variant(events));
+    for (const JournalEvent& event : events) {
+        if (event.type != JournalEventType::MOVE || event.player > 1) continue;
+        bool legal = std::visit([&event](auto& current) {
+            using Engine = typename std::decay_t<decltype(current)>::Engine;
+            if (event.flags & JOURNAL_MOVE_WALL) {
+                bool horizontal = (event.flags & JOURNAL_MOVE_HORIZONTAL) != 0;
+                std::pair<int, int> first{event.cells[0], event.cells[1]};
+                std::pair<int, int> second{event.cells[2], event.cells[3]};
+                if (!Engine::is_valid_wall(current, event.player, horizontal, first, second)) return false;
+                Engine::place_wall(current, event.player, horizontal, first, second);
+                return true;
+            }
+            if (!Engine::is_valid_step(current, event.player, event.cells[0], event.cells[1])) return false;
+            Engine::move_pawn(current, event.player, event.cells[0], event.cells[1]);
+            return true;
+        }, position);
+        if (!legal) return false;  // the rest of the game cannot be followed
+        bool race = std::visit([](const auto& current) {
+            return current.walls_left[0] == 0 && current.walls_left[1] == 0;
+        }, position);
+        if (race) return true;
+    }
+    return false;
+}
+
+int run(const std::string& directory, const std::string& output, int thread_count) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Segment> segments = list_segments(directory);
+    if (segments.empty()) {
+        fprintf(stderr, "No journal segments in %s\n", directory.c_str());
+        return 1;
+    }
+    std::vector<EventRef> index = build_index(segments, thread_count);
+    std::vector<std::pair<size_t, size_t>> games = split_games(index);
+
+    // layouts per worker, merged by key afterwards
+    std::vector<std::unordered_map<uint64_t, VariantPosition>> partial(thread_count);
+    std::atomic<size_t> next{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < thread_count; ++t) {
+        workers.emplace_back([&, t]() {
+            std::vector<JournalEvent> events;
+            VariantPosition position;
+            for (size_t g = next++; g < games.size(); g = next++) {
+                load_game_events(segments, index.data() + games[g].first, index.data() + games[g].second, events);
+                if (find_race(events, position)) partial[t].emplace(Tablebase::layout_key(position), position);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+
+    std::unordered_map<uint64_t, VariantPosition> layouts;
+    for (const auto& part : partial) layouts.insert(part.begin(), part.end());
+    double scan_seconds = seconds_since(start);
+
+    auto solve_start = std::chrono::steady_clock::now();
+    std::vector<Tablebase::Table> tables(layouts.size());
+    std::vector<VariantPosition> pending;
+    for (const auto& layout : layouts) pending.push_back(layout.second);
+    next = 0;
+    for (int t = 0; t < thread_count; ++t) {
+        workers.emplace_back([&]() {
+            for (size_t i = next++; i < pending.size(); i = next++) {
+                tables[i] = Tablebase::solve(pending[i]);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double solve_seconds = seconds_since(solve_start);
+
+    size_t values = 0;
+    for (const auto& table : tables) values += table.values.size();
+    if (!Tablebase::write(output, tables)) {
+        fprintf(stderr, "Cannot write %s\n", output.c_str());
+        return 1;
+    }
+    Tablebase check;
+    if (!check.open(output)) {
+        fprintf(stderr, "%s was written but cannot be read back\n", output.c_str());
+        return 1;
+    }
+    printf("Solved %zu race layouts from %zu games (%zu positions), %d threads\n", tables.size(), games.size(),
+        values, thread_count);
+    printf("  scan time           %.3f s\n", scan_seconds);
+    printf("  solve time          %.3f s (%.0f positions/sec)\n", solve_seconds,
+        solve_seconds > 0 ? values / solve_seconds : 0.0);
+    struct stat info{};
+    stat(output.c_str(), &info);
+    printf("  file                %s, %.1f MB\n", output.c_str(), info.st_size / (1024.0 * 1024.0));
+    return 0;
+}
+
+void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s <journal dir> <output file> [--threads N]\n", program);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc != 3 && argc != 5) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    int thread_count = std::max(1u, std::thread::hardware_concurrency());
+    if (argc == 5) {
+        if (std::string(argv[3]) != "--threads") {
+            print_usage(argv[0]);
+            return 1;
+        }
+        thread_count = std::max(1, atoi(argv[4]));
+    }
+    return run(argv[1], argv[2], thread_count);
+}